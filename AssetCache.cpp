@@ -0,0 +1,26 @@
+#include "AssetCache.h"
+
+size_t TAssetCache::Count() const {
+	std::lock_guard<std::mutex> hold(lock);
+	size_t n = 0;
+	for(std::map<std::string, std::weak_ptr<const void>>::const_iterator i = assets.begin(); i != assets.end(); i++)
+		if(!i->second.expired()) n++;
+	return n;
+}
+
+unsigned long TAssetCache::Made() const {
+	std::lock_guard<std::mutex> hold(lock);
+	return made;
+}
+
+unsigned long TAssetCache::Shared() const {
+	std::lock_guard<std::mutex> hold(lock);
+	return shared;
+}
+
+void TAssetCache::Prune() {
+	for(std::map<std::string, std::weak_ptr<const void>>::iterator i = assets.begin(); i != assets.end();) {
+		if(i->second.expired()) i = assets.erase(i);
+		else i++;
+	}
+}
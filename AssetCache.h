@@ -0,0 +1,82 @@
+//Asset cache
+#if !defined(ASSETCACHE_H_INCLUDED_)
+#define ASSETCACHE_H_INCLUDED_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Surface.h"
+
+// TImage: a decoded image that owns its pixels, top row first. Rows are
+// padded to 4 bytes, as in a DIB, so GDI can read and write them as they are.
+struct TImage {
+	std::vector<unsigned char> bits;
+	TSurface surface;
+	TImage(int w, int h, int bpp) : bits((size_t)Stride(w, bpp) * h), surface(w, h, Stride(w, bpp), bpp, bits.empty() ? 0 : &bits[0]) {}
+	static int Stride(int w, int bpp) { return (w * (bpp / 8) + 3) & ~3; }
+
+private:
+	TImage(const TImage&) = delete;   // surface points into bits
+	TImage &operator=(const TImage&) = delete;
+};
+typedef std::shared_ptr<const TImage> TImagePtr;
+
+// TAssetCache: assets that never change once they're made, by name, shared
+// by reference count. The first Get() of a name makes the asset, and everyone
+// who asks for that name after that, from any thread, gets the same one, for
+// as long as anybody still holds it. When the last holder lets go it's freed,
+// and the next Get() makes it afresh. Anything that changes per window, like
+// how far the fade has got, belongs to the window, on top of what it gets here.
+//
+// A name says what the asset is: "background.jpg" for the decoded entry, say,
+// and "background.jpg@1920x1080" for it scaled to a window. Each name must
+// always be asked for as the same type.
+class TAssetCache {
+public:
+	TAssetCache() : made(0), shared(0) {}
+	// Get: the asset called name. If there isn't one, make() is called to make
+	// it: it returns a std::shared_ptr<T>, or null if it couldn't, which isn't
+	// kept. make() runs without the cache locked, so slow ones don't hold up
+	// other names; if two threads make the same name at once, the first to
+	// finish wins, and both get that one.
+	template<class T, class F> std::shared_ptr<const T> Get(const std::string &name, F make) {
+		{
+			std::lock_guard<std::mutex> hold(lock);
+			std::shared_ptr<const void> p = assets[name].lock();
+			if(p) {
+				shared++;
+				return std::static_pointer_cast<const T>(p);
+			}
+		}
+		std::shared_ptr<const T> mine = make();
+		if(!mine) return mine;
+		std::lock_guard<std::mutex> hold(lock);
+		std::shared_ptr<const void> p = assets[name].lock();
+		if(p) {
+			shared++;
+			return std::static_pointer_cast<const T>(p);
+		}
+		Prune();
+		assets[name] = mine;
+		made++;
+		return mine;
+	}
+	// Count: how many assets are alive, i.e. held by somebody
+	size_t Count() const;
+	// Made, Shared: how many times Get() has made an asset, and how many times it
+	// handed out one that was already there
+	unsigned long Made() const;
+	unsigned long Shared() const;
+
+private:
+	TAssetCache(const TAssetCache&) = delete;
+	TAssetCache &operator=(const TAssetCache&) = delete;
+	void Prune(); // forgets the names whose assets have been freed
+	mutable std::mutex lock;
+	std::map<std::string, std::weak_ptr<const void>> assets;
+	unsigned long made, shared;
+};
+
+#endif //ASSETCACHE_H_INCLUDED_
@@ -0,0 +1,98 @@
+#include "AssetLoader.h"
+#include <vector>
+#include <system_error>
+#include <tchar.h>
+#include "unzip.h"
+#include "Jpeg.h"
+
+// LoadJpeg: decodes jpeg data as 32bpp. If fitw x fith is given, it's decoded
+// at the smallest of 1/1, 1/2, 1/4 or 1/8 that still covers it, since it's only
+// going to be scaled down to that afterwards.
+static TImagePtr LoadJpeg(const BYTE *buf, size_t len, int fitw, int fith) {
+	TJpegDecoder dec;
+	if(!dec.ReadHeader(buf, len)) return TImagePtr();
+	int scale = 1;
+	if(fitw > 0 && fith > 0) {
+		while(scale < 8 && TJpegDecoder::Scaled(dec.Width(), scale * 2) >= fitw && TJpegDecoder::Scaled(dec.Height(), scale * 2) >= fith) scale *= 2;
+	}
+	std::shared_ptr<TImage> img = std::make_shared<TImage>(TJpegDecoder::Scaled(dec.Width(), scale), TJpegDecoder::Scaled(dec.Height(), scale), 32);
+	if(!dec.Decode(img->surface, scale)) return TImagePtr();
+	return img;
+}
+
+// LoadBmp: a 24 or 32bpp .bmp file, as it was stored, top row first
+static TImagePtr LoadBmp(const BYTE *buf, size_t len) {
+	if(len < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)) return TImagePtr();
+	BITMAPFILEHEADER bfh; CopyMemory(&bfh, buf, sizeof(bfh));
+	BITMAPINFOHEADER bih; CopyMemory(&bih, buf + sizeof(bfh), sizeof(bih));
+	if(bfh.bfType != 0x4D42 || bih.biCompression != BI_RGB || (bih.biBitCount != 24 && bih.biBitCount != 32)) return TImagePtr();
+	int w = bih.biWidth, h = bih.biHeight < 0 ? -bih.biHeight : bih.biHeight;
+	if(w <= 0 || h <= 0) return TImagePtr();
+	std::shared_ptr<TImage> img = std::make_shared<TImage>(w, h, bih.biBitCount);
+	size_t stride = img->surface.stride;
+	if(bfh.bfOffBits > len || (len - bfh.bfOffBits) / stride < (size_t)h) return TImagePtr();
+	for(int y = 0; y < h; y++) {
+		int from = bih.biHeight > 0 ? h - 1 - y : y; // most are bottom-up
+		CopyMemory(img->surface.Row(y), buf + bfh.bfOffBits + from * stride, stride);
+	}
+	// The transparency (the top-left pixel's colour) is worked out by TSprite::Load
+	return img;
+}
+
+TAssetLoader::~TAssetLoader() {
+	if(worker.joinable()) worker.join();
+}
+
+void TAssetLoader::Start(HINSTANCE hinst, int _fitw, int _fith) {
+	if(started) return;
+	started = true;
+	fitw = _fitw; fith = _fith;
+	try {
+		worker = std::thread(&TAssetLoader::Load, this, hinst);
+	} catch(const std::system_error&) {
+		Load(hinst);
+	}
+}
+
+void TAssetLoader::Load(HINSTANCE hinst) {
+	HZIP hzip = 0;
+	HRSRC hrsrc = FindResource(hinst, _T("ZIPFILE"), RT_RCDATA);
+	DWORD size = hrsrc != 0 ? SizeofResource(hinst, hrsrc) : 0;
+	HGLOBAL hres = size != 0 ? LoadResource(hinst, hrsrc) : 0;
+	void *zip = hres != 0 ? LockResource(hres) : 0;
+	if(zip != 0) hzip = OpenZip(zip, size, ZIP_MEMORY);
+	//
+	if(hzip != 0) {
+		ZIPENTRY ze; int index; FindZipItem(hzip, "background.jpg", true, &index, &ze);
+		if(index != -1) {
+			unsigned int len = (unsigned int)ze.unc_size; // it's out of our own resource, so small
+			background = cache.Get<TImage>("background.jpg", [&]() {
+				std::vector<BYTE> buf(len);
+				if(len == 0) return TImagePtr();
+				// UnzipItems, unlike UnzipItem, checks that the item came out whole and
+				// with the right crc, so the placeholder stays rather than half an image
+				void *dst = &buf[0]; ZRESULT zr;
+				if(UnzipItems(hzip, 1, &index, &dst, &len, &zr, 1) != ZR_OK) return TImagePtr();
+				return LoadJpeg(&buf[0], len, fitw, fith);
+			});
+		}
+	}
+
+	if(hzip != 0) {
+		ZIPENTRY ze; int index; FindZipItem(hzip, "sprite.bmp", true, &index, &ze);
+		if(index != -1) {
+			unsigned int len = (unsigned int)ze.unc_size;
+			sprite = cache.Get<TImage>("sprite.bmp", [&]() {
+				std::vector<BYTE> buf(len);
+				if(len == 0) return TImagePtr();
+				void *dst = &buf[0]; ZRESULT zr;
+				if(UnzipItems(hzip, 1, &index, &dst, &len, &zr, 1) != ZR_OK) return TImagePtr();
+				return LoadBmp(&buf[0], len);
+			});
+		}
+	}
+
+	if(hzip != 0) CloseZip(hzip);
+	// the windows only look at the images once they see this
+	ready.store(true, std::memory_order_release);
+}
@@ -0,0 +1,45 @@
+//Asset loader
+#if !defined(ASSETLOADER_H_INCLUDED_)
+#define ASSETLOADER_H_INCLUDED_
+
+#include <windows.h>
+#include <atomic>
+#include <thread>
+#include "AssetCache.h"
+
+// TAssetLoader: unzips and decodes the background and the sprite out of the
+// saver's zip resource on a thread of its own, so that windows can be created,
+// and show something, without waiting for it. WinMain starts it before there
+// are any windows; each window shows a placeholder until Ready(), and then
+// swaps the real images in. The images go into Cache(), as "background.jpg"
+// and "sprite.bmp", and the windows share what they make from them through
+// it too. The loader holds on to the images for as long as it lives.
+class TAssetLoader {
+public:
+	TAssetLoader() : ready(false), started(false), fitw(0), fith(0) {}
+	~TAssetLoader();
+	// Start: starts loading from hinst's "ZIPFILE" RCDATA resource. Only the
+	// first call does anything. If no thread can be had, it loads right here.
+	// fitw x fith is the largest the background will be shown at, if known: it
+	// lets a preview decode a smaller one.
+	void Start(HINSTANCE hinst, int fitw = 0, int fith = 0);
+	// Ready: whether loading has finished, well or not. From then on the
+	// images don't change; either may be null if it couldn't be loaded.
+	bool Ready() const { return ready.load(std::memory_order_acquire); }
+	TImagePtr Background() const { return Ready() ? background : TImagePtr(); }
+	TImagePtr Sprite() const { return Ready() ? sprite : TImagePtr(); }
+	TAssetCache &Cache() { return cache; }
+
+private:
+	TAssetLoader(const TAssetLoader&) = delete;
+	TAssetLoader &operator=(const TAssetLoader&) = delete;
+	void Load(HINSTANCE hinst);
+	TAssetCache cache;
+	TImagePtr background, sprite;   // only written by Load(), before ready is set
+	std::atomic<bool> ready;
+	bool started;
+	int fitw, fith;
+	std::thread worker;
+};
+
+#endif //ASSETLOADER_H_INCLUDED_
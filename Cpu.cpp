@@ -0,0 +1,47 @@
+#include "Cpu.h"
+
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+static void cpuid(int r[4], int leaf) { __cpuidex(r, leaf, 0); }
+static unsigned long long xgetbv0() { return _xgetbv(0); }
+#else
+#include <cpuid.h>
+static void cpuid(int r[4], int leaf) { __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]); }
+static unsigned long long xgetbv0() {
+	unsigned int a, d;
+	__asm__ __volatile__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return ((unsigned long long)d << 32) | a;
+}
+#endif
+
+static unsigned int DetectCpuFeatures() {
+	int r[4];
+	cpuid(r, 0);
+	int maxleaf = r[0];
+	if(maxleaf < 1) return 0;
+	unsigned int f = 0;
+	cpuid(r, 1);
+	if(r[3] & (1 << 26)) f |= cfSSE2;
+	if(r[2] & (1 << 9)) f |= cfSSSE3;
+	if(r[2] & (1 << 19)) f |= cfSSE41;
+	if(r[2] & (1 << 1)) f |= cfPCLMUL;
+	// AVX2 also needs the OS to save the YMM registers on a context switch
+	bool osxsave = (r[2] & (1 << 27)) != 0;
+	bool avx = (r[2] & (1 << 28)) != 0;
+	if(maxleaf >= 7 && osxsave && avx && (xgetbv0() & 6) == 6) {
+		cpuid(r, 7);
+		if(r[1] & (1 << 5)) f |= cfAVX2;
+	}
+	return f;
+}
+#elif defined(CPU_NEON)
+static unsigned int DetectCpuFeatures() { return cfNEON; } // NEON is mandatory on AArch64
+#else
+static unsigned int DetectCpuFeatures() { return 0; }
+#endif
+
+unsigned int CpuFeatures() {
+	static const unsigned int features = DetectCpuFeatures();
+	return features;
+}
@@ -0,0 +1,35 @@
+//CPU features
+#if !defined(CPU_H_INCLUDED_)
+#define CPU_H_INCLUDED_
+
+// Which instruction-set extensions we have hand-written kernels for.
+// CpuFeatures() runs CPUID once and caches the answer; the SIMD code
+// paths are always compiled, and picked at runtime by their dispatchers.
+enum TCpuFeature {
+	cfSSE2   = 1 << 0,
+	cfSSSE3  = 1 << 1,
+	cfSSE41  = 1 << 2,
+	cfAVX2   = 1 << 3,
+	cfPCLMUL = 1 << 4,
+	cfNEON   = 1 << 5
+};
+
+unsigned int CpuFeatures();
+inline bool CpuHas(unsigned int f) { return (CpuFeatures() & f) == f; }
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_X86 1
+#endif
+#if defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define CPU_NEON 1
+#endif
+
+// gcc and clang only let a function use intrinsics from an extension if
+// it says so; MSVC allows them anywhere.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CPU_TARGET(x)
+#else
+#define CPU_TARGET(x) __attribute__((target(x)))
+#endif
+
+#endif //CPU_H_INCLUDED_
@@ -0,0 +1,55 @@
+#include "DirtyRegion.h"
+
+void TDirtyRegion::SetBounds(int w, int h) {
+	bounds = TRect(0, 0, w, h);
+	AddFull();
+}
+
+// Worth merging: they overlap, or the bounding box wastes little compared
+// to blitting them separately (a blit has a fixed cost of its own)
+static bool ShouldMerge(const TRect &a, const TRect &b) {
+	if(!a.Intersect(b).IsEmpty()) return true;
+	return a.Union(b).Area() <= a.Area() + b.Area() + 64 * 64;
+}
+
+void TDirtyRegion::Add(const TRect &_r) {
+	if(bFull) return;
+	TRect r = _r.Intersect(bounds);
+	if(r.IsEmpty()) return;
+	// Merging can make r overlap rects it didn't before, so go round until nothing merges
+	for(size_t i = 0; i < rects.size();) {
+		if(ShouldMerge(r, rects[i])) {
+			r = r.Union(rects[i]);
+			rects[i] = rects.back();
+			rects.pop_back();
+			i = 0;
+		}
+		else i++;
+	}
+	rects.push_back(r);
+	if(rects.size() > MAXRECTS) {
+		TRect all;
+		for(size_t i = 0; i < rects.size(); i++) all = all.Union(rects[i]);
+		rects.assign(1, all);
+	}
+	if(Area() * 4 >= bounds.Area() * 3) AddFull();
+}
+
+std::vector<TRect> TDirtyRegion::Rects() const {
+	if(bFull) return std::vector<TRect>(1, bounds);
+	return rects;
+}
+
+TRect TDirtyRegion::Extent() const {
+	if(bFull) return bounds;
+	TRect all;
+	for(size_t i = 0; i < rects.size(); i++) all = all.Union(rects[i]);
+	return all;
+}
+
+long long TDirtyRegion::Area() const {
+	if(bFull) return bounds.Area();
+	long long a = 0;
+	for(size_t i = 0; i < rects.size(); i++) a += rects[i].Area();
+	return a;
+}
@@ -0,0 +1,36 @@
+//Dirty region
+#if !defined(DIRTYREGION_H_INCLUDED_)
+#define DIRTYREGION_H_INCLUDED_
+
+#include <stddef.h>
+#include <vector>
+#include "Surface.h"
+
+// TDirtyRegion: the parts of a frame that have changed since it was last
+// shown, kept as a short list of non-overlapping rectangles. Rects that
+// overlap, or are close enough that one blit of their bounding box is
+// cheaper than two, are merged. If the region grows past most of the
+// frame, it just becomes the whole frame.
+class TDirtyRegion {
+public:
+	enum { MAXRECTS = 8 };
+	TDirtyRegion() : bFull(false) {}
+	// SetBounds: the frame size; everything added is clipped to it. Marks it all dirty.
+	void SetBounds(int w, int h);
+	void Add(const TRect &r);
+	void AddFull() { bFull = true; rects.clear(); }
+	void Clear() { bFull = false; rects.clear(); }
+	bool IsFull() const { return bFull; }
+	bool IsEmpty() const { return !bFull && rects.empty(); }
+	// Rects: what to repaint. When the region is full, that's just the bounds.
+	std::vector<TRect> Rects() const;
+	TRect Extent() const; // the bounding box of it all
+	long long Area() const;
+
+private:
+	TRect bounds;
+	std::vector<TRect> rects;
+	bool bFull;
+};
+
+#endif //DIRTYREGION_H_INCLUDED_
@@ -0,0 +1,105 @@
+#include "Fade.h"
+#if defined(CPU_X86)
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+#if defined(CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+bool FadeBytesScalar(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount) {
+	unsigned char any = 0;
+	for(size_t i = 0; i < len; i++) {
+		unsigned char v = src[i];
+		v = v > amount ? (unsigned char)(v - amount) : 0;
+		dst[i] = v;
+		any |= v;
+	}
+	return any != 0;
+}
+
+#if defined(CPU_X86)
+CPU_TARGET("sse2")
+bool FadeBytesSSE2(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount) {
+	const __m128i sub = _mm_set1_epi8((char)amount);
+	__m128i any = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 32 <= len; i += 32) {
+		__m128i a = _mm_subs_epu8(_mm_loadu_si128((const __m128i*)(src + i)), sub);
+		__m128i b = _mm_subs_epu8(_mm_loadu_si128((const __m128i*)(src + i + 16)), sub);
+		_mm_storeu_si128((__m128i*)(dst + i), a);
+		_mm_storeu_si128((__m128i*)(dst + i + 16), b);
+		any = _mm_or_si128(any, _mm_or_si128(a, b));
+	}
+	for(; i + 16 <= len; i += 16) {
+		__m128i a = _mm_subs_epu8(_mm_loadu_si128((const __m128i*)(src + i)), sub);
+		_mm_storeu_si128((__m128i*)(dst + i), a);
+		any = _mm_or_si128(any, a);
+	}
+	bool nonzero = _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF;
+	return FadeBytesScalar(dst + i, src + i, len - i, amount) || nonzero;
+}
+
+CPU_TARGET("avx2")
+bool FadeBytesAVX2(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount) {
+	const __m256i sub = _mm256_set1_epi8((char)amount);
+	__m256i any = _mm256_setzero_si256();
+	size_t i = 0;
+	for(; i + 64 <= len; i += 64) {
+		__m256i a = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i*)(src + i)), sub);
+		__m256i b = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i*)(src + i + 32)), sub);
+		_mm256_storeu_si256((__m256i*)(dst + i), a);
+		_mm256_storeu_si256((__m256i*)(dst + i + 32), b);
+		any = _mm256_or_si256(any, _mm256_or_si256(a, b));
+	}
+	for(; i + 32 <= len; i += 32) {
+		__m256i a = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i*)(src + i)), sub);
+		_mm256_storeu_si256((__m256i*)(dst + i), a);
+		any = _mm256_or_si256(any, a);
+	}
+	bool nonzero = !_mm256_testz_si256(any, any);
+	_mm256_zeroupper();
+	return FadeBytesScalar(dst + i, src + i, len - i, amount) || nonzero;
+}
+#endif
+
+#if defined(CPU_NEON)
+bool FadeBytesNEON(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount) {
+	const uint8x16_t sub = vdupq_n_u8(amount);
+	uint8x16_t any = vdupq_n_u8(0);
+	size_t i = 0;
+	for(; i + 32 <= len; i += 32) {
+		uint8x16_t a = vqsubq_u8(vld1q_u8(src + i), sub);
+		uint8x16_t b = vqsubq_u8(vld1q_u8(src + i + 16), sub);
+		vst1q_u8(dst + i, a);
+		vst1q_u8(dst + i + 16, b);
+		any = vorrq_u8(any, vorrq_u8(a, b));
+	}
+	for(; i + 16 <= len; i += 16) {
+		uint8x16_t a = vqsubq_u8(vld1q_u8(src + i), sub);
+		vst1q_u8(dst + i, a);
+		any = vorrq_u8(any, a);
+	}
+	uint64x2_t any64 = vreinterpretq_u64_u8(any);
+	bool nonzero = (vgetq_lane_u64(any64, 0) | vgetq_lane_u64(any64, 1)) != 0;
+	return FadeBytesScalar(dst + i, src + i, len - i, amount) || nonzero;
+}
+#endif
+
+typedef bool (*TFadeKernel)(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+
+static TFadeKernel ChooseFadeKernel() {
+#if defined(CPU_X86)
+	if(CpuHas(cfAVX2)) return FadeBytesAVX2;
+	if(CpuHas(cfSSE2)) return FadeBytesSSE2;
+#endif
+#if defined(CPU_NEON)
+	if(CpuHas(cfNEON)) return FadeBytesNEON;
+#endif
+	return FadeBytesScalar;
+}
+
+bool FadeBytes(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount) {
+	static const TFadeKernel kernel = ChooseFadeKernel();
+	return kernel(dst, src, len, amount);
+}
@@ -0,0 +1,24 @@
+//Fade kernel
+#if !defined(FADE_H_INCLUDED_)
+#define FADE_H_INCLUDED_
+
+#include <stddef.h>
+#include "Cpu.h"
+
+// FadeBytes: dst[i] = max(src[i] - amount, 0) for len bytes, returning true
+// if any byte of the result is still non-zero. dst may be the same buffer as
+// src, to fade in place. It picks the widest kernel the CPU supports.
+bool FadeBytes(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+
+// The individual kernels, so they can be checked and timed against each
+// other. Only call a SIMD one if CpuHas() reports its extension.
+bool FadeBytesScalar(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+#if defined(CPU_X86)
+bool FadeBytesSSE2(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+bool FadeBytesAVX2(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+#endif
+#if defined(CPU_NEON)
+bool FadeBytesNEON(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+#endif
+
+#endif //FADE_H_INCLUDED_
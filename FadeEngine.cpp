@@ -0,0 +1,68 @@
+#include "FadeEngine.h"
+#include "Fade.h"
+#include <string.h>
+
+TFadeSource::TFadeSource(std::vector<unsigned char> &&_bits, size_t _stride, int _rows) : bits(std::move(_bits)), stride(_stride), rows(_rows > 0 ? _rows : 0), maxval(0) {
+	rowmax.assign(rows, 0);
+	for(int r = 0; r < rows; r++) {
+		const unsigned char *p = &bits[r * stride];
+		unsigned char m = 0;
+		for(size_t i = 0; i < stride; i++) if(p[i] > m) m = p[i];
+		rowmax[r] = m;
+		if(m > maxval) maxval = m;
+	}
+}
+
+void TFadeEngine::SetSource(const unsigned char *src, size_t stride, int rows) {
+	if(rows < 0) rows = 0;
+	SetSource(std::make_shared<TFadeSource>(std::vector<unsigned char>(src, src + stride * rows), stride, rows));
+}
+
+void TFadeEngine::SetSource(std::shared_ptr<const TFadeSource> src) {
+	source = src;
+	Start(start, duration);
+}
+
+void TFadeEngine::Start(unsigned int startMs, unsigned int durationMs) {
+	start = startMs;
+	duration = durationMs ? durationMs : 1;
+	// every row gets written on the first frame, even ones that start out black
+	int rows = source ? source->rows : 0;
+	live.resize(rows);
+	for(int r = 0; r < rows; r++) live[r] = r;
+	bDone = Size() == 0;
+}
+
+void TFadeEngine::ResetStats() {
+	memset(&stats, 0, sizeof(stats));
+}
+
+unsigned char TFadeEngine::Level(unsigned int nowMs) const {
+	unsigned int elapsed = nowMs - start; // unsigned, so this survives the counter wrapping
+	if(elapsed >= duration) return 255;
+	return static_cast<unsigned char>(static_cast<unsigned long long>(elapsed) * 255 / duration);
+}
+
+bool TFadeEngine::Render(unsigned char *dst, unsigned int nowMs) {
+	if(bDone || !source) return false;
+	const TFadeSource &src = *source;
+	unsigned char amount = Level(nowMs);
+	stats.frames++;
+	stats.rowsSkipped += src.rows - live.size();
+	size_t n = 0;
+	for(size_t i = 0; i < live.size(); i++) {
+		int r = live[i];
+		if(src.rowmax[r] <= amount) {
+			memset(dst + r * src.stride, 0, src.stride);
+			stats.rowsCleared++;
+		}
+		else {
+			FadeBytes(dst + r * src.stride, &src.bits[r * src.stride], src.stride, amount);
+			stats.rowsFaded++;
+			live[n++] = r;
+		}
+	}
+	live.resize(n);
+	bDone = amount >= src.maxval;
+	return !bDone;
+}
@@ -0,0 +1,66 @@
+//Fade engine
+#if !defined(FADEENGINE_H_INCLUDED_)
+#define FADEENGINE_H_INCLUDED_
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+// TFadeStats: how much work the fade has done since the last ResetStats().
+// A row is "faded" when it was recomputed from the pristine image, "cleared"
+// on the one frame it went black, and "skipped" on every frame after that.
+struct TFadeStats {
+	unsigned long long frames;
+	unsigned long long rowsFaded, rowsCleared, rowsSkipped;
+};
+
+// TFadeSource: the pristine image a fade works from, with the brightest byte
+// of each row worked out. It never changes once made, so any number of fade
+// engines can share one, each fading at its own pace.
+struct TFadeSource {
+	std::vector<unsigned char> bits;
+	size_t stride;
+	int rows;
+	std::vector<unsigned char> rowmax; // brightest byte in each row
+	unsigned char maxval;              // brightest byte in the whole image
+	// takes over bits, which is rows*stride bytes
+	TFadeSource(std::vector<unsigned char> &&bits, size_t stride, int rows);
+};
+
+// TFadeEngine: holds the pristine decoded image and computes each frame
+// of the fade-to-black from it, as a function of elapsed time. A frame that
+// is skipped or painted twice doesn't change where the fade is, and the
+// image is fully black at start+duration however often we repaint.
+// Times are in ms, from GetTickCount() or any other wrapping counter.
+//
+// The brightest byte of each row is recorded up front, so once the fade
+// level passes it the row is zeroed once and then never looked at again:
+// the cost of a frame shrinks as the image darkens. That relies on Render()
+// being given the same dst buffer every time.
+class TFadeEngine {
+public:
+	TFadeEngine() : start(0), duration(1), bDone(false) { ResetStats(); }
+	// SetSource: takes a copy of rows*stride bytes of image
+	void SetSource(const unsigned char *src, size_t stride, int rows);
+	// SetSource: shares a source that's already made
+	void SetSource(std::shared_ptr<const TFadeSource> src);
+	void Start(unsigned int startMs, unsigned int durationMs);
+	// Level: how much is subtracted from each byte at nowMs, 0..255
+	unsigned char Level(unsigned int nowMs) const;
+	// Render: writes the frame for nowMs into dst, which is laid out like the
+	// source. Returns false once the frame is entirely black.
+	bool Render(unsigned char *dst, unsigned int nowMs);
+	bool Done() const { return bDone; }
+	size_t Size() const { return source ? source->bits.size() : 0; }
+	const TFadeStats &Stats() const { return stats; }
+	void ResetStats();
+
+private:
+	std::shared_ptr<const TFadeSource> source;
+	std::vector<int> live;             // rows that aren't black yet, in order
+	unsigned int start, duration;
+	bool bDone;
+	TFadeStats stats;
+};
+
+#endif //FADEENGINE_H_INCLUDED_
@@ -0,0 +1,130 @@
+#include "FrameBuffer.h"
+#include "Sprite.h"
+#include <stdio.h>
+#include <string.h>
+
+// 5x8 font for chars 32..126, one byte per column, bit 0 at the top
+static const unsigned char Font5x8[95][5] = {
+	{0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+	{0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00},
+	{0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08},
+	{0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02},
+	{0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33},
+	{0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07},
+	{0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00},
+	{0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06},
+	{0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+	{0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73},
+	{0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+	{0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+	{0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32},
+	{0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+	{0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41},
+	{0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+	{0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40}, {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28},
+	{0x38,0x44,0x44,0x28,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x18,0xA4,0xA4,0x9C,0x78},
+	{0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x40,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+	{0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+	{0xFC,0x18,0x24,0x24,0x18}, {0x18,0x24,0x24,0x18,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24},
+	{0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+	{0x44,0x28,0x10,0x28,0x44}, {0x4C,0x90,0x90,0x90,0x7C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+	{0x00,0x00,0x77,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02}
+};
+static const int GLYPHW = 6, GLYPHH = 8; // including a column of spacing
+
+TFrameBuffer::TFrameBuffer(int _w, int _h) : w(_w > 0 ? _w : 0), h(_h > 0 ? _h : 0), bits(w * h * 4 + 4, 0), clip(0, 0, w, h) {
+}
+
+void TFrameBuffer::SetClip(const TRect &r) {
+	clip = r.Intersect(TRect(0, 0, w, h));
+}
+
+// Reading a 24 or 32bpp source pixel
+static inline const unsigned char *SrcPixel(const TSurface &src, int x, int y) {
+	return src.Row(y) + x * (src.bpp / 8);
+}
+
+void TFrameBuffer::Blit(int x, int y, const TSurface &src) {
+	if(!src.IsValid()) return;
+	TRect d = TRect(x, y, x + src.w, y + src.h).Intersect(clip);
+	if(d.IsEmpty()) return;
+	for(int py = d.top; py < d.bottom; py++) {
+		unsigned char *out = &bits[(py * w + d.left) * 4];
+		if(src.bpp == 32) {
+			memcpy(out, SrcPixel(src, d.left - x, py - y), d.Width() * 4);
+			continue;
+		}
+		const unsigned char *in = SrcPixel(src, d.left - x, py - y);
+		for(int px = d.left; px < d.right; px++, in += 3, out += 4) {
+			out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 0;
+		}
+	}
+}
+
+void TFrameBuffer::Stretch(const TRect &dst, const TSurface &src) {
+	if(!src.IsValid() || dst.IsEmpty()) return;
+	TRect d = dst.Intersect(clip);
+	for(int py = d.top; py < d.bottom; py++) {
+		int sy = static_cast<int>((long long)(py - dst.top) * src.h / dst.Height());
+		unsigned char *out = &bits[(py * w + d.left) * 4];
+		for(int px = d.left; px < d.right; px++, out += 4) {
+			int sx = static_cast<int>((long long)(px - dst.left) * src.w / dst.Width());
+			const unsigned char *in = SrcPixel(src, sx, sy);
+			out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = src.bpp == 32 ? in[3] : 0;
+		}
+	}
+}
+
+void TFrameBuffer::DrawSprite(int x, int y, const TSprite &sprite) {
+	SpanBlit(Surface(), clip, x, y, sprite);
+}
+
+void TFrameBuffer::Text(int x, int y, const char *text, int len, TColor color) {
+	unsigned char b = (color >> 16) & 255, g = (color >> 8) & 255, r = color & 255;
+	for(int i = 0; i < len; i++) {
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if(c < 32 || c > 126) c = '?';
+		const unsigned char *glyph = Font5x8[c - 32];
+		for(int col = 0; col < 5; col++) {
+			int px = x + i * GLYPHW + col;
+			if(px < clip.left || px >= clip.right) continue;
+			for(int row = 0; row < GLYPHH; row++) {
+				int py = y + row;
+				if(!(glyph[col] & (1 << row)) || py < clip.top || py >= clip.bottom) continue;
+				unsigned char *out = &bits[(py * w + px) * 4];
+				out[0] = b; out[1] = g; out[2] = r;
+			}
+		}
+	}
+}
+
+void TFrameBuffer::TextSize(const char *, int len, int &tw, int &th) {
+	tw = len * GLYPHW;
+	th = GLYPHH;
+}
+
+unsigned int TFrameBuffer::Checksum() const {
+	// FNV-1a over the colour bytes; the unused fourth byte is left out
+	unsigned int hash = 2166136261u;
+	for(size_t i = 0; i < (size_t)w * h * 4; i++) {
+		if((i & 3) == 3) continue;
+		hash = (hash ^ bits[i]) * 16777619u;
+	}
+	return hash;
+}
+
+bool TFrameBuffer::SavePPM(const char *filename) const {
+	FILE *f = fopen(filename, "wb");
+	if(f == 0) return false;
+	fprintf(f, "P6\n%d %d\n255\n", w, h);
+	std::vector<unsigned char> row(w * 3 + 1);
+	bool ok = true;
+	for(int y = 0; y < h && ok; y++) {
+		const unsigned char *in = &bits[y * w * 4];
+		for(int x = 0; x < w; x++) {
+			row[x * 3] = in[x * 4 + 2]; row[x * 3 + 1] = in[x * 4 + 1]; row[x * 3 + 2] = in[x * 4];
+		}
+		ok = fwrite(&row[0], 1, w * 3, f) == (size_t)w * 3;
+	}
+	return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,35 @@
+//Frame buffer
+#if !defined(FRAMEBUFFER_H_INCLUDED_)
+#define FRAMEBUFFER_H_INCLUDED_
+
+#include <vector>
+#include "RenderTarget.h"
+
+// TFrameBuffer: a render target in ordinary memory, 32bpp BGRx, top row
+// first. Everything is done in plain C++, including the text, which uses a
+// built-in 5x8 font, so it runs anywhere and gives the same pixels anywhere.
+class TFrameBuffer : public TRenderTarget {
+public:
+	TFrameBuffer(int w, int h);
+	int Width() const { return w; }
+	int Height() const { return h; }
+	void SetClip(const TRect &r);
+	void Blit(int x, int y, const TSurface &src);
+	void Stretch(const TRect &dst, const TSurface &src);
+	void DrawSprite(int x, int y, const TSprite &sprite);
+	void Text(int x, int y, const char *text, int len, TColor color);
+	void TextSize(const char *text, int len, int &tw, int &th);
+	//
+	TSurface Surface() { return TSurface(w, h, w * 4, 32, &bits[0]); }
+	// Checksum: a hash of the pixels, for comparing frames between runs
+	unsigned int Checksum() const;
+	// SavePPM: writes the frame as a binary PPM. Returns false on failure.
+	bool SavePPM(const char *filename) const;
+
+private:
+	int w, h;
+	std::vector<unsigned char> bits;
+	TRect clip;
+};
+
+#endif //FRAMEBUFFER_H_INCLUDED_
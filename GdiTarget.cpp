@@ -0,0 +1,70 @@
+#include "GdiTarget.h"
+#include "Sprite.h"
+#include <stdlib.h>
+
+// DibBlt: copies the part r of a 32bpp surface to (x, y), 1:1. The BITMAPINFO
+// describes just the rows of r, so that the source y is always 0: that way we
+// don't have to care which way up StretchDIBits counts for top-down DIBs.
+static void DibBlt(HDC hdc, int x, int y, const TSurface &src, const TRect &r, DWORD rop) {
+	BITMAPINFO bmi; ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = abs(src.stride) / 4;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+	const unsigned char *bits;
+	if(src.stride > 0) {
+		bits = src.Row(r.top);
+		bmi.bmiHeader.biHeight = -r.Height();
+	}
+	else {
+		bits = src.Row(r.bottom - 1);
+		bmi.bmiHeader.biHeight = r.Height();
+	}
+	StretchDIBits(hdc, x, y, r.Width(), r.Height(), r.left, 0, r.Width(), r.Height(), bits, &bmi, DIB_RGB_COLORS, rop);
+}
+
+void TGdiTarget::SetClip(const TRect &r) {
+	clip = r.Intersect(TRect(0, 0, w, h));
+	HRGN rgn = CreateRectRgn(clip.left, clip.top, clip.right, clip.bottom);
+	SelectClipRgn(hdc, rgn);
+	DeleteObject(rgn);
+}
+
+void TGdiTarget::Blit(int x, int y, const TSurface &src) {
+	if(!src.IsValid() || src.bpp != 32) return;
+	TRect d = TRect(x, y, x + src.w, y + src.h).Intersect(clip);
+	if(d.IsEmpty()) return;
+	DibBlt(hdc, d.left, d.top, src, TRect(d.left - x, d.top - y, d.right - x, d.bottom - y), SRCCOPY);
+}
+
+void TGdiTarget::Stretch(const TRect &dst, const TSurface &src) {
+	if(!src.IsValid() || src.bpp != 32 || dst.IsEmpty()) return;
+	SetStretchBltMode(hdc, COLORONCOLOR);
+	BITMAPINFO bmi; ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = abs(src.stride) / 4;
+	bmi.bmiHeader.biHeight = src.stride > 0 ? -src.h : src.h;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+	const unsigned char *bits = src.stride > 0 ? src.Row(0) : src.Row(src.h - 1);
+	StretchDIBits(hdc, dst.left, dst.top, dst.Width(), dst.Height(), 0, 0, src.w, src.h, bits, &bmi, DIB_RGB_COLORS, SRCCOPY);
+}
+
+void TGdiTarget::DrawSprite(int x, int y, const TSprite &sprite) {
+	GdiFlush(); // GDI may still be drawing into buffer
+	SpanBlit(buffer, clip, x, y, sprite);
+}
+
+void TGdiTarget::Text(int x, int y, const char *text, int len, TColor color) {
+	SetBkMode(hdc, TRANSPARENT);
+	SetTextColor(hdc, color);
+	TextOut(hdc, x, y, text, len);
+}
+
+void TGdiTarget::TextSize(const char *text, int len, int &tw, int &th) {
+	SIZE sz; GetTextExtentPoint32(hdc, text, len, &sz);
+	tw = sz.cx;
+	th = sz.cy;
+}
@@ -0,0 +1,33 @@
+//GDI render target
+#if !defined(GDITARGET_H_INCLUDED_)
+#define GDITARGET_H_INCLUDED_
+
+#include <windows.h>
+#include "RenderTarget.h"
+
+// TGdiTarget: draws with GDI onto a memory DC which has a 32bpp DIB section
+// selected into it, whose bits are given as buffer. Sources are blitted
+// straight from their bits with StretchDIBits, so they needn't be GDI bitmaps
+// themselves. Sprites are blended in software, directly into buffer: GDI has
+// no single-pass premultiplied blit that works from plain memory.
+class TGdiTarget : public TRenderTarget {
+public:
+	TGdiTarget(HDC _hdc, const TSurface &_buffer) : hdc(_hdc), buffer(_buffer), w(_buffer.w), h(_buffer.h), clip(0, 0, _buffer.w, _buffer.h) {}
+	~TGdiTarget() { SelectClipRgn(hdc, NULL); }
+	int Width() const { return w; }
+	int Height() const { return h; }
+	void SetClip(const TRect &r);
+	void Blit(int x, int y, const TSurface &src);
+	void Stretch(const TRect &dst, const TSurface &src);
+	void DrawSprite(int x, int y, const TSprite &sprite);
+	void Text(int x, int y, const char *text, int len, TColor color);
+	void TextSize(const char *text, int len, int &tw, int &th);
+
+private:
+	HDC hdc;
+	TSurface buffer;
+	int w, h;
+	TRect clip;
+};
+
+#endif //GDITARGET_H_INCLUDED_
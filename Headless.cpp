@@ -0,0 +1,97 @@
+// Headless saver: plays the scene into memory, with no window, for profiling
+// and for checking frames on machines without a display.
+//
+//   headless frames stepMs [ppmPrefix] [-size WxH] [-sprites N] [-background file.jpg]
+//
+// It prints the checksum of the last frame, which is the same on every run
+// and every platform for the same arguments, and the time per frame. With a
+// ppmPrefix, frame i is also saved as <ppmPrefix><i>.ppm. Without a
+// background, a made-up one is shown, and the sprite is always made up.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "Scene.h"
+#include "Jpeg.h"
+
+const unsigned int FADETIME = 255 * 50; // as the saver has it
+const int SPRITERAMP = 48;
+
+static bool LoadFile(const char *filename, std::vector<unsigned char> &data) {
+	FILE *f = fopen(filename, "rb");
+	if(f == 0) return false;
+	unsigned char buf[65536]; size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	return true;
+}
+
+static int Usage() {
+	fprintf(stderr, "usage: headless frames stepMs [ppmPrefix] [-size WxH] [-sprites N] [-background file.jpg]\n");
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	int frames = 0, step = 0, w = 1280, h = 720, nsprites = 1;
+	const char *prefix = 0, *bgfile = 0;
+	int positional = 0;
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+			if(sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) return Usage();
+		} else if(strcmp(argv[i], "-sprites") == 0 && i + 1 < argc) nsprites = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-background") == 0 && i + 1 < argc) bgfile = argv[++i];
+		else if(positional == 0) { frames = atoi(argv[i]); positional++; }
+		else if(positional == 1) { step = atoi(argv[i]); positional++; }
+		else if(positional == 2) { prefix = argv[i]; positional++; }
+		else return Usage();
+	}
+	if(positional < 2 || frames <= 0 || step < 0 || nsprites < 1) return Usage();
+
+	// the background: a jpeg, or a gradient
+	std::vector<unsigned char> bgbits;
+	TSurface background;
+	if(bgfile != 0) {
+		std::vector<unsigned char> data;
+		TJpegDecoder dec;
+		if(!LoadFile(bgfile, data)) { fprintf(stderr, "can't read %s\n", bgfile); return 1; }
+		if(!dec.ReadHeader(&data[0], data.size())) { fprintf(stderr, "%s: %s\n", bgfile, dec.Error()); return 1; }
+		int bw = dec.Width(), bh = dec.Height();
+		bgbits.resize((size_t)bw * bh * 4);
+		background = TSurface(bw, bh, bw * 4, 32, &bgbits[0]);
+		if(!dec.Decode(background, 1)) { fprintf(stderr, "%s: %s\n", bgfile, dec.Error()); return 1; }
+	} else {
+		const int bw = 320, bh = 200;
+		bgbits.resize(bw * bh * 3);
+		for(int y = 0; y < bh; y++)
+			for(int x = 0; x < bw; x++) {
+				unsigned char *p = &bgbits[(y * bw + x) * 3];
+				p[0] = (unsigned char)(x * 255 / bw); p[1] = (unsigned char)(y * 255 / bh); p[2] = 160;
+			}
+		background = TSurface(bw, bh, bw * 3, 24, &bgbits[0]);
+	}
+	// the sprite: a shaded ball on a magenta key
+	const int ss = 64;
+	std::vector<unsigned char> sprbits(ss * ss * 3);
+	for(int y = 0; y < ss; y++)
+		for(int x = 0; x < ss; x++) {
+			unsigned char *p = &sprbits[(y * ss + x) * 3];
+			int dx = x - ss / 2, dy = y - ss / 2, d2 = dx * dx + dy * dy, r = ss / 2 - 2;
+			if(d2 >= r * r) { p[0] = 255; p[1] = 0; p[2] = 255; continue; }
+			int shade = 255 - d2 * 160 / (r * r);
+			p[0] = (unsigned char)(shade / 3); p[1] = (unsigned char)shade; p[2] = (unsigned char)(shade / 2);
+		}
+
+	TSaverScene scene;
+	scene.SetBackground(background);
+	scene.SetSprite(TSurface(ss, ss, ss * 3, 24, &sprbits[0]), 0, SPRITERAMP);
+	scene.SetSpriteCount(nsprites);
+	scene.SetCaption("headless");
+	scene.Start(w, h, 0, FADETIME, 1);
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	unsigned int checksum = RunHeadless(scene, frames, 0, step, prefix);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	printf("checksum %08x\n", checksum);
+	printf("%d frames of %dx%d, %d sprites: %.3f ms/frame\n", frames, w, h, nsprites, ms / frames);
+	return 0;
+}
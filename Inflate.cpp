@@ -0,0 +1,440 @@
+#include "Inflate.h"
+#include <string.h>
+
+typedef unsigned int TEntry;
+
+// Table entries. A literal or a base (of a length or distance) gives its value,
+// and for a base how many extra bits follow; a link gives the offset of a
+// second-level table and how many more bits index it. bits is how many bits
+// of code the entry accounts for.
+enum {
+	OP_LIT  = 0x00,
+	OP_BASE = 0x10, // | extra bits
+	OP_END  = 0x20,
+	OP_LINK = 0x40, // | second-level index bits
+	OP_BAD  = 0x80
+};
+static const unsigned int LENROOT = 10, DISTROOT = 8, CODEROOT = 7;
+
+static inline TEntry MakeEntry(unsigned int value, unsigned int op, unsigned int bits) {
+	return (value << 16) | (op << 8) | bits;
+}
+static inline unsigned int EntryOp(TEntry e) { return (e >> 8) & 0xff; }
+
+// RFC 1951 3.2.5
+static const unsigned short LENBASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char LENEXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short DISTBASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char DISTEXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned char CODEORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+enum TCodeKind {ckCodes, ckLens, ckDists};
+
+static TEntry SymbolEntry(TCodeKind kind, unsigned int sym) {
+	if(kind == ckCodes) return MakeEntry(sym, OP_LIT, 0);
+	if(kind == ckDists) return sym < 30 ? MakeEntry(DISTBASE[sym], OP_BASE | DISTEXTRA[sym], 0) : MakeEntry(0, OP_BAD, 0);
+	if(sym < 256) return MakeEntry(sym, OP_LIT, 0);
+	if(sym == 256) return MakeEntry(0, OP_END, 0);
+	if(sym < 286) return MakeEntry(LENBASE[sym - 257], OP_BASE | LENEXTRA[sym - 257], 0);
+	return MakeEntry(0, OP_BAD, 0);
+}
+
+// BuildTable: makes the decoding table for the canonical code with lengths
+// lens[0..n). A code no longer than root bits fills every entry of the first
+// level whose low bits are its (bit-reversed) code; longer ones share a second
+// level per root-bit prefix, sized for the longest code under that prefix.
+// Codes have to be complete, except that a single code of length 1 is allowed
+// (as zlib allows), and so is no code at all, which leaves every entry bad.
+static bool BuildTable(const unsigned char *lens, unsigned int n, TCodeKind kind, unsigned int root, TEntry *table, unsigned int size) {
+	unsigned int count[16] = {0};
+	for(unsigned int i = 0; i < n; i++) count[lens[i]]++;
+	count[0] = 0;
+	int left = 1;
+	for(int len = 1; len <= 15; len++) {
+		left = (left << 1) - (int)count[len];
+		if(left < 0) return false;                 // over-subscribed
+	}
+	unsigned int max = 15;
+	while(max > 0 && count[max] == 0) max--;
+	if(left > 0 && max > 0 && (kind == ckCodes || max != 1)) return false; // incomplete
+	unsigned int rootsize = 1u << root;
+	for(unsigned int i = 0; i < rootsize; i++) table[i] = MakeEntry(0, OP_BAD, root);
+	if(max == 0) return true;
+
+	unsigned int next[16], code = 0;
+	for(int len = 1; len <= 15; len++) {
+		code = (code + count[len - 1]) << 1;
+		next[len] = code;
+	}
+	unsigned short rev[320];
+	unsigned char sublen[1 << 10] = {0};
+	for(unsigned int sym = 0; sym < n; sym++) {
+		unsigned int len = lens[sym];
+		if(len == 0) continue;
+		unsigned int c = next[len]++, r = 0;
+		for(unsigned int b = 0; b < len; b++) { r = (r << 1) | (c & 1); c >>= 1; }
+		rev[sym] = (unsigned short)r;
+		if(len > root && len - root > sublen[r & (rootsize - 1)]) sublen[r & (rootsize - 1)] = (unsigned char)(len - root);
+	}
+	unsigned int used = rootsize;
+	for(unsigned int p = 0; p < rootsize; p++) {
+		if(sublen[p] == 0) continue;
+		unsigned int subsize = 1u << sublen[p];
+		if(used + subsize > size) return false;
+		table[p] = MakeEntry(used, OP_LINK | sublen[p], root);
+		for(unsigned int i = 0; i < subsize; i++) table[used + i] = MakeEntry(0, OP_BAD, sublen[p]);
+		used += subsize;
+	}
+	for(unsigned int sym = 0; sym < n; sym++) {
+		unsigned int len = lens[sym];
+		if(len == 0) continue;
+		TEntry e = SymbolEntry(kind, sym);
+		if(len <= root) {
+			for(unsigned int i = rev[sym]; i < rootsize; i += 1u << len) table[i] = e | len;
+		} else {
+			unsigned int p = rev[sym] & (rootsize - 1);
+			TEntry *sub = table + (table[p] >> 16);
+			for(unsigned int i = rev[sym] >> root; i < (1u << sublen[p]); i += 1u << (len - root)) sub[i] = e | (len - root);
+		}
+	}
+	return true;
+}
+
+// The tables for fixed-code blocks, made the first time they're wanted
+struct TFixedTables {
+	TEntry lens[1 << LENROOT], dists[1 << DISTROOT];
+	TFixedTables() {
+		unsigned char l[288];
+		memset(l, 8, 144); memset(l + 144, 9, 112); memset(l + 256, 7, 24); memset(l + 280, 8, 8);
+		BuildTable(l, 288, ckLens, LENROOT, lens, 1 << LENROOT);
+		memset(l, 5, 32);
+		BuildTable(l, 32, ckDists, DISTROOT, dists, 1 << DISTROOT);
+	}
+};
+
+static const TFixedTables &FixedTables() {
+	static const TFixedTables fixed;
+	return fixed;
+}
+
+// CopyMatch: copies len bytes from dist back, where the two may overlap. It
+// works in 16 or 8 byte pieces, so it may write up to 15 bytes past op+len.
+static inline void CopyMatch(unsigned char *op, unsigned int len, unsigned int dist) {
+	const unsigned char *from = op - dist;
+	unsigned char *end = op + len;
+	if(dist >= 16) {
+		do { memcpy(op, from, 16); op += 16; from += 16; } while(op < end);
+	} else if(dist >= 8) {
+		do { memcpy(op, from, 8); op += 8; from += 8; } while(op < end);
+	} else if(dist == 1) {
+		memset(op, *from, len);
+	} else {
+		// a short repeating pattern: write out its first 8 bytes one at a time,
+		// then copy 8 at a time from a whole number of periods back
+		for(int i = 0; i < 8; i++) op[i] = from[i];
+		unsigned int period = dist;
+		while(period < 8) period += dist;
+		for(op += 8; op < end; op += 8) memcpy(op, op - period, 8);
+	}
+}
+
+// MARGIN: how much output room Fast() needs for a longest match plus its overrun
+static const size_t MARGIN = 258 + 16;
+
+TInflater::TInflater() : lcode(0), dcode(0), wpos(0), rpos(0) {
+	Reset();
+}
+
+void TInflater::Reset() {
+	state = sHeader;
+	lastblock = false;
+	bitbuf = 0; bitcnt = 0; pad = 0;
+	in = inend = 0; last = false;
+	stored = 0; copylen = 0; copydist = 0;
+	nlen = ndist = ncode = have = 0;
+	wpos = rpos = 0;
+	error = 0;
+}
+
+// Refill: tops the bit buffer up to 56..63 bits, if there's the input.
+// With 8 bytes to hand it loads them all at once, and counts only the whole
+// bytes that fit; the bits of the rest that were loaded too are the same ones
+// the next refill loads again, so they do no harm. The input is taken to be
+// little-endian, as every target this builds for is.
+inline void TInflater::Refill() {
+	if(inend - in >= 8) {
+		unsigned long long w;
+		memcpy(&w, in, 8);
+		bitbuf |= w << bitcnt;
+		in += (63 - bitcnt) >> 3;
+		bitcnt |= 56;
+	} else {
+		while(bitcnt < 56 && in < inend) {
+			bitbuf |= (unsigned long long)*in++ << bitcnt;
+			bitcnt += 8;
+		}
+	}
+}
+
+// Need: makes sure there are n bits in the buffer. Once the input has run out
+// for good it makes them up with zeros, and Decode() fails if it uses any;
+// otherwise it returns false, to wait for more input.
+inline bool TInflater::Need(unsigned int n) {
+	if(bitcnt >= n) return true;
+	Refill();
+	if(bitcnt >= n) return true;
+	if(!last) return false;
+	bitbuf &= bitcnt == 0 ? 0 : ~0ull >> (64 - bitcnt);
+	pad += 64 - bitcnt;
+	bitcnt = 64;
+	return true;
+}
+
+// Fast: decodes symbols while there are at least 8 bytes of input and MARGIN
+// bytes of output room, so that nothing has to be checked for running out
+// part way through one. It keeps the bit buffer in locals for speed. Returns
+// false if it failed.
+bool TInflater::Fast(unsigned char *base, unsigned char *&op, unsigned char *oend) {
+	unsigned long long bb = bitbuf;
+	unsigned int bc = bitcnt;
+	const unsigned char *ip = in;
+	unsigned char *o = op;
+	const TEntry *lc = lcode, *dc = dcode;
+	bool ok = true;
+	while(inend - ip >= 8 && (size_t)(oend - o) >= MARGIN) {
+		unsigned long long w;
+		memcpy(&w, ip, 8);
+		bb |= w << bc;
+		ip += (63 - bc) >> 3;
+		bc |= 56;
+		// 56 bits is enough for a length code, its extra bits, a distance code and its extra bits
+		TEntry e = lc[bb & ((1u << LENROOT) - 1)];
+		if(EntryOp(e) & OP_LINK) {
+			bb >>= LENROOT; bc -= LENROOT;
+			e = lc[(e >> 16) + ((unsigned int)bb & ((1u << (EntryOp(e) & 15)) - 1))];
+		}
+		bb >>= e & 0xff; bc -= e & 0xff;
+		unsigned int eop = EntryOp(e);
+		if(eop == OP_LIT) {
+			*o++ = (unsigned char)(e >> 16);
+			// often another literal follows, and there are still the bits for it
+			e = lc[bb & ((1u << LENROOT) - 1)];
+			if(EntryOp(e) == OP_LIT && bc >= 15) {
+				bb >>= e & 0xff; bc -= e & 0xff;
+				*o++ = (unsigned char)(e >> 16);
+			}
+			continue;
+		}
+		if(eop & OP_BASE) {
+			unsigned int extra = eop & 15;
+			unsigned int len = (e >> 16) + ((unsigned int)bb & ((1u << extra) - 1));
+			bb >>= extra; bc -= extra;
+			e = dc[bb & ((1u << DISTROOT) - 1)];
+			if(EntryOp(e) & OP_LINK) {
+				bb >>= DISTROOT; bc -= DISTROOT;
+				e = dc[(e >> 16) + ((unsigned int)bb & ((1u << (EntryOp(e) & 15)) - 1))];
+			}
+			bb >>= e & 0xff; bc -= e & 0xff;
+			eop = EntryOp(e);
+			if(!(eop & OP_BASE)) { ok = Fail("invalid distance code"); break; }
+			extra = eop & 15;
+			unsigned int dist = (e >> 16) + ((unsigned int)bb & ((1u << extra) - 1));
+			bb >>= extra; bc -= extra;
+			if(dist > (size_t)(o - base)) { ok = Fail("invalid distance too far back"); break; }
+			CopyMatch(o, len, dist);
+			o += len;
+			continue;
+		}
+		if(eop == OP_END) { state = sHeader; break; }
+		ok = Fail("invalid literal/length code");
+		break;
+	}
+	bitbuf = bb; bitcnt = bc; in = ip; op = o;
+	return ok;
+}
+
+// Decode: runs the decoder on from where it got to, writing at op, which
+// is moved on, up to oend. Matches may refer back as far as base. Returns true
+// if it stopped to wait for more input, false if the output is full, or the
+// stream is done, or it failed.
+bool TInflater::Decode(unsigned char *base, unsigned char *&op, unsigned char *oend) {
+	for(;;) {
+		if(bitcnt < pad) return Fail("unexpected end of data");
+		switch(state) {
+		case sHeader:
+			if(lastblock) { state = sDone; return false; }
+			if(!Need(3)) return true;
+			lastblock = (bitbuf & 1) != 0;
+			switch(Bits(3) >> 1) {
+			case 0: state = sStoredLen; break;
+			case 1: lcode = FixedTables().lens; dcode = FixedTables().dists; state = sCodes; break;
+			case 2: state = sTable; break;
+			default: return Fail("invalid block type");
+			}
+			Drop(3);
+			if(state == sStoredLen) Drop(bitcnt & 7); // to a byte boundary
+			break;
+		case sStoredLen:
+			if(!Need(32)) return true;
+			if((bitbuf & 0xffff) != (~(bitbuf >> 16) & 0xffff)) return Fail("invalid stored block lengths");
+			stored = Bits(16);
+			Drop(32);
+			state = sStored;
+			break;
+		case sStored:
+			// first whatever whole bytes are in the bit buffer, then straight from the input
+			while(stored > 0 && bitcnt >= 8 && op < oend) {
+				*op++ = (unsigned char)bitbuf;
+				Drop(8);
+				stored--;
+			}
+			if(stored > 0 && bitcnt == 0) {
+				size_t n = stored;
+				if(n > (size_t)(inend - in)) n = inend - in;
+				if(n > (size_t)(oend - op)) n = oend - op;
+				memcpy(op, in, n);
+				op += n; in += n; stored -= (unsigned int)n;
+				bitbuf = 0;
+			}
+			if(stored == 0) { state = sHeader; break; }
+			if(op == oend) return false;
+			if(in == inend) {
+				if(!last) return true;
+				return Fail("unexpected end of data");
+			}
+			break;
+		case sTable:
+			if(!Need(14)) return true;
+			nlen = Bits(5) + 257;
+			ndist = ((unsigned int)(bitbuf >> 5) & 31) + 1;
+			ncode = ((unsigned int)(bitbuf >> 10) & 15) + 4;
+			Drop(14);
+			if(nlen > 286 || ndist > 30) return Fail("too many length or distance symbols");
+			have = 0;
+			state = sLenLens;
+			break;
+		case sLenLens:
+			while(have < ncode) {
+				if(!Need(3)) return true;
+				lens[CODEORDER[have++]] = (unsigned char)Bits(3);
+				Drop(3);
+			}
+			while(have < 19) lens[CODEORDER[have++]] = 0;
+			if(!BuildTable(lens, 19, ckCodes, CODEROOT, lentable, ENOUGHLENS)) return Fail("invalid code lengths set");
+			have = 0;
+			state = sCodeLens;
+			break;
+		case sCodeLens:
+			while(have < nlen + ndist) {
+				if(!Need(14)) return true; // a 7 bit code and up to 7 extra bits
+				TEntry e = lentable[Bits(CODEROOT)];
+				if(EntryOp(e) == OP_BAD) return Fail("invalid code lengths set");
+				Drop(e & 0xff);
+				unsigned int sym = e >> 16, rep, val = 0;
+				if(sym < 16) { lens[have++] = (unsigned char)sym; continue; }
+				if(sym == 16) {
+					if(have == 0) return Fail("invalid bit length repeat");
+					val = lens[have - 1];
+					rep = 3 + Bits(2); Drop(2);
+				} else if(sym == 17) {
+					rep = 3 + Bits(3); Drop(3);
+				} else {
+					rep = 11 + Bits(7); Drop(7);
+				}
+				if(have + rep > nlen + ndist) return Fail("invalid bit length repeat");
+				while(rep--) lens[have++] = (unsigned char)val;
+			}
+			if(lens[256] == 0) return Fail("invalid code -- missing end-of-block");
+			if(!BuildTable(lens, nlen, ckLens, LENROOT, lentable, ENOUGHLENS)) return Fail("invalid literal/lengths set");
+			if(!BuildTable(lens + nlen, ndist, ckDists, DISTROOT, disttable, ENOUGHDISTS)) return Fail("invalid distances set");
+			lcode = lentable; dcode = disttable;
+			state = sCodes;
+			break;
+		case sCodes: {
+			// the rest of a match that didn't fit last time
+			while(copylen > 0 && op < oend) {
+				*op = op[-(ptrdiff_t)copydist];
+				op++; copylen--;
+			}
+			if(copylen > 0) return false;
+			if(!Fast(base, op, oend)) return false;
+			if(state != sCodes) break;
+			// near the end of the input or the output, one symbol at a time
+			if(!Need(48)) return true;
+			TEntry e = lcode[Bits(LENROOT)];
+			unsigned int drop = 0;
+			if(EntryOp(e) & OP_LINK) {
+				drop = LENROOT;
+				e = lcode[(e >> 16) + ((unsigned int)(bitbuf >> LENROOT) & ((1u << (EntryOp(e) & 15)) - 1))];
+			}
+			unsigned int eop = EntryOp(e);
+			if(op == oend && eop != OP_END) return false; // an end of block needs no room
+			Drop(drop + (e & 0xff));
+			if(bitcnt < pad) return Fail("unexpected end of data"); // before writing anything made up
+			if(eop == OP_LIT) { *op++ = (unsigned char)(e >> 16); break; }
+			if(eop == OP_END) { state = sHeader; break; }
+			if(!(eop & OP_BASE)) return Fail("invalid literal/length code");
+			unsigned int len = (e >> 16) + Bits(eop & 15);
+			Drop(eop & 15);
+			e = dcode[Bits(DISTROOT)];
+			if(EntryOp(e) & OP_LINK) {
+				Drop(DISTROOT);
+				e = dcode[(e >> 16) + Bits(EntryOp(e) & 15)];
+			}
+			Drop(e & 0xff);
+			eop = EntryOp(e);
+			if(!(eop & OP_BASE)) return Fail("invalid distance code");
+			unsigned int dist = (e >> 16) + Bits(eop & 15);
+			Drop(eop & 15);
+			if(bitcnt < pad) return Fail("unexpected end of data");
+			if(dist > (size_t)(op - base)) return Fail("invalid distance too far back");
+			copylen = len; copydist = dist;
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+}
+
+TInflateStatus TInflater::Stream(const unsigned char *&next, const unsigned char *end, bool lastin,
+	unsigned char *&out, unsigned char *outend) {
+	if(window.empty()) window.resize(WSIZE + BUFSIZE);
+	in = next; inend = end; last = lastin;
+	for(;;) {
+		size_t n = wpos - rpos;
+		if(n > (size_t)(outend - out)) n = outend - out;
+		memcpy(out, window.data() + rpos, n);
+		out += n; rpos += n;
+		if(rpos < wpos) break;                  // the caller's buffer is full
+		if(state == sDone || state == sError) break;
+		if(window.size() - wpos < MARGIN && wpos > WSIZE) {
+			// keep just what matches can still refer to
+			memmove(window.data(), window.data() + wpos - WSIZE, WSIZE);
+			wpos = rpos = WSIZE;
+		}
+		unsigned char *base = window.data(), *op = base + wpos;
+		bool starved = Decode(base, op, base + window.size());
+		wpos = op - base;
+		if(starved && rpos == wpos) break;
+	}
+	next = in;
+	in = inend = 0;
+	if(state == sError) return isError;
+	return state == sDone && rpos == wpos ? isEnd : isMore;
+}
+
+TInflateStatus TInflater::Whole(const unsigned char *src, size_t srclen, unsigned char *out, size_t outlen, size_t &written) {
+	Reset();
+	in = src; inend = src + srclen; last = true;
+	unsigned char *op = out;
+	Decode(out, op, out + outlen);
+	written = op - out;
+	in = inend = 0;
+	if(state == sError) return isError;
+	return state == sDone ? isEnd : isMore;
+}
@@ -0,0 +1,73 @@
+//Inflate
+#if !defined(INFLATE_H_INCLUDED_)
+#define INFLATE_H_INCLUDED_
+
+#include <stddef.h>
+#include <vector>
+
+enum TInflateStatus {
+	isMore,  // needs more input, or more room for output
+	isEnd,   // the final block is decoded, and all of it handed out
+	isError  // the data is bad: see Error()
+};
+
+// TInflater: a decoder for raw deflate data (RFC 1951), as stored in zip
+// entries. It takes bits from the input 64 at a time; most codes are found
+// with a single table lookup, and only codes longer than the table's index go
+// on to a small second-level table; and matches are copied 8 or 16 bytes at a
+// time rather than byte by byte.
+//
+// Stream() decodes through a window of its own, so that it can be fed and
+// drained in pieces of any size. Whole() decodes into the caller's buffer,
+// which has to hold all the output, and finds back-references in that buffer
+// itself: it doesn't need a window at all.
+class TInflater {
+public:
+	TInflater();
+	// Reset: gets ready for a new stream. The window is kept for reuse.
+	void Reset();
+	// Stream: decodes from [in, inend) into [out, outend), and moves in and out
+	// on past what it used. last says that inend is the end of all the input;
+	// until then, the decoder may leave a few bytes unread while it waits for more.
+	TInflateStatus Stream(const unsigned char *&in, const unsigned char *inend, bool last,
+		unsigned char *&out, unsigned char *outend);
+	// Whole: decodes a whole stream from in into out in one go, and says how
+	// much it wrote. Returns isMore if outlen wasn't enough.
+	TInflateStatus Whole(const unsigned char *in, size_t inlen, unsigned char *out, size_t outlen, size_t &written);
+	const char *Error() const { return error; }
+
+private:
+	typedef unsigned int TEntry;       // a decoding table entry: value << 16 | op << 8 | bits
+	TInflater(const TInflater&) = delete;
+	TInflater &operator=(const TInflater&) = delete;
+	enum TState {sHeader, sStoredLen, sStored, sTable, sLenLens, sCodeLens, sCodes, sDone, sError};
+	enum { WSIZE = 32768 };          // the furthest back a match can reach
+	enum { BUFSIZE = 3 * 32768 };    // how much Stream() decodes between slides of its window
+	enum { ENOUGHLENS = 2048, ENOUGHDISTS = 1024 }; // table sizes, with room for the second levels
+	bool Decode(unsigned char *base, unsigned char *&op, unsigned char *oend);
+	bool Fast(unsigned char *base, unsigned char *&op, unsigned char *oend);
+	void Refill();
+	bool Need(unsigned int n);
+	unsigned int Bits(unsigned int n) const { return (unsigned int)bitbuf & ((1u << n) - 1); }
+	void Drop(unsigned int n) { bitbuf >>= n; bitcnt -= n; }
+	bool Fail(const char *msg) { error = msg; state = sError; return false; }
+
+	TState state;
+	bool lastblock;                    // the current block is the final one
+	unsigned long long bitbuf;         // bits not used yet, first in the low bits
+	unsigned int bitcnt;               // how many of them there are
+	unsigned int pad;                  // how many of those are zeros made up after the end of the input
+	const unsigned char *in, *inend;   // the input, for the duration of a call
+	bool last;
+	unsigned int stored;               // bytes left in a stored block
+	unsigned int copylen, copydist;    // the rest of a match that didn't fit in the output
+	unsigned int nlen, ndist, ncode, have; // reading a dynamic block's code lengths
+	unsigned char lens[320];
+	const TEntry *lcode, *dcode;       // the current block's tables: ours, or the fixed ones
+	TEntry lentable[ENOUGHLENS], disttable[ENOUGHDISTS];
+	std::vector<unsigned char> window; // only for Stream()
+	size_t wpos, rpos;                 // decoded up to; handed out up to
+	const char *error;
+};
+
+#endif //INFLATE_H_INCLUDED_
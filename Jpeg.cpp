@@ -0,0 +1,806 @@
+#include "Jpeg.h"
+#include <string.h>
+#include <new>
+#include <stdexcept>
+#if defined(CPU_X86)
+#include <emmintrin.h>
+#endif
+
+// the natural (row-major) index of each coefficient in zigzag order, with
+// some extra at the end so that a bad run can't index off the end
+static const unsigned char ZIGZAG[64 + 16] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+	63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63};
+
+// Dequantized coefficients, and what the first IDCT pass makes of them, are
+// held to this, so that nothing in the IDCT can overflow 32 bits however bad
+// the data. Real images never come near it.
+static const int IDCTLIMIT = 16383;
+// the most the planes and coefficients may take between them: all of them
+// are held at once, and a 32-bit process has 2GB for everything
+static const unsigned long long MAXBYTES = 1ull << 30;
+
+static inline int ClampCoef(int v) { return v < -IDCTLIMIT ? -IDCTLIMIT : v > IDCTLIMIT ? IDCTLIMIT : v; }
+static inline int Dequant(int coef, int q) { return ClampCoef(coef * q); }
+static inline unsigned char Clamp255(int v) { return (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v); }
+// Extend: the value of s magnitude bits v, as in F.2.2.1
+static inline int Extend(unsigned int v, int s) { return v < (1u << (s - 1)) ? (int)v - (1 << s) + 1 : (int)v; }
+
+// DcOnly: what every sample of a block with no AC coefficients comes out as,
+// from the dequantized DC. It's what each of the IDCTs gives for such a block.
+static inline unsigned char DcOnly(int dc) { return Clamp255(((ClampCoef(dc * 4) + 16) >> 5) + 128); }
+
+// Idct1D: one pass of libjpeg's islow IDCT (jidctint.c), with bias added
+// before the shift
+static inline void Idct1D(const int *in, int *out, int bias, int shift) {
+	int z1 = (in[2] + in[6]) * 4433;                 // FIX(0.541196100)
+	int tmp2 = z1 + in[6] * -15137;                  // FIX(1.847759065)
+	int tmp3 = z1 + in[2] * 6270;                    // FIX(0.765366865)
+	int tmp0 = (in[0] + in[4]) * 8192 + bias;
+	int tmp1 = (in[0] - in[4]) * 8192 + bias;
+	int tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3, tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+	int t0 = in[7], t1 = in[5], t2 = in[3], t3 = in[1];
+	z1 = t0 + t3;
+	int z2 = t1 + t2, z3 = t0 + t2, z4 = t1 + t3;
+	int z5 = (z3 + z4) * 9633;                       // FIX(1.175875602)
+	t0 *= 2446; t1 *= 16819; t2 *= 25172; t3 *= 12299;
+	z1 *= -7373; z2 *= -20995; z3 *= -16069; z4 *= -3196;
+	z3 += z5; z4 += z5;
+	t0 += z1 + z3; t1 += z2 + z4; t2 += z2 + z3; t3 += z1 + z4;
+	out[0] = (tmp10 + t3) >> shift; out[7] = (tmp10 - t3) >> shift;
+	out[1] = (tmp11 + t2) >> shift; out[6] = (tmp11 - t2) >> shift;
+	out[2] = (tmp12 + t1) >> shift; out[5] = (tmp12 - t1) >> shift;
+	out[3] = (tmp13 + t0) >> shift; out[4] = (tmp13 - t0) >> shift;
+}
+
+void JpegIdctScalar(const short *coef, const short *quant, unsigned char *out, int stride) {
+	int ws[64], in[8], o[8];
+	for(int x = 0; x < 8; x++) {
+		for(int i = 0; i < 8; i++) in[i] = Dequant(coef[i * 8 + x], quant[i * 8 + x]);
+		Idct1D(in, o, 1 << 10, 11);
+		for(int i = 0; i < 8; i++) ws[i * 8 + x] = ClampCoef(o[i]);
+	}
+	for(int y = 0; y < 8; y++, out += stride) {
+		Idct1D(ws + y * 8, o, (1 << 17) + (128 << 18), 18);
+		for(int x = 0; x < 8; x++) out[x] = Clamp255(o[x]);
+	}
+}
+
+#if defined(CPU_X86)
+CPU_TARGET("sse2")
+static inline __m128i Pair(short a, short b) { return _mm_set_epi16(b, a, b, a, b, a, b, a); }
+
+// IdctHalf: Idct1D on four lanes, from the inputs interleaved in pairs. Each
+// product comes out of madd as 32 bits, and the odd part's sums are multiplied
+// out, so it's exactly the same arithmetic as Idct1D's.
+CPU_TARGET("sse2")
+static inline void IdctHalf(__m128i p04, __m128i p26, __m128i p13, __m128i p57, __m128i bias, __m128i shift, __m128i *out) {
+	__m128i t0 = _mm_add_epi32(_mm_madd_epi16(p04, Pair(8192, 8192)), bias);
+	__m128i t1 = _mm_add_epi32(_mm_madd_epi16(p04, Pair(8192, -8192)), bias);
+	__m128i t2 = _mm_madd_epi16(p26, Pair(4433, -10704));
+	__m128i t3 = _mm_madd_epi16(p26, Pair(10703, 4433));
+	__m128i t10 = _mm_add_epi32(t0, t3), t13 = _mm_sub_epi32(t0, t3);
+	__m128i t11 = _mm_add_epi32(t1, t2), t12 = _mm_sub_epi32(t1, t2);
+	__m128i o0 = _mm_add_epi32(_mm_madd_epi16(p13, Pair(2260, -6436)), _mm_madd_epi16(p57, Pair(9633, -11363)));
+	__m128i o1 = _mm_add_epi32(_mm_madd_epi16(p13, Pair(6437, -11362)), _mm_madd_epi16(p57, Pair(2261, 9633)));
+	__m128i o2 = _mm_add_epi32(_mm_madd_epi16(p13, Pair(9633, -2259)), _mm_madd_epi16(p57, Pair(-11362, -6436)));
+	__m128i o3 = _mm_add_epi32(_mm_madd_epi16(p13, Pair(11363, 9633)), _mm_madd_epi16(p57, Pair(6437, 2260)));
+	out[0] = _mm_sra_epi32(_mm_add_epi32(t10, o3), shift);
+	out[7] = _mm_sra_epi32(_mm_sub_epi32(t10, o3), shift);
+	out[1] = _mm_sra_epi32(_mm_add_epi32(t11, o2), shift);
+	out[6] = _mm_sra_epi32(_mm_sub_epi32(t11, o2), shift);
+	out[2] = _mm_sra_epi32(_mm_add_epi32(t12, o1), shift);
+	out[5] = _mm_sra_epi32(_mm_sub_epi32(t12, o1), shift);
+	out[3] = _mm_sra_epi32(_mm_add_epi32(t13, o0), shift);
+	out[4] = _mm_sra_epi32(_mm_sub_epi32(t13, o0), shift);
+}
+
+// IdctPass: Idct1D down each of the eight lanes of v[0..7], saturating to 16 bits
+CPU_TARGET("sse2")
+static inline void IdctPass(__m128i *v, __m128i bias, __m128i shift) {
+	__m128i lo[8], hi[8];
+	IdctHalf(_mm_unpacklo_epi16(v[0], v[4]), _mm_unpacklo_epi16(v[2], v[6]),
+		_mm_unpacklo_epi16(v[1], v[3]), _mm_unpacklo_epi16(v[5], v[7]), bias, shift, lo);
+	IdctHalf(_mm_unpackhi_epi16(v[0], v[4]), _mm_unpackhi_epi16(v[2], v[6]),
+		_mm_unpackhi_epi16(v[1], v[3]), _mm_unpackhi_epi16(v[5], v[7]), bias, shift, hi);
+	for(int i = 0; i < 8; i++) v[i] = _mm_packs_epi32(lo[i], hi[i]);
+}
+
+CPU_TARGET("sse2")
+static inline void Transpose(__m128i *v) {
+	__m128i a0 = _mm_unpacklo_epi16(v[0], v[1]), a1 = _mm_unpackhi_epi16(v[0], v[1]);
+	__m128i a2 = _mm_unpacklo_epi16(v[2], v[3]), a3 = _mm_unpackhi_epi16(v[2], v[3]);
+	__m128i a4 = _mm_unpacklo_epi16(v[4], v[5]), a5 = _mm_unpackhi_epi16(v[4], v[5]);
+	__m128i a6 = _mm_unpacklo_epi16(v[6], v[7]), a7 = _mm_unpackhi_epi16(v[6], v[7]);
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+	v[0] = _mm_unpacklo_epi64(b0, b4); v[1] = _mm_unpackhi_epi64(b0, b4);
+	v[2] = _mm_unpacklo_epi64(b1, b5); v[3] = _mm_unpackhi_epi64(b1, b5);
+	v[4] = _mm_unpacklo_epi64(b2, b6); v[5] = _mm_unpackhi_epi64(b2, b6);
+	v[6] = _mm_unpacklo_epi64(b3, b7); v[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+CPU_TARGET("sse2")
+void JpegIdctSSE2(const short *coef, const short *quant, unsigned char *out, int stride) {
+	const __m128i limit = _mm_set1_epi16(IDCTLIMIT), nlimit = _mm_set1_epi16(-IDCTLIMIT);
+	__m128i v[8];
+	for(int i = 0; i < 8; i++) {
+		__m128i c = _mm_loadu_si128((const __m128i*)(coef + i * 8));
+		__m128i q = _mm_loadu_si128((const __m128i*)(quant + i * 8));
+		__m128i lo = _mm_mullo_epi16(c, q), hi = _mm_mulhi_epi16(c, q);
+		__m128i d = _mm_packs_epi32(_mm_unpacklo_epi16(lo, hi), _mm_unpackhi_epi16(lo, hi));
+		v[i] = _mm_max_epi16(_mm_min_epi16(d, limit), nlimit);
+	}
+	// the columns, with the rows in lanes; then the rows, the other way round
+	IdctPass(v, _mm_set1_epi32(1 << 10), _mm_cvtsi32_si128(11));
+	for(int i = 0; i < 8; i++) v[i] = _mm_max_epi16(_mm_min_epi16(v[i], limit), nlimit);
+	Transpose(v);
+	IdctPass(v, _mm_set1_epi32((1 << 17) + (128 << 18)), _mm_cvtsi32_si128(18));
+	Transpose(v);
+	for(int i = 0; i < 8; i += 2) {
+		__m128i b = _mm_packus_epi16(v[i], v[i + 1]);
+		_mm_storel_epi64((__m128i*)(out + i * stride), b);
+		_mm_storel_epi64((__m128i*)(out + (i + 1) * stride), _mm_srli_si128(b, 8));
+	}
+}
+#endif
+
+// Idct4, Idct2: libjpeg's reduced IDCTs (jidctred.c), which make 4x4 or 2x2
+// samples from the low coefficients of a block
+static void Idct4(const short *coef, const short *quant, unsigned char *out, int stride) {
+	int ws[8 * 4];
+	for(int x = 0; x < 8; x++) {
+		if(x == 4) continue; // the second pass doesn't use column 4
+		const short *in = coef + x, *q = quant + x;
+		int tmp0 = Dequant(in[0], q[0]) * (1 << 14);
+		int tmp2 = Dequant(in[16], q[16]) * 15137 + Dequant(in[48], q[48]) * -6270;
+		int tmp10 = tmp0 + tmp2, tmp12 = tmp0 - tmp2;
+		int z1 = Dequant(in[56], q[56]), z2 = Dequant(in[40], q[40]), z3 = Dequant(in[24], q[24]), z4 = Dequant(in[8], q[8]);
+		tmp0 = z1 * -1730 + z2 * 11893 + z3 * -17799 + z4 * 8697;
+		tmp2 = z1 * -4176 + z2 * -4926 + z3 * 7373 + z4 * 20995;
+		ws[x] = ClampCoef((tmp10 + tmp2 + (1 << 11)) >> 12);
+		ws[24 + x] = ClampCoef((tmp10 - tmp2 + (1 << 11)) >> 12);
+		ws[8 + x] = ClampCoef((tmp12 + tmp0 + (1 << 11)) >> 12);
+		ws[16 + x] = ClampCoef((tmp12 - tmp0 + (1 << 11)) >> 12);
+	}
+	const int bias = (1 << 18) + (128 << 19);
+	for(int y = 0; y < 4; y++, out += stride) {
+		const int *w = ws + y * 8;
+		int tmp0 = w[0] * (1 << 14);
+		int tmp2 = w[2] * 15137 + w[6] * -6270;
+		int tmp10 = tmp0 + tmp2 + bias, tmp12 = tmp0 - tmp2 + bias;
+		tmp0 = w[7] * -1730 + w[5] * 11893 + w[3] * -17799 + w[1] * 8697;
+		tmp2 = w[7] * -4176 + w[5] * -4926 + w[3] * 7373 + w[1] * 20995;
+		out[0] = Clamp255((tmp10 + tmp2) >> 19);
+		out[3] = Clamp255((tmp10 - tmp2) >> 19);
+		out[1] = Clamp255((tmp12 + tmp0) >> 19);
+		out[2] = Clamp255((tmp12 - tmp0) >> 19);
+	}
+}
+
+static void Idct2(const short *coef, const short *quant, unsigned char *out, int stride) {
+	int ws[8 * 2];
+	for(int x = 0; x < 8; x++) {
+		if(x == 2 || x == 4 || x == 6) continue; // the second pass doesn't use them
+		const short *in = coef + x, *q = quant + x;
+		int tmp10 = Dequant(in[0], q[0]) * (1 << 15);
+		int tmp0 = Dequant(in[56], q[56]) * -5906 + Dequant(in[40], q[40]) * 6967 +
+			Dequant(in[24], q[24]) * -10426 + Dequant(in[8], q[8]) * 29692;
+		ws[x] = ClampCoef((tmp10 + tmp0 + (1 << 12)) >> 13);
+		ws[8 + x] = ClampCoef((tmp10 - tmp0 + (1 << 12)) >> 13);
+	}
+	for(int y = 0; y < 2; y++, out += stride) {
+		const int *w = ws + y * 8;
+		int tmp10 = w[0] * (1 << 15) + (1 << 19) + (128 << 20);
+		int tmp0 = w[7] * -5906 + w[5] * 6967 + w[3] * -10426 + w[1] * 29692;
+		out[0] = Clamp255((tmp10 + tmp0) >> 20);
+		out[1] = Clamp255((tmp10 - tmp0) >> 20);
+	}
+}
+
+void YccToBgrxScalar(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *dst, int n) {
+	for(int i = 0; i < n; i++, dst += 4) {
+		int yy = y[i], b = cb[i] - 128, r = cr[i] - 128;
+		// libjpeg's constants (jdcolor.c), in 16.16
+		dst[0] = Clamp255(yy + ((116130 * b + 32768) >> 16));
+		dst[1] = Clamp255(yy + ((-22554 * b - 46802 * r + 32768) >> 16));
+		dst[2] = Clamp255(yy + ((91881 * r + 32768) >> 16));
+		dst[3] = 0;
+	}
+}
+
+#if defined(CPU_X86)
+// Mul16: (v * k + 32768) >> 16, in 32 bits, saturated back to 16
+CPU_TARGET("sse2")
+static inline __m128i Mul16(__m128i v, __m128i k, __m128i half) {
+	__m128i lo = _mm_mullo_epi16(v, k), hi = _mm_mulhi_epi16(v, k);
+	return _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), half), 16),
+		_mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), half), 16));
+}
+
+// Each of libjpeg's constants that doesn't fit in 16 bits is split into a
+// whole number of 65536s, which is an add, and the rest: so this gives just
+// what YccToBgrxScalar does.
+CPU_TARGET("sse2")
+void YccToBgrxSSE2(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *dst, int n) {
+	const __m128i zero = _mm_setzero_si128(), c128 = _mm_set1_epi16(128), half = _mm_set1_epi32(32768);
+	const __m128i kr = _mm_set1_epi16(26345), kb = _mm_set1_epi16(-14942), kg = Pair(-22554, 18734);
+	int i = 0;
+	for(; i + 8 <= n; i += 8, dst += 32) {
+		__m128i yy = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + i)), zero);
+		__m128i b = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(cb + i)), zero), c128);
+		__m128i r = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(cr + i)), zero), c128);
+		// 91881 = 65536 + 26345; 116130 = 2*65536 - 14942; -46802 = 18734 - 65536
+		__m128i R = _mm_add_epi16(yy, _mm_add_epi16(r, Mul16(r, kr, half)));
+		__m128i B = _mm_add_epi16(yy, _mm_add_epi16(_mm_add_epi16(b, b), Mul16(b, kb, half)));
+		__m128i br0 = _mm_unpacklo_epi16(b, r), br1 = _mm_unpackhi_epi16(b, r);
+		__m128i g = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(br0, kg), half), 16),
+			_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(br1, kg), half), 16));
+		__m128i G = _mm_add_epi16(yy, _mm_sub_epi16(g, r));
+		__m128i bg = _mm_unpacklo_epi8(_mm_packus_epi16(B, B), _mm_packus_epi16(G, G));
+		__m128i rx = _mm_unpacklo_epi8(_mm_packus_epi16(R, R), zero);
+		_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(bg, rx));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(bg, rx));
+	}
+	YccToBgrxScalar(y + i, cb + i, cr + i, dst, n - i);
+}
+#endif
+
+typedef void (*TIdctKernel)(const short *coef, const short *quant, unsigned char *out, int stride);
+typedef void (*TYccKernel)(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *dst, int n);
+
+static TIdctKernel ChooseIdct() {
+#if defined(CPU_X86)
+	if(CpuHas(cfSSE2)) return JpegIdctSSE2;
+#endif
+	return JpegIdctScalar;
+}
+
+static TYccKernel ChooseYcc() {
+#if defined(CPU_X86)
+	if(CpuHas(cfSSE2)) return YccToBgrxSSE2;
+#endif
+	return YccToBgrxScalar;
+}
+
+TJpegDecoder::TJpegDecoder() : data(0), end(0), pos(0), width(0), height(0), ncomp(0), hmax(1), vmax(1),
+	progressive(false), frame(false), jfif(false), adobe(-1), restart(0), ns(0), kind(skBaseline),
+	ss(0), se(63), ah(0), al(0), eobrun(0), bp(0), bitbuf(0), bitcnt(0), atmarker(false), error(0) {
+}
+
+bool TJpegDecoder::ReadHeader(const unsigned char *_data, size_t len) {
+	data = _data; end = _data + len; pos = _data;
+	width = height = ncomp = 0; hmax = vmax = 1;
+	progressive = frame = jfif = false;
+	adobe = -1; restart = 0; error = 0;
+	for(int i = 0; i < 4; i++) qdefined[i] = dcdefined[i] = acdefined[i] = false;
+	if(len < 2 || data[0] != 0xFF || data[1] != 0xD8) return Fail("not a JPEG");
+	pos += 2;
+	return Markers(true);
+}
+
+bool TJpegDecoder::Decode(const TSurface &dst, int scale) {
+	if(scale != 1 && scale != 2 && scale != 4 && scale != 8) return Fail("the scale has to be 1, 2, 4 or 8");
+	if(data == 0) return Fail("there's no header");
+	// the tables are read again, as they may change between scans
+	if(!ReadHeader(data, end - data)) return false;
+	if(!dst.IsValid() || dst.w != Scaled(width, scale) || dst.h != Scaled(height, scale)) return Fail("the surface is the wrong size");
+	try {
+		if(!Setup(scale) || !Markers(false)) return false;
+		if(progressive) {
+			for(int i = 0; i < ncomp; i++) {
+				TComponent &c = comp[i];
+				for(int by = 0; by < c.bh; by++)
+					for(int bx = 0; bx < c.bw; bx++) Idct(c, &c.coefs[((size_t)by * c.bw + bx) * 64], bx, by, true);
+			}
+		}
+		Output(dst, scale);
+	} catch(const std::bad_alloc&) {
+		return Fail("out of memory");
+	} catch(const std::length_error&) {
+		return Fail("out of memory");
+	}
+	return true;
+}
+
+// Markers: goes through the markers from pos. For the header it stops at the
+// first scan, with pos on its marker; otherwise it decodes the scans, and stops
+// at the end of the image, or of the data.
+bool TJpegDecoder::Markers(bool header) {
+	for(;;) {
+		// anything else before a marker, like the end of a scan's data or fill bytes, is skipped
+		while(pos + 1 < end && !(pos[0] == 0xFF && pos[1] != 0 && pos[1] != 0xFF)) pos++;
+		if(pos + 1 >= end || pos[1] == 0xD9) return header ? Fail("there's no image data") : true;
+		int marker = pos[1];
+		if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) { pos += 2; continue; } // no segment
+		if(header && marker == 0xDA) return frame ? true : Fail("a scan comes before the frame");
+		if(end - pos < 4) return Fail("a segment runs off the end");
+		size_t len = pos[2] << 8 | pos[3];
+		if(len < 2 || len > (size_t)(end - pos) - 2) return Fail("a segment runs off the end");
+		const unsigned char *p = pos + 4;
+		pos += 2 + len;
+		if(!Segment(marker, p, len - 2)) return false;
+		if(marker == 0xDA && !DecodeScan()) return false;
+	}
+}
+
+bool TJpegDecoder::Segment(int marker, const unsigned char *p, size_t len) {
+	switch(marker) {
+	case 0xC0: case 0xC1: case 0xC2:
+		progressive = marker == 0xC2;
+		return Frame(p, len);
+	case 0xC3: case 0xC5: case 0xC6: case 0xC7: case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+		return Fail("only baseline and progressive Huffman JPEGs are supported");
+	case 0xC4: case 0xDB: case 0xDD:
+		return Tables(marker, p, len);
+	case 0xDA:
+		return Scan(p, len);
+	case 0xE0:
+		if(len >= 5 && memcmp(p, "JFIF", 5) == 0) jfif = true;
+		return true;
+	case 0xEE:
+		if(len >= 12 && memcmp(p, "Adobe", 5) == 0) adobe = p[11];
+		return true;
+	}
+	return true;
+}
+
+bool TJpegDecoder::Frame(const unsigned char *p, size_t len) {
+	if(frame) return Fail("there's more than one frame");
+	if(len < 6) return Fail("bad frame header");
+	if(p[0] != 8) return Fail("only 8-bit JPEGs are supported");
+	height = p[1] << 8 | p[2];
+	width = p[3] << 8 | p[4];
+	ncomp = p[5];
+	if(width == 0 || height == 0) return Fail("the image has no size");
+	if(ncomp != 1 && ncomp != 3) return Fail("only greyscale and three-component JPEGs are supported");
+	if(len < 6 + 3 * (size_t)ncomp) return Fail("bad frame header");
+	hmax = vmax = 1;
+	for(int i = 0; i < ncomp; i++) {
+		TComponent &c = comp[i];
+		c.id = p[6 + 3 * i];
+		c.h = p[7 + 3 * i] >> 4;
+		c.v = p[7 + 3 * i] & 15;
+		c.tq = p[8 + 3 * i];
+		if(c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.tq > 3) return Fail("bad frame header");
+		if(c.h > hmax) hmax = c.h;
+		if(c.v > vmax) vmax = c.v;
+	}
+	frame = true;
+	return true;
+}
+
+bool TJpegDecoder::Tables(int marker, const unsigned char *p, size_t len) {
+	if(marker == 0xDD) {
+		if(len < 2) return Fail("bad restart interval");
+		restart = p[0] << 8 | p[1];
+		return true;
+	}
+	while(len > 0) {
+		if(marker == 0xDB) {
+			int pq = p[0] >> 4, tq = p[0] & 15;
+			size_t n = pq ? 129 : 65;
+			if(pq > 1 || tq > 3 || len < n) return Fail("bad quantization table");
+			for(int i = 0; i < 64; i++) {
+				int q = pq ? (p[1 + 2 * i] << 8 | p[2 + 2 * i]) : p[1 + i];
+				quant[tq][ZIGZAG[i]] = (short)(q > 32767 ? 32767 : q);
+			}
+			qdefined[tq] = true;
+			p += n; len -= n;
+		} else {
+			if(len < 17) return Fail("bad Huffman table");
+			int tc = p[0] >> 4, th = p[0] & 15;
+			size_t n = 0;
+			for(int i = 0; i < 16; i++) n += p[1 + i];
+			if(tc > 1 || th > 3 || n > 256 || len < 17 + n) return Fail("bad Huffman table");
+			if(!BuildHuffman(tc ? actab[th] : dctab[th], p + 1, p + 17)) return Fail("bad Huffman table");
+			(tc ? acdefined : dcdefined)[th] = true;
+			p += 17 + n; len -= 17 + n;
+		}
+	}
+	return true;
+}
+
+// BuildHuffman: the tables for the canonical code with counts[i] codes of
+// length i+1, for symbols in order
+bool TJpegDecoder::BuildHuffman(THuffman &h, const unsigned char *counts, const unsigned char *symbols) {
+	memset(h.fast, 0, sizeof(h.fast));
+	memset(h.fastac, 0, sizeof(h.fastac));
+	unsigned int code = 0;
+	int k = 0;
+	for(int len = 1; len <= 16; len++) {
+		h.delta[len] = k - (int)code;
+		for(int i = 0; i < counts[len - 1]; i++, k++, code++) {
+			h.values[k] = symbols[k];
+			if(len <= FASTBITS) {
+				unsigned int first = code << (FASTBITS - len), n = 1u << (FASTBITS - len);
+				if(first + n > (1u << FASTBITS)) return false;
+				for(unsigned int j = 0; j < n; j++) h.fast[first + j] = (unsigned short)(len << 8 | symbols[k]);
+			}
+		}
+		if(code > (1u << len)) return false; // over-subscribed
+		h.maxcode[len] = code << (16 - len);
+		code <<= 1;
+	}
+	h.maxcode[17] = 0xFFFFFFFF;
+	// an AC code and its value's bits, if they fit in the lookup together
+	for(unsigned int i = 0; i < (1u << FASTBITS); i++) {
+		int len = h.fast[i] >> 8, rs = h.fast[i] & 255, s = rs & 15;
+		if(len == 0 || s == 0 || len + s > FASTBITS) continue;
+		int v = Extend((i >> (FASTBITS - len - s)) & ((1u << s) - 1), s);
+		if(v >= -128 && v <= 127) h.fastac[i] = (short)(v * 256 + (rs >> 4) * 16 + len + s);
+	}
+	return true;
+}
+
+bool TJpegDecoder::Scan(const unsigned char *p, size_t len) {
+	if(len < 1) return Fail("bad scan header");
+	ns = p[0];
+	if(ns < 1 || ns > ncomp || len < 4 + 2 * (size_t)ns) return Fail("bad scan header");
+	for(int i = 0; i < ns; i++) {
+		scomp[i] = 0;
+		for(int j = 0; j < ncomp && scomp[i] == 0; j++) if(comp[j].id == p[1 + 2 * i]) scomp[i] = &comp[j];
+		if(scomp[i] == 0) return Fail("a scan has a component that the frame doesn't");
+		scomp[i]->td = p[2 + 2 * i] >> 4;
+		scomp[i]->ta = p[2 + 2 * i] & 15;
+		if(scomp[i]->td > 3 || scomp[i]->ta > 3) return Fail("bad scan header");
+	}
+	p += 1 + 2 * ns;
+	ss = p[0]; se = p[1]; ah = p[2] >> 4; al = p[2] & 15;
+	if(progressive) {
+		if(ss == 0 ? se != 0 : (se < ss || se > 63 || ns != 1)) return Fail("bad progression");
+		if(ah > 13 || al > 13) return Fail("bad progression");
+		kind = ss == 0 ? (ah == 0 ? skDcFirst : skDcRefine) : (ah == 0 ? skAcFirst : skAcRefine);
+	} else {
+		kind = skBaseline; ss = 0; se = 63; ah = al = 0; // as libjpeg, sequential scans are always the whole block
+	}
+	for(int i = 0; i < ns; i++) {
+		TComponent &c = *scomp[i];
+		if((kind == skBaseline || kind == skDcFirst) && !dcdefined[c.td]) return Fail("a Huffman table is missing");
+		if((kind == skBaseline || kind == skAcFirst || kind == skAcRefine) && !acdefined[c.ta]) return Fail("a Huffman table is missing");
+		// as libjpeg, a component keeps the quantization table it had in its first scan
+		if(!c.seen) {
+			if(!qdefined[c.tq]) return Fail("a quantization table is missing");
+			memcpy(c.quant, quant[c.tq], sizeof(c.quant));
+			c.seen = true;
+		}
+	}
+	return true;
+}
+
+bool TJpegDecoder::Setup(int scale) {
+	int bs = 8 / scale;
+	int mcusx = Scaled(width, 8 * hmax), mcusy = Scaled(height, 8 * vmax);
+	unsigned long long bytes = 0;
+	for(int i = 0; i < ncomp; i++) {
+		TComponent &c = comp[i];
+		// as libjpeg, a subsampled component is scaled up by a bigger IDCT,
+		// where it can be, rather than by upsampling
+		int size = bs;
+		while(size < 8 && (hmax * bs) % (c.h * size * 2) == 0 && (vmax * bs) % (c.v * size * 2) == 0) size *= 2;
+		if((hmax * bs) % (c.h * size) != 0 || (vmax * bs) % (c.v * size) != 0) return Fail("fractional sampling isn't supported");
+		c.size = size;
+		c.dw = (int)(((long long)width * c.h * size + hmax * 8 - 1) / (hmax * 8));
+		c.dh = (int)(((long long)height * c.v * size + vmax * 8 - 1) / (vmax * 8));
+		c.bw = mcusx * c.h;
+		c.bh = mcusy * c.v;
+		c.dc = 0;
+		c.seen = false;
+		// sized in 64 bits, as size_t could wrap round to something small
+		unsigned long long nplane = (unsigned long long)c.bw * size * c.bh * size;
+		unsigned long long ncoefs = progressive ? (unsigned long long)c.bw * c.bh * 64 : 0;
+		bytes += nplane + ncoefs * sizeof(short);
+		if(bytes > MAXBYTES) return Fail("the image is too big");
+		c.plane.assign((size_t)nplane, 0);
+		if(progressive) c.coefs.assign((size_t)ncoefs, 0);
+		else c.coefs.clear();
+	}
+	return true;
+}
+
+bool TJpegDecoder::DecodeScan() {
+	int mcusx, mcusy;
+	if(ns == 1) {
+		// a scan of one component goes block by block, over just the blocks the image covers
+		const TComponent &c = *scomp[0];
+		mcusx = Scaled(Scaled(width * c.h, hmax), 8);
+		mcusy = Scaled(Scaled(height * c.v, vmax), 8);
+	} else {
+		mcusx = Scaled(width, 8 * hmax);
+		mcusy = Scaled(height, 8 * vmax);
+	}
+	for(int i = 0; i < ns; i++) scomp[i]->dc = 0;
+	eobrun = 0;
+	bp = pos; bitbuf = 0; bitcnt = 0; atmarker = false;
+	int togo = restart;
+	for(int my = 0; my < mcusy; my++) {
+		for(int mx = 0; mx < mcusx; mx++) {
+			if(restart != 0) {
+				if(togo == 0) { Restart(); togo = restart; }
+				togo--;
+			}
+			if(ns == 1) {
+				if(!Block(*scomp[0], mx, my)) return false;
+				continue;
+			}
+			for(int i = 0; i < ns; i++) {
+				TComponent &c = *scomp[i];
+				for(int y = 0; y < c.v; y++)
+					for(int x = 0; x < c.h; x++)
+						if(!Block(c, mx * c.h + x, my * c.v + y)) return false;
+			}
+		}
+	}
+	pos = bp;
+	return true;
+}
+
+// Restart: skips on past the next restart marker, and starts afresh from there
+void TJpegDecoder::Restart() {
+	while(bp + 1 < end && !(bp[0] == 0xFF && bp[1] != 0 && bp[1] != 0xFF)) bp++;
+	if(bp + 1 < end && bp[1] >= 0xD0 && bp[1] <= 0xD7) bp += 2;
+	bitbuf = 0; bitcnt = 0; atmarker = false;
+	for(int i = 0; i < ns; i++) scomp[i]->dc = 0;
+	eobrun = 0;
+}
+
+void TJpegDecoder::Refill() {
+	while(bitcnt <= 56) {
+		unsigned int b = 0;
+		if(!atmarker && bp < end) {
+			b = *bp;
+			if(b != 0xFF) bp++;
+			else if(bp + 1 < end && bp[1] == 0) bp += 2; // a stuffed 0xFF
+			else { atmarker = true; b = 0; }
+		}
+		bitbuf |= (unsigned long long)b << (56 - bitcnt);
+		bitcnt += 8;
+	}
+}
+
+int TJpegDecoder::Symbol(const THuffman &h) {
+	if(bitcnt < 16) Refill();
+	unsigned int code = (unsigned int)(bitbuf >> 48);
+	unsigned int f = h.fast[code >> (16 - FASTBITS)];
+	if(f != 0) {
+		Drop(f >> 8);
+		return f & 255;
+	}
+	unsigned int len = FASTBITS + 1;
+	while(len <= 16 && code >= h.maxcode[len]) len++;
+	if(len > 16) {
+		Fail("bad Huffman code");
+		return -1;
+	}
+	Drop(len);
+	return h.values[(int)(code >> (16 - len)) + h.delta[len]];
+}
+
+bool TJpegDecoder::Block(TComponent &c, int bx, int by) {
+	if(kind == skBaseline) {
+		short coef[64];
+		memset(coef, 0, sizeof(coef));
+		bool ac;
+		if(!BaselineBlock(c, coef, ac)) return false;
+		Idct(c, coef, bx, by, ac);
+		return true;
+	}
+	short *coef = &c.coefs[((size_t)by * c.bw + bx) * 64];
+	switch(kind) {
+	case skDcFirst: {
+		int s = Symbol(dctab[c.td]);
+		if(s < 0 || s > 15) return Fail("bad Huffman code");
+		if(s != 0) c.dc = (short)(c.dc + Extend(Bits(s), s));
+		coef[0] = (short)(c.dc * (1 << al));
+		return true;
+	}
+	case skDcRefine:
+		if(Bits(1)) coef[0] |= (short)(1 << al);
+		return true;
+	case skAcFirst:
+		return AcFirst(actab[c.ta], coef);
+	default:
+		return AcRefine(actab[c.ta], coef);
+	}
+}
+
+// BaselineBlock: a whole block of a sequential scan, F.2.2. ac says whether
+// there were any AC coefficients.
+bool TJpegDecoder::BaselineBlock(TComponent &c, short *coef, bool &ac) {
+	int s = Symbol(dctab[c.td]);
+	if(s < 0 || s > 15) return Fail("bad Huffman code");
+	if(s != 0) c.dc = (short)(c.dc + Extend(Bits(s), s));
+	coef[0] = (short)c.dc;
+	ac = false;
+	const THuffman &h = actab[c.ta];
+	for(int k = 1; k < 64;) {
+		if(bitcnt < 16) Refill();
+		int fast = h.fastac[bitbuf >> (64 - FASTBITS)];
+		if(fast != 0) {
+			k += (fast >> 4) & 15;
+			Drop(fast & 15);
+			coef[ZIGZAG[k++]] = (short)(fast >> 8);
+			ac = true;
+			continue;
+		}
+		int rs = Symbol(h);
+		if(rs < 0) return false;
+		int r = rs >> 4;
+		s = rs & 15;
+		if(s == 0) {
+			if(r != 15) break; // end of block
+			k += 16;
+			continue;
+		}
+		k += r;
+		coef[ZIGZAG[k++]] = (short)Extend(Bits(s), s);
+		ac = true;
+	}
+	return true;
+}
+
+// AcFirst: the first scan of a band of AC coefficients, G.1.2.2
+bool TJpegDecoder::AcFirst(const THuffman &h, short *coef) {
+	if(eobrun != 0) {
+		eobrun--;
+		return true;
+	}
+	for(int k = ss; k <= se;) {
+		int rs = Symbol(h);
+		if(rs < 0) return false;
+		int r = rs >> 4, s = rs & 15;
+		if(s == 0) {
+			if(r < 15) { // this and the next 2^r - 1 + (r bits) blocks end here
+				eobrun = (1u << r) - 1;
+				if(r != 0) eobrun += Bits(r);
+				break;
+			}
+			k += 16;
+			continue;
+		}
+		k += r;
+		coef[ZIGZAG[k++]] = (short)(Extend(Bits(s), s) * (1 << al));
+	}
+	return true;
+}
+
+// AcRefine: a later scan of a band, with the next bit of each coefficient,
+// G.1.2.3. This follows libjpeg's decode_mcu_AC_refine().
+bool TJpegDecoder::AcRefine(const THuffman &h, short *coef) {
+	int p1 = 1 << al, m1 = -p1;
+	int k = ss;
+	if(eobrun == 0) {
+		for(; k <= se; k++) {
+			int rs = Symbol(h);
+			if(rs < 0) return false;
+			int r = rs >> 4, s = rs & 15, v = 0;
+			if(s != 0) v = Bits(1) ? p1 : m1;
+			else if(r != 15) {
+				eobrun = 1u << r;
+				if(r != 0) eobrun += Bits(r);
+				break;
+			}
+			// skip r zeros (16 for a run of zeros), refining the non-zero ones on the way
+			do {
+				short &t = coef[ZIGZAG[k]];
+				if(t != 0) {
+					if(Bits(1) && (t & p1) == 0) t = (short)(t >= 0 ? t + p1 : t + m1);
+				} else if(--r < 0) break;
+				k++;
+			} while(k <= se);
+			if(v != 0) coef[ZIGZAG[k]] = (short)v;
+		}
+	}
+	if(eobrun > 0) {
+		// the rest of the band only has refinements
+		for(; k <= se; k++) {
+			short &t = coef[ZIGZAG[k]];
+			if(t != 0 && Bits(1) && (t & p1) == 0) t = (short)(t >= 0 ? t + p1 : t + m1);
+		}
+		eobrun--;
+	}
+	return true;
+}
+
+// Idct: a block into the component's plane, at the component's size
+void TJpegDecoder::Idct(TComponent &c, const short *coef, int bx, int by, bool ac) {
+	static const TIdctKernel kernel = ChooseIdct();
+	size_t stride = (size_t)c.bw * c.size;
+	unsigned char *out = &c.plane[(size_t)by * c.size * stride + (size_t)bx * c.size];
+	if(!ac || c.size == 1) {
+		unsigned char v = DcOnly(Dequant(coef[0], c.quant[0]));
+		for(int y = 0; y < c.size; y++) memset(out + y * stride, v, c.size);
+		return;
+	}
+	if(c.size == 8) kernel(coef, c.quant, out, (int)stride);
+	else if(c.size == 4) Idct4(coef, c.quant, out, (int)stride);
+	else Idct2(coef, c.quant, out, (int)stride);
+}
+
+// Upsample: row y of the image's rows, from component c, as libjpeg's
+// upsampling (jdsample.c) makes it. Halved components are done with
+// "fancy" triangle filters, and anything else by repeating samples. It's
+// either a row of the plane, or made in tmp.
+const unsigned char *TJpegDecoder::Upsample(const TComponent &c, int y, int scale, unsigned char *tmp) const {
+	int bs = 8 / scale;
+	int ex = hmax * bs / (c.h * c.size), ey = vmax * bs / (c.v * c.size);
+	size_t stride = (size_t)c.bw * c.size;
+	const unsigned char *in = &c.plane[(size_t)(y / ey) * stride];
+	bool fancy = bs > 1; // libjpeg doesn't bother at 1/8
+	int n = c.dw;
+	if(fancy && ey == 2 && (ex == 1 || (ex == 2 && n > 2))) {
+		// the nearer row counts three times as much as the other
+		int far = y & 1 ? y / 2 + 1 : y / 2 - 1;
+		if(far < 0) far = 0;
+		if(far > c.dh - 1) far = c.dh - 1;
+		const unsigned char *in1 = &c.plane[(size_t)far * stride];
+		if(ex == 1) {
+			int bias = y & 1 ? 2 : 1;
+			for(int x = 0; x < n; x++) tmp[x] = (unsigned char)((in[x] * 3 + in1[x] + bias) >> 2);
+			return tmp;
+		}
+		int here = in[0] * 3 + in1[0], next = in[1] * 3 + in1[1], last = here;
+		tmp[0] = (unsigned char)((here * 4 + 8) >> 4);
+		tmp[1] = (unsigned char)((here * 3 + next + 7) >> 4);
+		for(int x = 2; x < n; x++) {
+			last = here; here = next;
+			next = in[x] * 3 + in1[x];
+			tmp[2 * x - 2] = (unsigned char)((here * 3 + last + 8) >> 4);
+			tmp[2 * x - 1] = (unsigned char)((here * 3 + next + 7) >> 4);
+		}
+		tmp[2 * n - 2] = (unsigned char)((next * 3 + here + 8) >> 4);
+		tmp[2 * n - 1] = (unsigned char)((next * 4 + 7) >> 4);
+		return tmp;
+	}
+	if(fancy && ex == 2 && ey == 1 && n > 2) {
+		tmp[0] = in[0];
+		tmp[1] = (unsigned char)((in[0] * 3 + in[1] + 2) >> 2);
+		for(int x = 1; x < n - 1; x++) {
+			int v = in[x] * 3;
+			tmp[2 * x] = (unsigned char)((v + in[x - 1] + 1) >> 2);
+			tmp[2 * x + 1] = (unsigned char)((v + in[x + 1] + 2) >> 2);
+		}
+		tmp[2 * n - 2] = (unsigned char)((in[n - 1] * 3 + in[n - 2] + 1) >> 2);
+		tmp[2 * n - 1] = in[n - 1];
+		return tmp;
+	}
+	if(ex == 1) return in;
+	for(int x = 0; x < n; x++) memset(tmp + x * ex, in[x], ex);
+	return tmp;
+}
+
+void TJpegDecoder::Output(const TSurface &dst, int scale) {
+	static const TYccKernel ycc = ChooseYcc();
+	// as libjpeg, three components are YCbCr unless something says they're RGB
+	bool rgb = ncomp == 3 && !jfif && (adobe >= 0 ? adobe == 0 : comp[0].id == 'R' && comp[1].id == 'G' && comp[2].id == 'B');
+	std::vector<unsigned char> tmp[3], bgrx;
+	for(int i = 0; i < ncomp; i++) tmp[i].resize((size_t)comp[i].dw * 4 + dst.w);
+	if(dst.bpp == 24) bgrx.resize((size_t)dst.w * 4);
+	for(int y = 0; y < dst.h; y++) {
+		const unsigned char *row[3];
+		for(int i = 0; i < ncomp; i++) row[i] = Upsample(comp[i], y, scale, &tmp[i][0]);
+		unsigned char *d = dst.Row(y);
+		if(ncomp == 3 && !rgb) {
+			if(dst.bpp == 32) {
+				ycc(row[0], row[1], row[2], d, dst.w);
+				continue;
+			}
+			ycc(row[0], row[1], row[2], &bgrx[0], dst.w);
+			for(int x = 0; x < dst.w; x++, d += 3) {
+				d[0] = bgrx[x * 4]; d[1] = bgrx[x * 4 + 1]; d[2] = bgrx[x * 4 + 2];
+			}
+			continue;
+		}
+		int bpp = dst.bpp / 8;
+		for(int x = 0; x < dst.w; x++, d += bpp) {
+			if(ncomp == 1) d[0] = d[1] = d[2] = row[0][x];
+			else { d[0] = row[2][x]; d[1] = row[1][x]; d[2] = row[0][x]; }
+			if(bpp == 4) d[3] = 0;
+		}
+	}
+}
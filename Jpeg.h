@@ -0,0 +1,123 @@
+//JPEG decoder
+#if !defined(JPEG_H_INCLUDED_)
+#define JPEG_H_INCLUDED_
+
+#include <stddef.h>
+#include <vector>
+#include "Surface.h"
+#include "Cpu.h"
+
+// TJpegDecoder: decodes baseline and progressive JPEGs (8-bit, Huffman coded,
+// greyscale or three components) straight into a 24 or 32bpp surface. The
+// IDCT and the colour conversion use SIMD where the CPU has it, and give the
+// same result either way; the IDCT, upsampling and colour conversion follow
+// libjpeg's defaults (islow, fancy upsampling), so the pixels match what it
+// decodes.
+//
+// It can also decode at 1/2, 1/4 or 1/8 of the size, by doing a smaller IDCT
+// on each block instead of scaling down afterwards, which is much cheaper.
+// Components are decoded whole into planes of their own before they're
+// upsampled and converted, so a progressive image also keeps all of its
+// coefficients until the last scan.
+class TJpegDecoder {
+public:
+	TJpegDecoder();
+	// ReadHeader: reads everything up to the first scan of data[0, len). The
+	// data isn't copied, and has to stay put until Decode() is done with it.
+	bool ReadHeader(const unsigned char *data, size_t len);
+	int Width() const { return width; }
+	int Height() const { return height; }
+	bool Progressive() const { return progressive; }
+	// Scaled: a width or height as it comes out when decoded at 1/scale,
+	// rounded up, as libjpeg does
+	static int Scaled(int size, int scale) { return (size + scale - 1) / scale; }
+	// Decode: decodes the whole image at 1/scale, scale being 1, 2, 4 or 8,
+	// into dst, which has to be Scaled(Width(), scale) x Scaled(Height(), scale)
+	// and 24bpp (BGR) or 32bpp (BGRx, with x written as 0). If the data ends
+	// early, what was there is shown. Images that would take more than 1GB
+	// to decode fail, rather than take most of a 32-bit address space.
+	bool Decode(const TSurface &dst, int scale);
+	const char *Error() const { return error; }
+
+private:
+	enum { FASTBITS = 9 };               // Huffman codes up to this long are found with one lookup
+	struct THuffman {
+		unsigned short fast[1 << FASTBITS]; // length << 8 | symbol, or 0 if the code is longer
+		short fastac[1 << FASTBITS];     // for AC: value << 8 | run << 4 | length with the value's bits, or 0
+		unsigned int maxcode[18];        // first code after each length's, left-aligned in 16 bits
+		int delta[17];                   // a code's index into values, less the code, by length
+		unsigned char values[256];
+	};
+	struct TComponent {
+		int id, h, v, tq;                // from the frame header
+		int td, ta;                      // Huffman tables, from the current scan's header
+		int dc;                          // the DC prediction
+		bool seen;                       // has been in a scan: quant has been latched
+		short quant[64];                 // its quantization table, in natural order
+		int bw, bh;                      // blocks across and down, padded out to whole MCUs
+		int size;                        // how many pixels across each block decodes to
+		int dw, dh;                      // its size as decoded, without the padding
+		std::vector<short> coefs;        // every block's coefficients (progressive only)
+		std::vector<unsigned char> plane; // the decoded samples, bw*size across
+	};
+	enum TScanKind {skBaseline, skDcFirst, skDcRefine, skAcFirst, skAcRefine};
+	TJpegDecoder(const TJpegDecoder&) = delete;
+	TJpegDecoder &operator=(const TJpegDecoder&) = delete;
+	bool Markers(bool header);
+	bool Segment(int marker, const unsigned char *p, size_t len);
+	bool Frame(const unsigned char *p, size_t len);
+	bool Tables(int marker, const unsigned char *p, size_t len);
+	bool Scan(const unsigned char *p, size_t len);
+	static bool BuildHuffman(THuffman &h, const unsigned char *counts, const unsigned char *symbols);
+	bool Setup(int scale);
+	bool DecodeScan();
+	void Restart();
+	bool Block(TComponent &c, int bx, int by);
+	bool BaselineBlock(TComponent &c, short *coef, bool &ac);
+	bool AcFirst(const THuffman &h, short *coef);
+	bool AcRefine(const THuffman &h, short *coef);
+	void Idct(TComponent &c, const short *coef, int bx, int by, bool ac);
+	const unsigned char *Upsample(const TComponent &c, int y, int scale, unsigned char *tmp) const;
+	void Output(const TSurface &dst, int scale);
+	int Symbol(const THuffman &h);
+	void Refill();
+	unsigned int Bits(unsigned int n) { if(bitcnt < (int)n) Refill(); unsigned int v = (unsigned int)(bitbuf >> (64 - n)); Drop(n); return v; }
+	void Drop(unsigned int n) { bitbuf <<= n; bitcnt -= n; }
+	bool Fail(const char *msg) { error = msg; return false; }
+
+	const unsigned char *data, *end, *pos;
+	int width, height, ncomp, hmax, vmax;
+	bool progressive, frame, jfif;
+	int adobe;                           // the Adobe marker's transform, or -1 if there wasn't one
+	int restart;                         // MCUs per restart interval, or 0
+	short quant[4][64];
+	bool qdefined[4], dcdefined[4], acdefined[4];
+	THuffman dctab[4], actab[4];
+	TComponent comp[3];
+	// the scan being decoded
+	TComponent *scomp[3]; int ns;
+	TScanKind kind;
+	int ss, se, ah, al;
+	unsigned int eobrun;
+	// the bit reader, MSB first, which stops at the scan's next marker and
+	// makes up zeros from then on
+	const unsigned char *bp;
+	unsigned long long bitbuf;
+	int bitcnt;
+	bool atmarker;
+	const char *error;
+};
+
+// The kernels, so they can be checked and timed against each other. Only call
+// a SIMD one if CpuHas() reports its extension.
+// JpegIdct: dequantizes an 8x8 block of coefficients (natural order) and does
+// libjpeg's islow IDCT on it, storing 8x8 samples at out.
+void JpegIdctScalar(const short *coef, const short *quant, unsigned char *out, int stride);
+// YccToBgrx: n pixels of YCbCr, as separate rows, to BGRx
+void YccToBgrxScalar(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *dst, int n);
+#if defined(CPU_X86)
+void JpegIdctSSE2(const short *coef, const short *quant, unsigned char *out, int stride);
+void YccToBgrxSSE2(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *dst, int n);
+#endif
+
+#endif //JPEG_H_INCLUDED_
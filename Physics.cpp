@@ -0,0 +1,162 @@
+#include "Physics.h"
+#include <math.h>
+
+const float TPhysics::SPEED = 100.0f; // the old 1px per 10ms
+
+void TRandom::Seed(unsigned int seed) {
+	// spread the seed out with splitmix64, since xorshift mustn't start at 0
+	unsigned long long z = seed + 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	state = (z ^ (z >> 31)) | 1;
+}
+
+unsigned int TRandom::Next() {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return static_cast<unsigned int>((state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+int TRandom::Range(int lo, int hi) {
+	return lo + static_cast<int>(Next() % static_cast<unsigned int>(hi - lo + 1));
+}
+
+void TPhysics::Start(int _w, int _h, int _sw, int _sh, int count, unsigned int nowMs, unsigned int seed) {
+	w = _w; h = _h; sw = _sw; sh = _sh;
+	if(count < 0) count = 0;
+	random.Seed(seed);
+	x.resize(count); y.resize(count); vx.resize(count); vy.resize(count);
+	for(int i = 0; i < count; i++) {
+		x[i] = w > sw ? static_cast<float>(random.Range(0, w - sw - 1)) : 0;
+		y[i] = h > sh ? static_cast<float>(random.Range(0, h - sh - 1)) : 0;
+		// directions are -1..3, as they always were
+		int dirx = random.Range(-1, 3), diry = random.Range(-1, 3);
+		if(dirx == 0 && diry == 0) {
+			dirx = 1; diry = 1;
+		}
+		vx[i] = dirx * SPEED; vy[i] = diry * SPEED;
+	}
+	px = x; py = y;
+	last = nowMs;
+	frac = 0;
+	pairs = hits = 0;
+}
+
+void TPhysics::Resize(int _w, int _h) {
+	w = _w; h = _h;
+	for(int i = 0; i < Count(); i++) Clamp(i);
+	px = x; py = y;
+}
+
+void TPhysics::SetSpriteSize(int _sw, int _sh) {
+	for(int i = 0; i < Count(); i++) {
+		if(w > sw) x[i] = x[i] * (w - _sw) / (w - sw);
+		if(h > sh) y[i] = y[i] * (h - _sh) / (h - sh);
+	}
+	sw = _sw; sh = _sh;
+	for(int i = 0; i < Count(); i++) Clamp(i);
+	px = x; py = y;
+}
+
+void TPhysics::Clamp(int i) {
+	if(x[i] + sw > w) x[i] = static_cast<float>(w - sw);
+	if(y[i] + sh > h) y[i] = static_cast<float>(h - sh);
+	if(x[i] < 0) x[i] = 0;
+	if(y[i] < 0) y[i] = 0;
+}
+
+void TPhysics::Step() {
+	const float dt = STEPMS / 1000.0f;
+	int n = Count();
+	px = x; py = y;
+	for(int i = 0; i < n; i++) {
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
+	}
+	if(n > 1) Collide();
+	for(int i = 0; i < n; i++) {
+		// off a wall: head away from it, and pick a new direction along it
+		if(x[i] < 0) { x[i] = 0; vx[i] = SPEED; vy[i] = random.Range(-1, 3) * SPEED; }
+		if(x[i] + sw >= w) { x[i] = static_cast<float>(w - sw); vx[i] = -SPEED; vy[i] = random.Range(-1, 3) * SPEED; }
+		if(y[i] < 0) { y[i] = 0; vy[i] = SPEED; vx[i] = random.Range(-1, 3) * SPEED; }
+		if(y[i] + sh >= h) { y[i] = static_cast<float>(h - sh); vy[i] = -SPEED; vx[i] = random.Range(-1, 3) * SPEED; }
+		if(w <= sw) x[i] = 0;
+		if(h <= sh) y[i] = 0;
+	}
+}
+
+// Collide: the broad phase. Cells are at least as big as a sprite, so two
+// sprites that overlap are in the same or adjacent cells. Each cell is checked
+// against itself and the four neighbours after it, so each pair is looked at
+// once. With few sprites the cells are made bigger, so that there are only a
+// few cells per sprite, rather than thousands of empty ones to clear.
+void TPhysics::Collide() {
+	if(sw <= 0 || sh <= 0) return;
+	int n = Count();
+	double k = sqrt(static_cast<double>(w) * h / (4.0 * n * sw * sh));
+	if(k < 1) k = 1;
+	cellw = static_cast<int>(sw * k); cellh = static_cast<int>(sh * k);
+	gw = w / cellw + 1; gh = h / cellh + 1;
+	int ncells = gw * gh;
+	cell.resize(n);
+	cellstart.assign(ncells + 1, 0);
+	cellitems.resize(n);
+	// a counting sort of the sprites by cell
+	for(int i = 0; i < n; i++) {
+		int cx = x[i] > 0 ? static_cast<int>(x[i] / cellw) : 0;
+		int cy = y[i] > 0 ? static_cast<int>(y[i] / cellh) : 0;
+		if(cx >= gw) cx = gw - 1;
+		if(cy >= gh) cy = gh - 1;
+		cell[i] = cy * gw + cx;
+		cellstart[cell[i] + 1]++;
+	}
+	for(int c = 0; c < ncells; c++) cellstart[c + 1] += cellstart[c];
+	cellfill.assign(cellstart.begin(), cellstart.end() - 1);
+	for(int i = 0; i < n; i++) cellitems[cellfill[cell[i]]++] = i;
+	//
+	static const int dx[4] = { 1, -1, 0, 1 }, dy[4] = { 0, 1, 1, 1 };
+	for(int a = 0; a < n; a++) {
+		int c = cell[cellitems[a]], cx = c % gw, cy = c / gw;
+		for(int b = a + 1; b < cellstart[c + 1]; b++) Collide(cellitems[a], cellitems[b]);
+		for(int d = 0; d < 4; d++) {
+			int nx = cx + dx[d], ny = cy + dy[d];
+			if(nx < 0 || nx >= gw || ny >= gh) continue;
+			int nc = ny * gw + nx;
+			for(int b = cellstart[nc]; b < cellstart[nc + 1]; b++) Collide(cellitems[a], cellitems[b]);
+		}
+	}
+}
+
+// Collide: the narrow phase for one pair. They're pushed apart along the axis
+// they overlap least on and, if they're closing on that axis, swap velocities
+// along it, which is an elastic collision between equal masses.
+void TPhysics::Collide(int i, int j) {
+	pairs++;
+	float ddx = x[j] - x[i], ddy = y[j] - y[i];
+	float ox = sw - (ddx < 0 ? -ddx : ddx), oy = sh - (ddy < 0 ? -ddy : ddy);
+	if(ox <= 0 || oy <= 0) return;
+	hits++;
+	if(ox < oy) {
+		float push = (ddx < 0 ? -ox : ox) * 0.5f;
+		x[i] -= push; x[j] += push;
+		if((vx[j] - vx[i]) * ddx < 0) { float t = vx[i]; vx[i] = vx[j]; vx[j] = t; }
+	}
+	else {
+		float push = (ddy < 0 ? -oy : oy) * 0.5f;
+		y[i] -= push; y[j] += push;
+		if((vy[j] - vy[i]) * ddy < 0) { float t = vy[i]; vy[i] = vy[j]; vy[j] = t; }
+	}
+}
+
+void TPhysics::Advance(unsigned int nowMs) {
+	unsigned int elapsed = nowMs - last; // unsigned, so this survives the counter wrapping
+	unsigned int steps = elapsed / STEPMS;
+	if(steps > MAXSTEPS) { // don't try to catch up on minutes of sleep
+		last = nowMs - elapsed % STEPMS - MAXSTEPS * STEPMS;
+		steps = MAXSTEPS;
+	}
+	for(unsigned int i = 0; i < steps; i++) Step();
+	last += steps * STEPMS;
+	frac = static_cast<float>(nowMs - last) / STEPMS;
+}
@@ -0,0 +1,75 @@
+//Sprite physics
+#if !defined(PHYSICS_H_INCLUDED_)
+#define PHYSICS_H_INCLUDED_
+
+#include <vector>
+
+// TRandom: a small deterministic random number generator (xorshift64*). Each
+// user gets its own, seeded explicitly, so a run can be replayed exactly.
+class TRandom {
+public:
+	explicit TRandom(unsigned int seed = 1) { Seed(seed); }
+	void Seed(unsigned int seed);
+	unsigned int Next();         // 32 random bits
+	int Range(int lo, int hi);   // lo..hi inclusive
+
+private:
+	unsigned long long state;
+};
+
+// TPhysics: moves any number of same-sized sprites about inside a box,
+// bouncing off the walls and off each other. The simulation runs in fixed
+// steps of STEPMS whatever the frame rate, with subpixel position and
+// velocity; X() and Y() interpolate between the last two steps, so motion is
+// smooth at any refresh rate and doesn't depend on timer slop. The same seed
+// and the same times give the same motion.
+//
+// The sprites are kept as structure-of-arrays. For collisions, each step
+// sorts them into a uniform grid of cells at least a sprite in size, so a
+// sprite is only tested against those in its own and neighbouring cells,
+// rather than all of them.
+class TPhysics {
+public:
+	enum { STEPMS = 10 };          // simulation step
+	enum { MAXSTEPS = 100 };       // most steps one Advance() will run, e.g. after a long sleep
+	static const float SPEED;      // px/s for each unit of direction
+	TPhysics() : w(0), h(0), sw(0), sh(0), gw(0), gh(0), cellw(0), cellh(0), last(0), frac(0), pairs(0), hits(0) {}
+	// Start: count sprites of sw x sh somewhere random in a w x h box, heading somewhere random
+	void Start(int w, int h, int sw, int sh, int count, unsigned int nowMs, unsigned int seed);
+	// Resize: changes the box, keeping the sprites inside it
+	void Resize(int w, int h);
+	// SetSpriteSize: changes the sprites' size, keeping each one as far across
+	// the room it has to move in as it was
+	void SetSpriteSize(int sw, int sh);
+	// Advance: runs as many whole steps as fit up to nowMs
+	void Advance(unsigned int nowMs);
+	void Step();
+	int Count() const { return (int)x.size(); }
+	// X, Y: the position to draw sprite i at, as of the last Advance()
+	float X(int i) const { return px[i] + (x[i] - px[i]) * frac; }
+	float Y(int i) const { return py[i] + (y[i] - py[i]) * frac; }
+	// Pairs, Hits: how many pairs the broad phase tested, and how many of them
+	// collided, since Start()
+	unsigned long long Pairs() const { return pairs; }
+	unsigned long long Hits() const { return hits; }
+
+private:
+	void Clamp(int i);
+	void Collide();
+	void Collide(int i, int j);
+	int w, h, sw, sh;
+	std::vector<float> x, y, vx, vy; // position and velocity, px and px/s
+	std::vector<float> px, py;       // position before the last step
+	int gw, gh;                      // grid size in cells
+	int cellw, cellh;                // cell size, at least sw x sh
+	std::vector<int> cell;           // cell of each sprite
+	std::vector<int> cellstart;      // sprites in cell c are cellitems[cellstart[c]..cellstart[c+1]]
+	std::vector<int> cellitems;
+	std::vector<int> cellfill;       // where the next sprite goes in each cell, while sorting
+	unsigned int last;               // time up to which we've simulated
+	float frac;                      // how far nowMs is into the next step, 0..1
+	unsigned long long pairs, hits;
+	TRandom random;
+};
+
+#endif //PHYSICS_H_INCLUDED_
@@ -0,0 +1,32 @@
+//Render target
+#if !defined(RENDERTARGET_H_INCLUDED_)
+#define RENDERTARGET_H_INCLUDED_
+
+#include "Surface.h"
+#include "Sprite.h"
+
+typedef unsigned int TColor; // 0x00BBGGRR, the same layout as a COLORREF
+inline TColor MakeColor(int r, int g, int b) { return (TColor)(r | (g << 8) | (b << 16)); }
+
+// TRenderTarget: the drawing operations the saver needs, so that a frame can
+// be composed by GDI on screen, or by plain C++ into memory with no display.
+// Source surfaces are always 32bpp. Nothing is drawn outside the clip rect.
+class TRenderTarget {
+public:
+	virtual ~TRenderTarget() {}
+	virtual int Width() const = 0;
+	virtual int Height() const = 0;
+	// SetClip: limits all later drawing to r, until the next SetClip
+	virtual void SetClip(const TRect &r) = 0;
+	// Blit: copies all of src, 1:1, with its top-left corner at (x, y)
+	virtual void Blit(int x, int y, const TSurface &src) = 0;
+	// Stretch: scales all of src to fill dst, nearest-pixel
+	virtual void Stretch(const TRect &dst, const TSurface &src) = 0;
+	// DrawSprite: draws a sprite, which has premultiplied alpha, at (x, y)
+	virtual void DrawSprite(int x, int y, const TSprite &sprite) = 0;
+	// Text: len chars of text in a transparent box with its top-left at (x, y)
+	virtual void Text(int x, int y, const char *text, int len, TColor color) = 0;
+	virtual void TextSize(const char *text, int len, int &tw, int &th) = 0;
+};
+
+#endif //RENDERTARGET_H_INCLUDED_
@@ -0,0 +1,79 @@
+#include "Resample.h"
+#include <vector>
+
+// For each destination coordinate, the two source coordinates either side
+// of it and the weight (0..256) of the second one.
+struct TTap { int i0, i1; int w; };
+
+static void MakeTaps(std::vector<TTap> &taps, int srclen, int dstlen, TResampleFilter filter) {
+	taps.resize(dstlen);
+	for(int d = 0; d < dstlen; d++) {
+		TTap &t = taps[d];
+		if(filter == rfNearest) {
+			t.i0 = t.i1 = static_cast<int>((2LL * d + 1) * srclen / (2LL * dstlen));
+			t.w = 0;
+			continue;
+		}
+		// centre of dst pixel d, in 8-bit fixed point source coordinates
+		long long pos = ((2LL * d + 1) * srclen * 256) / (2LL * dstlen) - 128;
+		if(pos < 0) pos = 0;
+		t.i0 = static_cast<int>(pos >> 8);
+		t.w = static_cast<int>(pos & 255);
+		t.i1 = t.i0 + 1 < srclen ? t.i0 + 1 : t.i0;
+		if(t.i0 >= srclen) { t.i0 = t.i1 = srclen - 1; t.w = 0; }
+	}
+}
+
+bool Resample(const TSurface &src, const TSurface &dst, TResampleFilter filter) {
+	if(!src.IsValid() || !dst.IsValid()) return false;
+	int sbpp = src.bpp / 8, dbpp = dst.bpp / 8;
+	std::vector<TTap> xtaps, ytaps;
+	MakeTaps(xtaps, src.w, dst.w, filter);
+	MakeTaps(ytaps, src.h, dst.h, filter);
+	std::vector<int> xoff0(dst.w), xoff1(dst.w);
+	for(int x = 0; x < dst.w; x++) {
+		xoff0[x] = xtaps[x].i0 * sbpp;
+		xoff1[x] = xtaps[x].i1 * sbpp;
+	}
+	// one horizontally-filtered row for each of the two source rows, 8.8 fixed point
+	std::vector<unsigned short> row0(dst.w * 3), row1(dst.w * 3);
+	int cached0 = -1, cached1 = -1;
+	for(int y = 0; y < dst.h; y++) {
+		const TTap &ty = ytaps[y];
+		unsigned char *out = dst.Row(y);
+		if(filter == rfNearest) {
+			const unsigned char *in = src.Row(ty.i0);
+			for(int x = 0; x < dst.w; x++, out += dbpp) {
+				const unsigned char *p = in + xoff0[x];
+				out[0] = p[0]; out[1] = p[1]; out[2] = p[2];
+				if(dbpp == 4) out[3] = 0;
+			}
+			continue;
+		}
+		// going down the image, the lower row of the last pair is often the upper row of this one
+		if(ty.i0 == cached1 && cached1 != cached0) { row0.swap(row1); cached0 = cached1; cached1 = -1; }
+		for(int k = 0; k < 2; k++) {
+			int sy = k ? ty.i1 : ty.i0;
+			int &cached = k ? cached1 : cached0;
+			if(cached == sy) continue;
+			std::vector<unsigned short> &row = k ? row1 : row0;
+			const unsigned char *in = src.Row(sy);
+			for(int x = 0; x < dst.w; x++) {
+				const unsigned char *a = in + xoff0[x], *b = in + xoff1[x];
+				int w = xtaps[x].w;
+				for(int c = 0; c < 3; c++)
+					row[x * 3 + c] = static_cast<unsigned short>(a[c] * (256 - w) + b[c] * w);
+			}
+			cached = sy;
+		}
+		int w = ty.w;
+		for(int x = 0; x < dst.w; x++, out += dbpp) {
+			for(int c = 0; c < 3; c++) {
+				unsigned int v = row0[x * 3 + c] * (256 - w) + row1[x * 3 + c] * w;
+				out[c] = static_cast<unsigned char>((v + 32768) >> 16);
+			}
+			if(dbpp == 4) out[3] = 0;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,14 @@
+//Resampling
+#if !defined(RESAMPLE_H_INCLUDED_)
+#define RESAMPLE_H_INCLUDED_
+
+#include "Surface.h"
+
+enum TResampleFilter { rfNearest, rfBilinear };
+
+// Resample: scales all of src to fill all of dst. Either may be 24 or 32bpp;
+// on a 32bpp destination the fourth byte is written as 0. Pixel centres are
+// aligned, as in most image editors. Returns false if either is invalid.
+bool Resample(const TSurface &src, const TSurface &dst, TResampleFilter filter);
+
+#endif //RESAMPLE_H_INCLUDED_
@@ -0,0 +1,153 @@
+#include "Scene.h"
+#include "FrameBuffer.h"
+#include "Resample.h"
+#include <stdio.h>
+#include <math.h>
+
+static const TColor CLOCKCOLOR = MakeColor(0x30, 0x30, 0xA0);
+
+TSaverScene::TSaverScene() : cache(0), sprite(std::make_shared<TSprite>()), sw(0), sh(0), cw(0), ch(0), nsprites(1), bDone(false), nclock(0), prev_sec(-1), clockChanged(false) {
+	clock[0] = 0;
+}
+
+void TSaverScene::SetBackground(const TSurface &bg, TAssetCache *_cache, const std::string &name) {
+	background = bg;
+	cache = name.empty() ? 0 : _cache;
+	bgname = name;
+}
+
+void TSaverScene::SetSprite(const TSurface &src, int tolerance, int ramp) {
+	std::shared_ptr<TSprite> mine = std::make_shared<TSprite>();
+	mine->Load(src, tolerance, ramp);
+	SetSprite(mine);
+}
+
+void TSaverScene::SetSprite(std::shared_ptr<const TSprite> spr) {
+	sprite = spr ? spr : std::make_shared<TSprite>();
+	sw = sprite->Width(); sh = sprite->Height();
+}
+
+void TSaverScene::Start(int w, int h, unsigned int nowMs, unsigned int fadeMs, unsigned int seed) {
+	cw = w; ch = h;
+	physics.Start(cw, ch, sw, sh, nsprites, nowMs, seed);
+	UpdatePositions();
+	prev_sec = -1;
+	fade.Start(nowMs, fadeMs);
+	RebuildBackground(nowMs);
+}
+
+void TSaverScene::Resize(int w, int h, unsigned int nowMs) {
+	if(w == cw && h == ch) return;
+	cw = w; ch = h;
+	physics.Resize(cw, ch);
+	UpdatePositions();
+	RebuildBackground(nowMs);
+}
+
+void TSaverScene::Refresh(unsigned int nowMs) {
+	physics.SetSpriteSize(sw, sh);
+	UpdatePositions();
+	RebuildBackground(nowMs);
+	dirty.AddFull();
+}
+
+// Scale: the background resampled to cw x ch, as a fade source
+std::shared_ptr<const TFadeSource> TSaverScene::Scale() const {
+	std::vector<unsigned char> bits(cw * ch * 4, 0);
+	Resample(background, TSurface(cw, ch, cw * 4, 32, &bits[0]), rfBilinear);
+	return std::make_shared<TFadeSource>(std::move(bits), cw * 4, ch);
+}
+
+// RebuildBackground: the background is resampled once per size, rather than
+// being stretched on every frame. The fade then works on the resampled copy,
+// so it only ever touches the pixels we actually show. Scenes of the same size
+// with a cache share one resampled copy, and each fades it into its own frame.
+void TSaverScene::RebuildBackground(unsigned int nowMs) {
+	dirty.SetBounds(cw, ch);
+	if(cw <= 0 || ch <= 0) {
+		scaledbits.clear();
+		scaled = TSurface();
+		return;
+	}
+	std::shared_ptr<const TFadeSource> source;
+	if(cache != 0) {
+		char size[32]; sprintf(size, "@%dx%d", cw, ch);
+		source = cache->Get<TFadeSource>(bgname + size, [this] { return Scale(); });
+	} else source = Scale();
+	scaledbits.assign(cw * ch * 4, 0);
+	scaled = TSurface(cw, ch, cw * 4, 32, &scaledbits[0]);
+	// the fade carries on from where it was: only its source has changed
+	fade.SetSource(source);
+	bDone = !fade.Render(scaled.bits, nowMs);
+}
+
+void TSaverScene::UpdatePositions() {
+	int n = physics.Count();
+	xs.resize(n); ys.resize(n);
+	for(int i = 0; i < n; i++) {
+		xs[i] = static_cast<int>(floor(physics.X(i) + 0.5f));
+		ys[i] = static_cast<int>(floor(physics.Y(i) + 0.5f));
+	}
+}
+
+void TSaverScene::Tick(unsigned int nowMs, int hour, int minute, int second) {
+	// with the fade running everything is redrawn anyway
+	if(bDone)
+		for(size_t i = 0; i < xs.size(); i++) dirty.Add(TRect(xs[i], ys[i], xs[i] + sw, ys[i] + sh));
+	physics.Advance(nowMs);
+	UpdatePositions();
+	if(prev_sec != second) {
+		nclock = sprintf(clock, "%d:%02d:%02d", hour, minute, second);
+		prev_sec = second;
+		clockChanged = true; // Render() marks it dirty, once it knows how wide the new text is
+	}
+	if(bDone)
+		for(size_t i = 0; i < xs.size(); i++) dirty.Add(TRect(xs[i], ys[i], xs[i] + sw, ys[i] + sh));
+	else dirty.AddFull(); // the fade changes every pixel
+}
+
+std::vector<TRect> TSaverScene::Render(TRenderTarget &target, unsigned int nowMs) {
+	if(!bDone && scaled.IsValid()) bDone = !fade.Render(scaled.bits, nowMs);
+	// the old text has to go, and the new may be wider, e.g. 9:59:59 to 10:00:00
+	int tw, th; target.TextSize(clock, nclock, tw, th);
+	TRect rcText(cw - 70, 1, cw - 70 + tw, 1 + th);
+	if(clockChanged) {
+		dirty.Add(rcClock);
+		dirty.Add(rcText);
+		clockChanged = false;
+	}
+	rcClock = rcText;
+	std::vector<TRect> rects = dirty.Rects();
+	dirty.Clear();
+	// Each rect gets the whole stack drawn in it, clipped to it, so that
+	// nothing (text especially) is ever drawn twice over itself
+	for(size_t i = 0; i < rects.size(); i++) {
+		target.SetClip(rects[i]);
+		target.Blit(0, 0, scaled);
+		for(size_t j = 0; j < xs.size(); j++) {
+			if(!rects[i].Intersect(TRect(xs[j], ys[j], xs[j] + sw, ys[j] + sh)).IsEmpty())
+				target.DrawSprite(xs[j], ys[j], *sprite);
+		}
+		target.Text(cw - 70, 1, clock, nclock, CLOCKCOLOR);
+		if(!bDone)
+			target.Text(1, 1, caption.c_str(), (int)caption.size(), CLOCKCOLOR);
+	}
+	target.SetClip(TRect(0, 0, target.Width(), target.Height()));
+	return rects;
+}
+
+unsigned int RunHeadless(TSaverScene &scene, int frames, unsigned int startMs, unsigned int stepMs, const char *ppmPrefix) {
+	TFrameBuffer fb(scene.Width(), scene.Height());
+	unsigned int nowMs = startMs;
+	for(int i = 0; i < frames; i++, nowMs += stepMs) {
+		unsigned int secs = nowMs / 1000;
+		scene.Tick(nowMs, (secs / 3600) % 24, (secs / 60) % 60, secs % 60);
+		scene.Render(fb, nowMs);
+		if(ppmPrefix != 0) {
+			char filename[1024];
+			sprintf(filename, "%.1000s%d.ppm", ppmPrefix, i);
+			fb.SavePPM(filename);
+		}
+	}
+	return fb.Checksum();
+}
@@ -0,0 +1,87 @@
+//Saver scene
+#if !defined(SCENE_H_INCLUDED_)
+#define SCENE_H_INCLUDED_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Surface.h"
+#include "AssetCache.h"
+#include "RenderTarget.h"
+#include "FadeEngine.h"
+#include "DirtyRegion.h"
+#include "Sprite.h"
+#include "Physics.h"
+
+// TSaverScene: everything the saver shows and how it moves, with no windows
+// or GDI in sight. The caller supplies the time and the clock, and something
+// to draw on: TSaverWindow does that for a real window, RunHeadless() for memory.
+// The images it draws from never change, and may be shared with other scenes;
+// the fade, the sprites' positions and the frame are its own.
+class TSaverScene {
+public:
+	TSaverScene();
+	// SetBackground: the decoded background. It isn't copied, and must outlive
+	// the scene, because it's resampled again whenever the size changes. With
+	// a cache, the resampled copy is shared with every other scene that shows
+	// the background of the same name at the same size.
+	void SetBackground(const TSurface &bg, TAssetCache *cache = 0, const std::string &name = std::string());
+	// SetSprite: takes a copy. The top-left pixel's colour is transparent,
+	// with soft edges if ramp > 1: see TSprite::Load.
+	void SetSprite(const TSurface &src, int tolerance, int ramp);
+	// SetSprite: shares a sprite that's already made, e.g. with other scenes
+	void SetSprite(std::shared_ptr<const TSprite> spr);
+	// SetCaption: the text shown in the top-left corner until the fade is done
+	void SetCaption(const std::string &text) { caption = text; }
+	// SetSpriteCount: how many copies of the sprite bounce about; takes effect at Start()
+	void SetSpriteCount(int n) { nsprites = n; }
+	// Start: puts the sprites somewhere random and starts the fade. The same
+	// seed, fed the same times, always gives the same frames.
+	void Start(int w, int h, unsigned int nowMs, unsigned int fadeMs, unsigned int seed);
+	void Resize(int w, int h, unsigned int nowMs);
+	// Refresh: after SetBackground or SetSprite on a scene that's already
+	// running, e.g. once they've finished loading, redoes what depends on them.
+	// The fade and the sprites carry on from where they were.
+	void Refresh(unsigned int nowMs);
+	// Tick: moves everything on to nowMs, and marks what changed as dirty
+	void Tick(unsigned int nowMs, int hour, int minute, int second);
+	// Invalidate: for repaints we didn't ask for, e.g. from the window system
+	void Invalidate(const TRect &r) { dirty.Add(r); }
+	const TDirtyRegion &Dirty() const { return dirty; }
+	// Render: recomposes the dirty parts of the frame onto target, and returns
+	// the rects it drew. Afterwards nothing is dirty.
+	std::vector<TRect> Render(TRenderTarget &target, unsigned int nowMs);
+	bool FadeDone() const { return bDone; }
+	int Width() const { return cw; }
+	int Height() const { return ch; }
+
+private:
+	void RebuildBackground(unsigned int nowMs);
+	void UpdatePositions();
+	std::shared_ptr<const TFadeSource> Scale() const;
+	TSurface background;                             // as decoded; the caller owns it
+	TAssetCache *cache;                              // to share the resampled background through, if not 0
+	std::string bgname;                              // the background's name in cache
+	std::vector<unsigned char> scaledbits;           // resampled to cw x ch, as currently faded
+	TSurface scaled;
+	std::shared_ptr<const TSprite> sprite;           // never null
+	TFadeEngine fade;                                // holds the unfaded, resampled background
+	TDirtyRegion dirty;
+	int sw, sh, cw, ch;
+	int nsprites;
+	TPhysics physics;                                // where the sprites are, and where they're going
+	std::vector<int> xs, ys;                         // where each sprite is drawn
+	bool bDone;
+	char clock[100]; int nclock, prev_sec;
+	bool clockChanged;                               // the text has changed since the clock was last drawn
+	TRect rcClock;                                   // where the clock was last drawn
+	std::string caption;
+};
+
+// RunHeadless: plays a Start()ed scene for some frames into a TFrameBuffer
+// of the scene's size, advancing the time by stepMs a frame from startMs,
+// which also drives the clock. If ppmPrefix isn't null, frame i is saved
+// as <ppmPrefix><i>.ppm. Returns the checksum of the last frame.
+unsigned int RunHeadless(TSaverScene &scene, int frames, unsigned int startMs, unsigned int stepMs, const char *ppmPrefix);
+
+#endif //SCENE_H_INCLUDED_
@@ -0,0 +1,150 @@
+#include "Sprite.h"
+#include <string.h>
+#if defined(CPU_X86)
+#include <emmintrin.h>
+#endif
+
+void TSprite::Load(const TSurface &src, int tolerance, int ramp) {
+	if(!src.IsValid()) return;
+	if(ramp < 1) ramp = 1;
+	int w = src.w, h = src.h, bpp = src.bpp / 8;
+	bits.assign(w * h * 4, 0);
+	surface = TSurface(w, h, w * 4, 32, &bits[0]);
+	const unsigned char *key = src.Row(0);
+	for(int y = 0; y < h; y++) {
+		const unsigned char *in = src.Row(y);
+		unsigned char *out = surface.Row(y);
+		for(int x = 0; x < w; x++, in += bpp, out += 4) {
+			int d = 0;
+			for(int c = 0; c < 3; c++) {
+				int diff = in[c] > key[c] ? in[c] - key[c] : key[c] - in[c];
+				if(diff > d) d = diff;
+			}
+			int a = d <= tolerance ? 0 : d >= tolerance + ramp ? 255 : (d - tolerance) * 255 / ramp;
+			if(a == 0) continue; // all zero, as it was allocated
+			// in = a*fg + (1-a)*key, and what we want to keep is a*fg
+			for(int c = 0; c < 3; c++) {
+				int v = in[c] - (key[c] * (255 - a) + 127) / 255;
+				out[c] = static_cast<unsigned char>(v < 0 ? 0 : v > a ? a : v);
+			}
+			out[3] = static_cast<unsigned char>(a);
+		}
+	}
+	// Now the spans: runs of alpha 255, and runs of anything else but 0
+	spans.clear();
+	rowspans.assign(h + 1, 0);
+	for(int y = 0; y < h; y++) {
+		rowspans[y] = (int)spans.size();
+		const unsigned char *p = surface.Row(y);
+		for(int x = 0; x < w;) {
+			unsigned char a = p[x * 4 + 3];
+			if(a == 0) { x++; continue; }
+			TSpan span; span.x = x; span.opaque = a == 255;
+			while(x < w && p[x * 4 + 3] != 0 && (p[x * 4 + 3] == 255) == span.opaque) x++;
+			span.len = x - span.x;
+			spans.push_back(span);
+		}
+	}
+	rowspans[h] = (int)spans.size();
+}
+
+// (v + 128) * 257 >> 16 is v/255, correctly rounded, for v up to 255*255
+static inline unsigned char Div255(unsigned int v) {
+	v += 128;
+	return static_cast<unsigned char>((v + (v >> 8)) >> 8);
+}
+
+void BlendRowScalar(unsigned char *dst, const unsigned char *src, int n) {
+	for(int i = 0; i < n; i++, dst += 4, src += 4) {
+		unsigned int a = src[3];
+		if(a == 255) { dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3]; }
+		else if(a != 0) {
+			unsigned int ia = 255 - a;
+			for(int c = 0; c < 4; c++) {
+				unsigned int v = src[c] + Div255(dst[c] * ia);
+				dst[c] = static_cast<unsigned char>(v > 255 ? 255 : v);
+			}
+		}
+	}
+}
+
+#if defined(CPU_X86)
+CPU_TARGET("sse2")
+void BlendRowSSE2(unsigned char *dst, const unsigned char *src, int n) {
+	const __m128i alphas = _mm_set1_epi32((int)0xFF000000);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i c255 = _mm_set1_epi16(255);
+	int i = 0;
+	for(; i + 4 <= n; i += 4, dst += 16, src += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i*)src);
+		__m128i a = _mm_and_si128(s, alphas);
+		int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(a, alphas));
+		if(opaque == 0xFFFF) { _mm_storeu_si128((__m128i*)dst, s); continue; }
+		// premultiplied, so a transparent pixel is all zero
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xFFFF) continue;
+		__m128i d = _mm_loadu_si128((const __m128i*)dst);
+		__m128i dlo = _mm_unpacklo_epi8(d, zero), dhi = _mm_unpackhi_epi8(d, zero);
+		__m128i slo = _mm_unpacklo_epi8(s, zero), shi = _mm_unpackhi_epi8(s, zero);
+		// spread each pixel's alpha across its four words, and take 255-alpha
+		__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xFF), 0xFF);
+		__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xFF), 0xFF);
+		alo = _mm_sub_epi16(c255, alo);
+		ahi = _mm_sub_epi16(c255, ahi);
+		__m128i tlo = _mm_add_epi16(_mm_mullo_epi16(dlo, alo), c128);
+		__m128i thi = _mm_add_epi16(_mm_mullo_epi16(dhi, ahi), c128);
+		tlo = _mm_srli_epi16(_mm_add_epi16(tlo, _mm_srli_epi16(tlo, 8)), 8);
+		thi = _mm_srli_epi16(_mm_add_epi16(thi, _mm_srli_epi16(thi, 8)), 8);
+		__m128i r = _mm_adds_epu8(s, _mm_packus_epi16(tlo, thi));
+		_mm_storeu_si128((__m128i*)dst, r);
+	}
+	BlendRowScalar(dst, src, n - i);
+}
+#endif
+
+typedef void (*TBlendRow)(unsigned char *dst, const unsigned char *src, int n);
+
+static TBlendRow ChooseBlendRow() {
+#if defined(CPU_X86)
+	if(CpuHas(cfSSE2)) return BlendRowSSE2;
+#endif
+	return BlendRowScalar;
+}
+
+static TBlendRow BlendRow() {
+	static const TBlendRow blend = ChooseBlendRow();
+	return blend;
+}
+
+void AlphaBlit(const TSurface &dst, const TRect &clip, int x, int y, const TSurface &sprite) {
+	TBlendRow blend = BlendRow();
+	if(!dst.IsValid() || !sprite.IsValid() || dst.bpp != 32 || sprite.bpp != 32) return;
+	TRect d = TRect(x, y, x + sprite.w, y + sprite.h).Intersect(clip).Intersect(TRect(0, 0, dst.w, dst.h));
+	if(d.IsEmpty()) return;
+	for(int py = d.top; py < d.bottom; py++)
+		blend(dst.Row(py) + d.left * 4, sprite.Row(py - y) + (d.left - x) * 4, d.Width());
+}
+
+void SpanBlit(const TSurface &dst, const TRect &clip, int x, int y, const TSprite &sprite) {
+	TBlendRow blend = BlendRow();
+	const TSurface &src = sprite.Surface();
+	if(!dst.IsValid() || !src.IsValid() || dst.bpp != 32) return;
+	TRect d = TRect(x, y, x + src.w, y + src.h).Intersect(clip).Intersect(TRect(0, 0, dst.w, dst.h));
+	if(d.IsEmpty()) return;
+	// the part of each row we may draw, in sprite coordinates
+	int left = d.left - x, right = d.right - x;
+	for(int py = d.top; py < d.bottom; py++) {
+		int count;
+		const TSpan *span = sprite.Spans(py - y, count);
+		unsigned char *out = dst.Row(py) + d.left * 4; // at sprite x left, as x may be off the surface
+		const unsigned char *in = src.Row(py - y);
+		for(int i = 0; i < count; i++, span++) {
+			int s = span->x, e = span->x + span->len;
+			if(s < left) s = left;
+			if(e > right) e = right;
+			if(s >= e) continue;
+			if(span->opaque) memcpy(out + (s - left) * 4, in + s * 4, (e - s) * 4);
+			else blend(out + (s - left) * 4, in + s * 4, e - s);
+		}
+	}
+}
@@ -0,0 +1,61 @@
+//Sprites
+#if !defined(SPRITE_H_INCLUDED_)
+#define SPRITE_H_INCLUDED_
+
+#include <vector>
+#include "Surface.h"
+#include "Cpu.h"
+
+// TSpan: a run of pixels in one row of a sprite that are all opaque, or all
+// partly transparent. Fully transparent pixels aren't in any span.
+struct TSpan {
+	int x, len;
+	bool opaque;
+};
+
+// TSprite: a 32bpp sprite with premultiplied alpha (BGRA), so that drawing it
+// is a single pass: dst = src + dst * (255 - alpha) / 255. Load() also splits
+// each row into spans, so that drawing skips the transparent pixels entirely
+// and copies the opaque ones with memcpy; only the edges need blending.
+class TSprite {
+public:
+	TSprite() {}
+	// Load: makes the sprite from a 24 or 32bpp image, with the colour of its
+	// top-left pixel transparent. A pixel whose largest channel difference from
+	// that colour is d gets alpha 0 if d <= tolerance, 255 if d >= tolerance+ramp,
+	// and in between it ramps, which gives soft edges to art that was anti-aliased
+	// against the key colour. The key colour's share is taken back out of those
+	// edge pixels. tolerance=0, ramp=1 is an exact colour key.
+	void Load(const TSurface &src, int tolerance, int ramp);
+	const TSurface &Surface() const { return surface; }
+	int Width() const { return surface.w; }
+	int Height() const { return surface.h; }
+	// Spans: the spans of row y, as [first, first+count)
+	const TSpan *Spans(int y, int &count) const {
+		count = rowspans[y + 1] - rowspans[y];
+		return spans.empty() ? 0 : &spans[rowspans[y]];
+	}
+
+private:
+	TSprite(const TSprite&) = delete;             // surface points into bits
+	TSprite &operator=(const TSprite&) = delete;
+	std::vector<unsigned char> bits;
+	TSurface surface;
+	std::vector<TSpan> spans;
+	std::vector<int> rowspans; // index of the first span of each row, plus one for the end
+};
+
+// AlphaBlit: draws a premultiplied 32bpp sprite onto a 32bpp dst with its
+// top-left at (x, y), touching only the pixels inside clip. This blends every
+// pixel of the rect; SpanBlit gives the same result by way of the sprite's spans.
+void AlphaBlit(const TSurface &dst, const TRect &clip, int x, int y, const TSurface &sprite);
+void SpanBlit(const TSurface &dst, const TRect &clip, int x, int y, const TSprite &sprite);
+
+// The row kernels, for checking and timing against each other: n pixels of
+// src over dst. Only call the SIMD one if CpuHas() says so.
+void BlendRowScalar(unsigned char *dst, const unsigned char *src, int n);
+#if defined(CPU_X86)
+void BlendRowSSE2(unsigned char *dst, const unsigned char *src, int n);
+#endif
+
+#endif //SPRITE_H_INCLUDED_
@@ -0,0 +1,42 @@
+//Surface
+#if !defined(SURFACE_H_INCLUDED_)
+#define SURFACE_H_INCLUDED_
+
+// TSurface: a view onto pixels that somebody else owns, e.g. a DIB section.
+// bits points at the top row. stride is the byte distance from one row to
+// the next one down, so it is negative for a bottom-up DIB.
+// bpp is 24 (BGR) or 32 (BGRx).
+struct TSurface {
+	int w, h;
+	int stride;
+	int bpp;
+	unsigned char *bits;
+	TSurface() : w(0), h(0), stride(0), bpp(0), bits(0) {}
+	TSurface(int _w, int _h, int _stride, int _bpp, unsigned char *_bits) : w(_w), h(_h), stride(_stride), bpp(_bpp), bits(_bits) {}
+	unsigned char *Row(int y) const { return bits + (long long)y * stride; }
+	bool IsValid() const { return bits != 0 && w > 0 && h > 0 && (bpp == 24 || bpp == 32); }
+};
+
+// TRect: a pixel rectangle, right and bottom exclusive, like a Windows RECT
+struct TRect {
+	int left, top, right, bottom;
+	TRect() : left(0), top(0), right(0), bottom(0) {}
+	TRect(int l, int t, int r, int b) : left(l), top(t), right(r), bottom(b) {}
+	int Width() const { return right - left; }
+	int Height() const { return bottom - top; }
+	bool IsEmpty() const { return right <= left || bottom <= top; }
+	long long Area() const { return IsEmpty() ? 0 : (long long)Width() * Height(); }
+	bool Contains(const TRect &r) const { return r.left >= left && r.top >= top && r.right <= right && r.bottom <= bottom; }
+	TRect Intersect(const TRect &r) const {
+		return TRect(left > r.left ? left : r.left, top > r.top ? top : r.top,
+			right < r.right ? right : r.right, bottom < r.bottom ? bottom : r.bottom);
+	}
+	TRect Union(const TRect &r) const { // the bounding box of both
+		if(IsEmpty()) return r;
+		if(r.IsEmpty()) return *this;
+		return TRect(left < r.left ? left : r.left, top < r.top ? top : r.top,
+			right > r.right ? right : r.right, bottom > r.bottom ? bottom : r.bottom);
+	}
+};
+
+#endif //SURFACE_H_INCLUDED_
@@ -7,15 +7,20 @@
 // memory: no temporary files are used.
 //
 // As for the sprites, this saver demonstrates several techniques:
-// (1) How to load JPEGs from memory. If you want to add this to your own code,
-// you must #include <ole2.h> and <olectl.h> and copy the LoadJpeg() function.
-// (2) How to load BMPs from memory. The code is in EnsureBitmaps()
-// (3) How to make transparent sprites. The sprite is actually stored as two
-// bitmaps, hbmClip and hbmSprite. The code for loading/generating the two
-// is in EnsureBitmaps(). The code for drawing them is in OnPaint()
+// (1) How to load JPEGs from memory. LoadJpeg() in ASSETLOADER.CPP uses the
+// decoder in JPEG.CPP, which needs nothing from OLE, and decodes a preview's
+// background at a fraction of its size.
+// (2) How to load BMPs from memory. The code is in LoadBmp() in ASSETLOADER.CPP,
+// which runs on a thread of its own while the windows show a placeholder.
+// What the windows make from the images is shared between them through
+// TAssetCache, so a second monitor doesn't cost another copy.
+// (3) How to make transparent sprites. The sprite is turned into a 32bpp
+// premultiplied-alpha image, keyed on its top-left pixel colour, by TSprite::Load().
+// It is drawn in a single pass by SpanBlit(), which only visits the pixels
+// that aren't transparent. All of this is in SPRITE.CPP
 // (4) How to use a double-buffering to avoid flicker. The bitmap hbmBuffer
 // stores our back-buffer. It's created in TSaverWindow() and used in OnPaint().
-// (5) How to read zip files. The code for this is in EnsureBitmaps. Also,
+// (5) How to read zip files. The code for this is in TAssetLoader::Load. Also,
 // it's in the separate module UNZIP.CPP/UNZIP.H, which consists largely
 // of code from www.info-zip.org. Thanks!
 //
@@ -27,16 +32,19 @@
 #include <windows.h>
 #include <commctrl.h>
 #include <regstr.h>
-#include <ole2.h>
-#include <olectl.h>
 #include <stdlib.h>
 #include "SystemInfo.h"
+#include "Scene.h"
+#include "GdiTarget.h"
+#include "AssetLoader.h"
 #include <tchar.h>
 typedef std::basic_string<TCHAR> tstring;
 using namespace std;
-#include "unzip.h"
 
 const int BIOSTEXTLEN = 1000;
+const unsigned int FADETIME = 255 * 50; // ms for the background to fade to black
+const int SPRITERAMP = 48;              // soft edges for the sprite, see TSprite::Load
+const int MAXSPRITES = 10000;
 //
 // These global variables are loaded at the start of WinMain
 BOOL  MuteSound;
@@ -74,49 +82,37 @@ tstring RegLoad(const tstring name, tstring def);
 enum TScrMode { smNone, smConfig, smPassword, smPreview, smSaver, smInstall, smUninstall };
 TScrMode ScrMode = smNone;
 vector<TSaverWindow*> SaverWindow;   // the saver windows, one per monitor. In preview mode there's just one.
+TAssetLoader Assets;                 // the background and sprite, shared by all the windows
+// what the windows show until Assets is ready: a single pixel, stretched (BGRx)
+unsigned char PlaceholderBits[4] = { 0x60, 0x30, 0x30, 0 };
+const TSurface Placeholder(1, 1, 4, 32, PlaceholderBits);
 
-// LoadJpeg: given an HGLOBAL containing jpeg data, we load it.
-HBITMAP LoadJpeg(HGLOBAL hglob) {
-	IStream *stream = 0; 
-	HRESULT hr = CreateStreamOnHGlobal(hglob, FALSE, &stream);
-	if(!SUCCEEDED(hr) || stream == 0) return 0;
-	IPicture *pic;  
-	hr = OleLoadPicture(stream, 0, FALSE, IID_IPicture, (LPVOID*)&pic);
-	stream->Release();
-	if(!SUCCEEDED(hr) || pic == 0) return 0;
-	HBITMAP hbm0 = 0; 
-	hr = pic->get_Handle((OLE_HANDLE*)&hbm0);
-	if(!SUCCEEDED(hr) || hbm0 == 0) { 
-		pic->Release(); 
-		return 0; 
-	}	
-	// Now we make a copy of it into our own hbm
-	DIBSECTION dibs; 
-	GetObject(hbm0, sizeof(dibs), &dibs);
-	if(dibs.dsBm.bmBitsPixel != 24) { 
-		pic->Release(); 
-		return 0; 
+// SurfaceOf: a TSurface view of a DIB section's bits, top row first
+TSurface SurfaceOf(HBITMAP hbm) {
+	DIBSECTION dibs;
+	if(hbm == 0 || GetObject(hbm, sizeof(dibs), &dibs) != sizeof(dibs) || dibs.dsBm.bmBits == 0) return TSurface();
+	int h = dibs.dsBm.bmHeight, stride = dibs.dsBm.bmWidthBytes;
+	unsigned char *bits = reinterpret_cast<unsigned char*>(dibs.dsBm.bmBits);
+	if(dibs.dsBmih.biHeight > 0) { // bottom-up
+		bits += (h - 1) * stride;
+		stride = -stride;
 	}
-	int w = dibs.dsBm.bmWidth;
-	int h = dibs.dsBm.bmHeight;
-	dibs.dsBmih.biClrUsed = 0; 
-	dibs.dsBmih.biClrImportant = 0; 
-	void *bits;
-	HDC sdc = GetDC(0);
-	HBITMAP hbm1 = CreateDIBSection(sdc, (BITMAPINFO*)&dibs.dsBmih, DIB_RGB_COLORS, &bits, 0, 0);
-	//
-	HDC hdc0 = CreateCompatibleDC(sdc);
-	HDC hdc1 = CreateCompatibleDC(sdc);
-	HGDIOBJ hold0 = SelectObject(hdc0, hbm0);
-	HGDIOBJ hold1 = SelectObject(hdc1, hbm1);
-	BitBlt(hdc1, 0, 0, w, h, hdc0, 0, 0, SRCCOPY);
-	SelectObject(hdc0, hold0); 
-	SelectObject(hdc1, hold1);
-	DeleteDC(hdc0); 
-	DeleteDC(hdc1);
-	ReleaseDC(0, sdc);
-	pic->Release();
-	return hbm1;
+	return TSurface(dibs.dsBm.bmWidth, h, stride, dibs.dsBm.bmBitsPixel, bits);
+}
+
+// ShowAssets: gives a scene the loaded background and sprite, or the placeholder
+// and no sprite while they're loading (or if they didn't). The windows share the
+// resampled background and the finished sprite through Assets' cache.
+void ShowAssets(TSaverScene &scene) {
+	TImagePtr bg = Assets.Background(), spr = Assets.Sprite();
+	if(bg) scene.SetBackground(bg->surface, &Assets.Cache(), "background.jpg");
+	else scene.SetBackground(Placeholder, &Assets.Cache(), "placeholder");
+	if(!spr) { scene.SetSprite(std::shared_ptr<const TSprite>()); return; }
+	scene.SetSprite(Assets.Cache().Get<TSprite>("sprite.bmp#premultiplied", [&spr]() {
+		std::shared_ptr<TSprite> sprite = std::make_shared<TSprite>();
+		sprite->Load(spr->surface, 0, SPRITERAMP);
+		return sprite;
+	}));
 }
 
 
@@ -124,122 +120,94 @@ HBITMAP LoadJpeg(HGLOBAL hglob) {
 
 // TSaverWindow: one is created for each saver window (be it preview, or the
 // preview in the config dialog, or one for each monitor when running full-screen)
+// What's shown, and how it moves, is all in TSaverScene: this just connects
+// it to the window, its timer, and GDI.
 //
 struct TSaverWindow {
 	HWND hwnd; int id;          // id=-1 for a preview, or 0..n for full-screen on the specified monitor
-	int bw, bh, sw, sh, cw, ch;    // dimensions of the background and sprite and client-area
-	int x, y, dirx, diry;         // location and direction of the sprite
-	unsigned int time;          // last time when we drew anything
-	HBITMAP hbmBackground;      // the background
-	HBITMAP hbmSprite, hbmClip; // the foreground object
+	int cw, ch;                 // dimensions of the client-area
+	bool bAssets;               // whether the scene has the loaded images, or still the placeholder
 	HBITMAP hbmBuffer;          // we use double-buffering
+	TSaverScene scene;
 	SYSTEMTIME st;
-	boolean bDone = false;
-	char buffer[100];
-	int n, s, prev_sec;
 	SystemInfo *mySystemInfo;
-	char sText[BIOSTEXTLEN] = { 0 };
 	//
-	TSaverWindow(HWND _hwnd, int _id) : hwnd(_hwnd), id(_id), hbmBackground(0), hbmSprite(0), hbmClip(0), hbmBuffer(0) {
+	TSaverWindow(HWND _hwnd, int _id) : hwnd(_hwnd), id(_id), bAssets(false), hbmBuffer(0) {
 		RECT rc; GetClientRect(hwnd, &rc); cw = rc.right; ch = rc.bottom;
-		EnsureGraphicsLoaded();
-		BITMAP bmp; 
-		GetObject(hbmBackground, sizeof(bmp), &bmp); 
-		bw = bmp.bmWidth; 
-		bh = bmp.bmHeight;
-		GetObject(hbmSprite, sizeof(bmp), &bmp); 
-		sw = bmp.bmWidth; 
-		sh = bmp.bmHeight;
+		EnsureBuffer();
+		// WinMain has usually started the loading already, but not for the config dialog's preview.
+		// Until it's done we show the placeholder, and no sprite: OnTimer swaps them in.
+		Assets.Start(hInstance, id == -1 ? cw : 0, id == -1 ? ch : 0);
+		bAssets = Assets.Ready();
+		ShowAssets(scene);
 		//
-		GetSystemTime(&st);
-		srand(st.wMilliseconds);
-
-		x = (rand() + rand()) % (cw - sw);
-		y = (rand() + rand()) % (ch - sh);
-		dirx = (rand() % 5) - 1;
-		diry = (rand() % 5) - 1;
-		if(dirx == 0 && diry == 0) {
-			dirx = 1; diry = 1;
-		}
-		time = GetTickCount();
-		s = n = 0;
-		prev_sec = -1;
 		mySystemInfo = new SystemInfo();
-		char sText2[BIOSTEXTLEN] = { 0 };
+		char sText[BIOSTEXTLEN] = { 0 }, sText2[BIOSTEXTLEN] = { 0 };
 		mySystemInfo->getSystem(sText2, BIOSTEXTLEN - 1);
-		s = sprintf_s(sText, BIOSTEXTLEN - 1, "System=%s User=%s Computer=%s",
+		sprintf_s(sText, BIOSTEXTLEN - 1, "System=%s User=%s Computer=%s",
 			sText2,
 			mySystemInfo->getUserName(),
 			mySystemInfo->getComputerName());
+		scene.SetCaption(sText);
+		// "Sprites" in our registry key says how many sprites to bounce about
+		int nsprites = RegLoad(_T("Sprites"), 1);
+		scene.SetSpriteCount(nsprites < 1 ? 1 : nsprites > MAXSPRITES ? MAXSPRITES : nsprites);
+		// each window gets its own seed, so monitors don't move in lockstep
+		scene.Start(cw, ch, GetTickCount(), FADETIME, GetTickCount() ^ ((unsigned int)id << 16));
 		SetTimer(hwnd, 1, 50, NULL);
 	}
 
-	void EnsureGraphicsLoaded();
-	void OtherWndProc(UINT, WPARAM, LPARAM) {}
+	void EnsureBuffer();
+	void OtherWndProc(UINT msg, WPARAM, LPARAM lParam) {
+		if(msg == WM_SIZE && (LOWORD(lParam) != cw || HIWORD(lParam) != ch)) {
+			cw = LOWORD(lParam); ch = HIWORD(lParam);
+			if(hbmBuffer != 0) DeleteObject(hbmBuffer); hbmBuffer = 0;
+			EnsureBuffer();
+			scene.Resize(cw, ch, GetTickCount());
+		}
+	}
 
 	~TSaverWindow() {
 		KillTimer(hwnd, 1);
-		if(hbmBackground != 0) DeleteObject(hbmBackground); hbmBackground = 0;
-		if(hbmSprite != 0) DeleteObject(hbmSprite); hbmSprite = 0;
-		if(hbmClip != 0) DeleteObject(hbmClip); hbmClip = 0;
 		if(hbmBuffer != 0) DeleteObject(hbmBuffer); hbmBuffer = 0;
 		delete mySystemInfo;
 	}
 
-
 	void OnTimer() {
-		unsigned int nowt = GetTickCount();
-		int mul = (nowt - time) / 10;
-		if(mul == 0) mul = 1;
-		time = nowt;
-		x += dirx * mul; y += diry * mul;
-		if(x < 0) { x = 0; dirx = 1; diry = (rand() % 5) - 1; }
-		if(x + sw >= cw) { x = cw - sw; dirx = -1; diry = (rand() % 5) - 1; }
-		if(y < 0) { y = 0; diry = 1; dirx = (rand() % 5) - 1; }
-		if(y + sh >= ch) { y = ch - sh; diry = -1; dirx = (rand() % 5) - 1; }		
+		// the loaded images go in all at once, between two frames
+		if(!bAssets && Assets.Ready()) {
+			bAssets = true;
+			ShowAssets(scene);
+			scene.Refresh(GetTickCount());
+		}
 		GetSystemTime(&st);
-		int new_sec = st.wSecond;
-		if(prev_sec != new_sec) {
-			n = sprintf(buffer, "%d:%02d:%02d", st.wHour, st.wMinute, new_sec);
-			prev_sec = new_sec;
+		scene.Tick(GetTickCount(), st.wHour, st.wMinute, st.wSecond);
+		vector<TRect> rects = scene.Dirty().Rects();
+		for(size_t i = 0; i < rects.size(); i++) {
+			RECT rc = { rects[i].left, rects[i].top, rects[i].right, rects[i].bottom };
+			InvalidateRect(hwnd, &rc, FALSE);
 		}
-		InvalidateRect(hwnd, NULL, TRUE);
 	}
 
-	void OnPaint(HDC hdc, const RECT &rect) {		
-		HDC bufdc = CreateCompatibleDC(hdc);
-		SelectObject(bufdc, hbmBuffer);
-		HDC memdc = CreateCompatibleDC(hdc);
-		//		
-		if(!bDone) {
-			boolean bHasWhite = false;
-			BITMAP  bm;
-			GetObject(hbmBackground, sizeof(bm), &bm);
-			unsigned char* buf = reinterpret_cast<unsigned char*>(bm.bmBits);
-			size_t size = bm.bmWidth * bm.bmHeight * static_cast<size_t>(bm.bmBitsPixel * 0.125f);
-			for(int i = 0; i < size; i++) {
-				if(buf[i]) {
-					buf[i]--;
-				}
-				bHasWhite |= buf[i];
-			}
-			bDone = !bHasWhite;
-		}		
+	void OnPaint(HDC hdc, const RECT &) {
+		// We only recompose and blit what the scene marked as dirty, plus anything
+		// Windows wants repainting itself, e.g. after something that covered us has gone
+		RECT rcClip; GetClipBox(hdc, &rcClip);
+		TRect clip(rcClip.left, rcClip.top, rcClip.right, rcClip.bottom);
+		if(!scene.Dirty().Extent().Contains(clip)) scene.Invalidate(clip);
 		//
-		SelectObject(memdc, hbmBackground);
-		SetStretchBltMode(bufdc, COLORONCOLOR);
-		StretchBlt(bufdc, 0, 0, cw, ch, memdc, 0, 0, bw, bh, SRCCOPY);
-		SelectObject(memdc, hbmClip);
-		BitBlt(bufdc, x, y, sw, sh, memdc, 0, 0, SRCAND);
-		SelectObject(memdc, hbmSprite);
-		BitBlt(bufdc, x, y, sw, sh, memdc, 0, 0, SRCPAINT);
-		DeleteDC(memdc);
-		BitBlt(hdc, 0, 0, cw, ch, bufdc, 0, 0, SRCCOPY);
-		SetBkMode(hdc, TRANSPARENT);
-		SetTextColor(hdc, RGB(0x30, 0x30, 0xA0));
-		TextOut(hdc, rect.right - 70, 1, buffer, n);
-		if(!bDone)
-			TextOut(hdc, 1, 1, sText, s);
+		HDC bufdc = CreateCompatibleDC(hdc);
+		HGDIOBJ holdb = SelectObject(bufdc, hbmBuffer);
+		vector<TRect> rects;
+		{
+			TGdiTarget target(bufdc, SurfaceOf(hbmBuffer));
+			rects = scene.Render(target, GetTickCount());
+		}
+		for(size_t i = 0; i < rects.size(); i++) {
+			const TRect &r = rects[i];
+			BitBlt(hdc, r.left, r.top, r.Width(), r.Height(), bufdc, r.left, r.top, SRCCOPY);
+		}
+		SelectObject(bufdc, holdb);
 		DeleteDC(bufdc);		
 	}
 };
@@ -248,96 +216,19 @@ struct TSaverWindow {
 
 
 
-void TSaverWindow::EnsureGraphicsLoaded() {
+void TSaverWindow::EnsureBuffer() {
 	if(hbmBuffer == 0) {
-		HDC sdc = GetDC(0);
-		hbmBuffer = CreateCompatibleBitmap(sdc, cw, ch);
-		ReleaseDC(0, sdc);
-	}
-	// As for the others, we won't load up the resource-zip if we don't have to:
-	if(hbmBackground != 0 && hbmSprite != 0) return;
-	//
-	HRSRC hrsrc = FindResource(hInstance, _T("ZIPFILE"), RT_RCDATA); if(hrsrc == 0) return;
-	DWORD size = SizeofResource(hInstance, hrsrc); if(size == 0) return;
-	HGLOBAL hglob = LoadResource(hInstance, hrsrc); if(hglob == 0) return;
-	void *buf = LockResource(hglob); if(buf == 0) return;
-	HZIP hzip = OpenZip(buf, size, ZIP_MEMORY); if(hzip == 0) return;
-	//
-	if(hbmBackground == 0) {
-		ZIPENTRY ze; int index; FindZipItem(hzip, "background.jpg", true, &index, &ze);
-		if(index != -1) {
-			HGLOBAL hglob = GlobalAlloc(GMEM_MOVEABLE, ze.unc_size);
-			void *buf = GlobalLock(hglob);
-			UnzipItem(hzip, index, buf, ze.unc_size, ZIP_MEMORY);
-			GlobalUnlock(hglob);
-			hbmBackground = LoadJpeg(hglob);
-			GlobalFree(hglob);
-		}
+		// a DIB section, so that sprites can be blended straight into its bits
+		BITMAPINFO bmi; ZeroMemory(&bmi, sizeof(bmi));
+		bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bmi.bmiHeader.biWidth = cw;
+		bmi.bmiHeader.biHeight = -ch; // top-down
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 32;
+		bmi.bmiHeader.biCompression = BI_RGB;
+		void *bits;
+		hbmBuffer = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
 	}
-
-	if(hbmSprite == 0) {
-		ZIPENTRY ze; int index; FindZipItem(hzip, "sprite.bmp", true, &index, &ze);
-		if(index != -1) {
-			vector<byte> vbuf(ze.unc_size); byte *buf = &vbuf[0];
-			UnzipItem(hzip, index, &buf[0], ze.unc_size, ZIP_MEMORY);
-			BITMAPFILEHEADER *bfh = (BITMAPFILEHEADER*)buf;
-			BITMAPINFOHEADER *bih = (BITMAPINFOHEADER*)(buf + sizeof(BITMAPFILEHEADER));
-			int ncols = bih->biClrUsed; if(ncols == 0) ncols = 1 << bih->biBitCount;
-			char *srcbits = (char*)(buf + bfh->bfOffBits);
-			char *dstbits; hbmSprite = CreateDIBSection(NULL, (BITMAPINFO*)bih, DIB_RGB_COLORS, (void**)&dstbits, NULL, 0);
-			unsigned int numbytes = bih->biSizeImage;
-			if(numbytes == 0) numbytes = ((bih->biWidth*bih->biBitCount / 8 + 3) & 0xFFFFFFFC)*bih->biHeight;
-			CopyMemory(dstbits, srcbits, numbytes);
-			//
-			BITMAP bmp; GetObject(hbmSprite, sizeof(BITMAP), &bmp);
-			int w = bmp.bmWidth, h = bmp.bmHeight;
-			//
-			// Now we do sprite stuff: take the top-left-pixel-color as transparent.
-			HDC screendc = GetDC(0);
-			HDC bitdc = CreateCompatibleDC(screendc);
-			HGDIOBJ holdb = SelectObject(bitdc, hbmSprite);
-			SetBkColor(bitdc, RGB(0, 0, 0));
-			//
-			typedef struct { BITMAPINFOHEADER bmiHeader; RGBQUAD bmiColors[2]; } MONOBITMAPINFO;
-			MONOBITMAPINFO bmi; ZeroMemory(&bmi, sizeof(bmi));
-			bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-			bmi.bmiHeader.biWidth = w;
-			bmi.bmiHeader.biHeight = h;
-			bmi.bmiHeader.biPlanes = 1;
-			bmi.bmiHeader.biBitCount = 1;
-			bmi.bmiHeader.biCompression = BI_RGB;
-			bmi.bmiHeader.biSizeImage = ((w + 7) & 0xFFFFFFF8)*w / 8;
-			bmi.bmiHeader.biXPelsPerMeter = 1000000;
-			bmi.bmiHeader.biYPelsPerMeter = 1000000;
-			bmi.bmiHeader.biClrUsed = 0;
-			bmi.bmiHeader.biClrImportant = 0;
-			bmi.bmiColors[0].rgbRed = 0;  bmi.bmiColors[0].rgbGreen = 0;  bmi.bmiColors[0].rgbBlue = 0;  bmi.bmiColors[0].rgbReserved = 0;
-			bmi.bmiColors[1].rgbRed = 255; bmi.bmiColors[1].rgbGreen = 255; bmi.bmiColors[1].rgbBlue = 255; bmi.bmiColors[1].rgbReserved = 0;
-			hbmClip = CreateDIBSection(screendc, (BITMAPINFO*)&bmi, DIB_RGB_COLORS, (void**)&dstbits, NULL, 0);
-			// Now create a mask, by blting the image onto the monochrome DDB, and onto DIB
-			// (if you blt straight from image to mask, it choose closest mask colour, not absolute mask colour)
-			HDC monodc = CreateCompatibleDC(screendc);
-			HDC maskdc = CreateCompatibleDC(screendc);
-			HBITMAP hmonobm = CreateBitmap(w, h, 1, 1, NULL);
-			HGDIOBJ holdm = SelectObject(monodc, hmonobm);
-			HGDIOBJ holdmask = SelectObject(maskdc, hbmClip);
-			COLORREF transp = GetPixel(bitdc, 0, 0);
-			SetBkColor(bitdc, transp); // use top-left pixel as transparent colour
-			BitBlt(monodc, 0, 0, w, h, bitdc, 0, 0, SRCCOPY);
-			BitBlt(maskdc, 0, 0, w, h, monodc, 0, 0, SRCCOPY);
-			// the mask has 255 for the masked areas, and 0 for the real image areas.
-			// Well, that has created the mask. Now we have to zero-out the original bitmap's masked area
-			BitBlt(bitdc, 0, 0, w, h, monodc, 0, 0, 0x00220326);
-			// 0x00220326 is the ternary raster operation 'DSna', which is reverse-polish for "bitdc AND (NOT monodc)"
-			SelectObject(maskdc, holdmask); DeleteDC(maskdc);
-			SelectObject(monodc, holdm); DeleteDC(monodc); DeleteObject(hmonobm);
-			// 
-			SelectObject(bitdc, holdb); DeleteDC(bitdc);
-			ReleaseDC(0, screendc);
-		}
-	}
-
-	CloseZip(hzip);
 }
 
 void ReadGeneralRegistry() {
@@ -1157,6 +1048,12 @@ int WINAPI WinMain(HINSTANCE h, HINSTANCE, LPSTR, int) {
 	if(ScrMode == smInstall) { DoInstall(); return 0; }
 	if(ScrMode == smUninstall) { DoUninstall(); return 0; }
 	if(ScrMode == smPassword) { return 0; }	
+	// the images are decoded while we get the windows going
+	if(ScrMode == smSaver) Assets.Start(hInstance);
+	if(ScrMode == smPreview) {
+		RECT rc; GetWindowRect(hwnd, &rc); // as DoSaver sizes the preview
+		Assets.Start(hInstance, rc.right - rc.left, rc.bottom - rc.top);
+	}
 	//
 	ReadGeneralRegistry();
 	//
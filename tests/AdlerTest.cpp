@@ -0,0 +1,66 @@
+// Checks each adler32 kernel against the scalar one, and times them
+#include <vector>
+#include "Check.h"
+#include "UnzipKernels.h"
+
+struct TKernel {
+	const char *name;
+	TChecksumKernel fn;
+	unsigned int needs; // CpuHas() flags
+};
+
+static const TKernel Kernels[] = {
+	{"ref", adler32_ref, 0},
+#if defined(CPU_X86)
+	{"ssse3", adler32_ssse3, cfSSSE3},
+	{"avx2", adler32_avx2, cfAVX2},
+#endif
+	{"dispatched", adler32, 0},
+};
+
+static void Check(const TKernel &k, const std::vector<Byte> &data) {
+	CHECK(k.fn(1, (const Byte *)"Wikipedia", 9) == 0x11E60398);
+	CHECK(k.fn(0, 0, 0) == 1);
+	// all 0xff is the worst case for the sums overflowing between reductions
+	std::vector<Byte> ff(1 << 20, 0xff);
+	TestRandom random(1);
+	for(int t = 0; t < 20000; t++) {
+		const std::vector<Byte> &src = t % 2 ? ff : data;
+		uInt off = random.Below(64), len = random.Below(t < 18000 ? 300 : (1 << 20) - 64);
+		// sums near the modulus, and the start value
+		uLong adler = t % 7 == 0 ? 0xFFF0FFF0 : t % 11 == 0 ? 1 : (random.Below(65521) << 16) | random.Below(65521);
+		CHECK(k.fn(adler, &src[off], len) == adler32_ref(adler, &src[off], len));
+	}
+	uLong whole = adler32_ref(1, &data[0], 6000);
+	uLong parts = k.fn(1, &data[0], 1000);
+	parts = k.fn(parts, &data[1000], 37);
+	parts = k.fn(parts, &data[1037], 4963);
+	CHECK(parts == whole);
+}
+
+static void Bench(const TKernel &k, const std::vector<Byte> &data, uInt size) {
+	int reps = (int)((256u << 20) / size);
+	uLong adler = 1;
+	double t0 = NowMs();
+	for(int i = 0; i < reps; i++) adler = k.fn(adler, &data[0], size);
+	double ms = NowMs() - t0;
+	printf("  %-10s %9u bytes %10.4f ms %6.2f GB/s (%08lx)\n", k.name, size, ms / reps, (double)size * reps / ms / 1e6, adler);
+}
+
+int main(int argc, char **argv) {
+	bool bench = Benching(argc, argv);
+	std::vector<Byte> data(64 << 20);
+	TestRandom random(2);
+	for(size_t i = 0; i < data.size(); i++) data[i] = (Byte)random.Next();
+	if(bench) printf("adler32:\n");
+	for(const TKernel &k : Kernels) {
+		if(!CpuHas(k.needs)) {
+			printf("  %-10s not supported by this CPU\n", k.name);
+			continue;
+		}
+		Check(k, data);
+		if(bench)
+			for(uInt size : {1u << 10, 64u << 10, 1u << 20, 64u << 20}) Bench(k, data, size);
+	}
+	return CheckResult("AdlerTest");
+}
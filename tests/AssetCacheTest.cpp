@@ -0,0 +1,66 @@
+// Checks that the cache shares an asset for as long as somebody holds it,
+// makes it afresh after that, doesn't keep failures, and that two threads
+// making the same name at once end up with the same one
+#include <atomic>
+#include <thread>
+#include "Check.h"
+#include "AssetCache.h"
+
+typedef std::shared_ptr<const int> TIntPtr;
+
+static void CheckSharing() {
+	TAssetCache cache;
+	int makes = 0;
+	auto make = [&]() { makes++; return std::make_shared<int>(makes); };
+	TIntPtr a = cache.Get<int>("a", make);
+	TIntPtr b = cache.Get<int>("a", make);
+	CHECK(a && a == b && *a == 1 && makes == 1);
+	CHECK(cache.Made() == 1 && cache.Shared() == 1 && cache.Count() == 1);
+	TIntPtr other = cache.Get<int>("other", make);
+	CHECK(other != a && cache.Made() == 2 && cache.Count() == 2);
+	// once nobody holds it, the next Get makes it again
+	a.reset(); b.reset();
+	CHECK(cache.Count() == 1);
+	TIntPtr c = cache.Get<int>("a", make);
+	CHECK(c && *c == 3 && cache.Made() == 3 && cache.Shared() == 1 && cache.Count() == 2);
+}
+
+static void CheckFailure() {
+	TAssetCache cache;
+	int makes = 0;
+	TIntPtr a = cache.Get<int>("a", [&]() { makes++; return TIntPtr(); });
+	CHECK(!a && cache.Made() == 0 && cache.Count() == 0);
+	// so the next one tries again
+	a = cache.Get<int>("a", [&]() { makes++; return std::make_shared<int>(7); });
+	CHECK(a && *a == 7 && makes == 2 && cache.Made() == 1);
+}
+
+// CheckRace: both threads are inside make() at once, and the first finishes
+// before the second does, so both get the first one's
+static void CheckRace() {
+	TAssetCache cache;
+	std::atomic<int> inside(0);
+	std::atomic<bool> firstdone(false);
+	TIntPtr got[2];
+	auto run = [&](int t) {
+		got[t] = cache.Get<int>("a", [&]() {
+			inside++;
+			while(inside < 2) std::this_thread::yield();
+			if(t == 1) while(!firstdone) std::this_thread::yield();
+			return std::make_shared<int>(t);
+		});
+		if(t == 0) firstdone = true;
+	};
+	std::thread second(run, 1);
+	run(0);
+	second.join();
+	CHECK(got[0] && got[0] == got[1] && *got[0] == 0);
+	CHECK(cache.Made() == 1 && cache.Shared() == 1 && cache.Count() == 1);
+}
+
+int main(int, char **) {
+	CheckSharing();
+	CheckFailure();
+	CheckRace();
+	return CheckResult("AssetCacheTest");
+}
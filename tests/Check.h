@@ -0,0 +1,42 @@
+//Test helpers
+#if !defined(CHECK_H_INCLUDED_)
+#define CHECK_H_INCLUDED_
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+// CHECK: reports a condition that doesn't hold, and carries on, so that one
+// run shows every failure. CheckResult() at the end of main() says how it went.
+#define CHECK(x) ((x) ? (void)0 : CheckFailed(#x, __FILE__, __LINE__))
+
+inline int &CheckFailures() { static int n = 0; return n; }
+inline void CheckFailed(const char *what, const char *file, int line) {
+	if(CheckFailures()++ < 20) printf("%s:%d: CHECK(%s) failed\n", file, line, what);
+}
+inline int CheckResult(const char *name) {
+	if(CheckFailures() == 0) printf("%s: all passed\n", name);
+	else printf("%s: %d failed\n", name, CheckFailures());
+	return CheckFailures() == 0 ? 0 : 1;
+}
+
+// Benching: whether the program was asked to time things as well
+inline bool Benching(int argc, char **argv) { return argc > 1 && strcmp(argv[1], "bench") == 0; }
+
+// NowMs: a monotonic clock, in ms
+inline double NowMs() {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// TestRandom: the same numbers on every platform, unlike rand()
+class TestRandom {
+public:
+	explicit TestRandom(unsigned int seed) : state(seed * 2654435761u + 1) {}
+	unsigned int Next() { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return (unsigned int)(state >> 32); }
+	unsigned int Below(unsigned int n) { return Next() % n; }
+
+private:
+	unsigned long long state;
+};
+
+#endif //CHECK_H_INCLUDED_
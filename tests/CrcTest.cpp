@@ -0,0 +1,74 @@
+// Checks each crc32 kernel against the byte-at-a-time one, and times them
+#include <vector>
+#include "Check.h"
+#include "UnzipKernels.h"
+
+struct TKernel {
+	const char *name;
+	TChecksumKernel fn;
+	unsigned int needs; // CpuHas() flags
+};
+
+static const TKernel Kernels[] = {
+	{"ref", ucrc32_ref, 0},
+	{"slice8", ucrc32_slice8, 0},
+#if defined(CPU_X86)
+	{"pclmul", ucrc32_pclmul, cfPCLMUL | cfSSE41},
+#endif
+	{"dispatched", ucrc32, 0},
+};
+
+static void Check(const TKernel &k, const std::vector<Byte> &data) {
+	const Byte *check = (const Byte *)"123456789";
+	CHECK(k.fn(0, check, 9) == 0xCBF43926);
+	CHECK(k.fn(0, 0, 0) == 0);
+	TestRandom random(1);
+	for(int t = 0; t < 20000; t++) {
+		// short ones, around the 64-byte folds, then long ones
+		uInt off = random.Below(64), len = random.Below(t < 18000 ? 300 : 100000);
+		uLong crc = t % 5 == 0 ? 0 : random.Next();
+		CHECK(k.fn(crc, &data[off], len) == ucrc32_ref(crc, &data[off], len));
+	}
+	// carrying on from where the last call left off
+	uLong whole = ucrc32_ref(0, &data[0], 6000);
+	uLong parts = k.fn(0, &data[0], 1000);
+	parts = k.fn(parts, &data[1000], 37);
+	parts = k.fn(parts, &data[1037], 4963);
+	CHECK(parts == whole);
+}
+
+static void Bench(const TKernel &k, const std::vector<Byte> &data, uInt size) {
+	int reps = (int)((256u << 20) / size);
+	uLong crc = 0;
+	double t0 = NowMs();
+	for(int i = 0; i < reps; i++) crc = k.fn(crc, &data[0], size);
+	double ms = NowMs() - t0;
+	printf("  %-10s %9u bytes %10.4f ms %6.2f GB/s (%08lx)\n", k.name, size, ms / reps, (double)size * reps / ms / 1e6, crc);
+}
+
+int main(int argc, char **argv) {
+	// before anything has called ucrc32, so its dispatcher hasn't been near the tables
+	const Byte *check = (const Byte *)"123456789";
+	CHECK(ucrc32_slice8(0, check, 9) == 0xCBF43926);
+#if defined(CPU_X86)
+	if(CpuHas(cfPCLMUL | cfSSE41)) {
+		std::vector<Byte> zeros(256, 0);
+		CHECK(ucrc32_pclmul(0, &zeros[0], 256) == ucrc32_ref(0, &zeros[0], 256));
+	}
+#endif
+	bool bench = Benching(argc, argv);
+	std::vector<Byte> data(64 << 20);
+	TestRandom random(2);
+	for(size_t i = 0; i < data.size(); i++) data[i] = (Byte)random.Next();
+	if(bench) printf("crc32:\n");
+	for(const TKernel &k : Kernels) {
+		if(!CpuHas(k.needs)) {
+			printf("  %-10s not supported by this CPU\n", k.name);
+			continue;
+		}
+		Check(k, data);
+		if(bench)
+			for(uInt size : {1u << 10, 64u << 10, 1u << 20, 64u << 20}) Bench(k, data, size);
+	}
+	return CheckResult("CrcTest");
+}
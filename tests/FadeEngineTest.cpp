@@ -0,0 +1,125 @@
+// Checks that the fade follows the clock and skips rows once they're black,
+// and times a whole fade against fading every row on every frame
+#include <vector>
+#include "Check.h"
+#include "Fade.h"
+#include "FadeEngine.h"
+
+// Image: w x h bytes, each row's brightest byte rising down the image, so
+// the rows go black one band at a time
+static std::vector<unsigned char> Image(size_t w, int h, unsigned int seed) {
+	std::vector<unsigned char> bits(w * h);
+	TestRandom random(seed);
+	for(int y = 0; y < h; y++) {
+		unsigned int top = (unsigned int)(y * 256 / h) + 1;
+		for(size_t x = 0; x < w; x++) bits[y * w + x] = (unsigned char)random.Below(top);
+	}
+	return bits;
+}
+
+static void CheckLevel() {
+	TFadeEngine fade;
+	std::vector<unsigned char> bits(16, 255);
+	fade.SetSource(&bits[0], 16, 1);
+	fade.Start(1000, 2550);
+	CHECK(fade.Level(1000) == 0);
+	CHECK(fade.Level(1009) == 0);
+	CHECK(fade.Level(1010) == 1);
+	CHECK(fade.Level(1000 + 1275) == 127);
+	CHECK(fade.Level(1000 + 2549) == 254);
+	CHECK(fade.Level(1000 + 2550) == 255);
+	CHECK(fade.Level(1000 + 100000) == 255);
+	// a start just before the tick counter wraps
+	fade.Start(0xFFFFFF00u, 2550);
+	CHECK(fade.Level(0xFFFFFF00u + 1275) == 127);
+	CHECK(fade.Level(0xFFFFFF00u + 3000) == 255);
+	// frames don't depend on what was rendered before, only on the time
+	std::vector<unsigned char> dst(16);
+	fade.Start(0, 255);
+	CHECK(fade.Render(&dst[0], 100));
+	CHECK(dst[0] == 155);
+	CHECK(fade.Render(&dst[0], 100));
+	CHECK(dst[0] == 155);
+	CHECK(!fade.Render(&dst[0], 255));
+	CHECK(dst[0] == 0 && fade.Done());
+}
+
+// CheckFrames: every frame is what fading the whole image by Level() gives,
+// while the rows faded per frame fall as the image darkens
+static void CheckFrames() {
+	const size_t w = 333; const int h = 97;
+	std::vector<unsigned char> src = Image(w, h, 1), dst(w * h, 0xCD), want(w * h);
+	TFadeEngine fade;
+	fade.SetSource(&src[0], w, h);
+	fade.Start(500, 1000);
+	unsigned long long lastFaded = h + 1;
+	bool more = true;
+	int frame = 0;
+	for(unsigned int now = 500; more; now += 37, frame++) {
+		unsigned long long before = fade.Stats().rowsFaded;
+		more = fade.Render(&dst[0], now);
+		unsigned long long faded = fade.Stats().rowsFaded - before;
+		FadeBytesScalar(&want[0], &src[0], w * h, fade.Level(now));
+		CHECK(dst == want);
+		CHECK(faded <= lastFaded);
+		lastFaded = faded;
+		CHECK(now <= 500 + 1000);
+	}
+	const TFadeStats &st = fade.Stats();
+	CHECK(st.frames == (unsigned long long)frame);
+	CHECK(st.rowsCleared == (unsigned long long)h); // each row goes black once
+	CHECK(st.rowsFaded + st.rowsCleared + st.rowsSkipped == st.frames * h);
+	CHECK(st.rowsSkipped > 0);
+}
+
+// CheckShared: two engines on one source fade independently
+static void CheckShared() {
+	const size_t w = 64; const int h = 8;
+	std::vector<unsigned char> src = Image(w, h, 2);
+	std::shared_ptr<const TFadeSource> shared = std::make_shared<TFadeSource>(std::vector<unsigned char>(src), w, h);
+	TFadeEngine a, b;
+	a.SetSource(shared); b.SetSource(shared);
+	a.Start(0, 100); b.Start(50, 100);
+	std::vector<unsigned char> da(w * h), db(w * h), want(w * h);
+	a.Render(&da[0], 60); b.Render(&db[0], 60);
+	FadeBytesScalar(&want[0], &src[0], w * h, a.Level(60));
+	CHECK(da == want);
+	FadeBytesScalar(&want[0], &src[0], w * h, b.Level(60));
+	CHECK(db == want);
+	CHECK(shared->bits == src);
+}
+
+// Bench: a 255-frame fade of a 4K frame, as the saver runs it, against
+// fading every byte of every frame
+static void Bench() {
+	const size_t w = 3840 * 4; const int h = 2160;
+	std::vector<unsigned char> src = Image(w, h, 3), dst(w * h);
+	TFadeEngine fade;
+	fade.SetSource(&src[0], w, h);
+	fade.Start(0, 255 * 50);
+	printf("255 frames of fading 3840x2160x32bpp:\n");
+	double t0 = NowMs(), t = t0;
+	for(int i = 0; i <= 255; i++) {
+		unsigned long long before = fade.Stats().rowsFaded;
+		fade.Render(&dst[0], i * 50);
+		if(i % 51 == 0) {
+			double now = NowMs();
+			printf("  frame %3d: %4llu rows faded, %5.2f ms/frame over the last %d\n", i, fade.Stats().rowsFaded - before, (now - t) / (i ? 51 : 1), i ? 51 : 1);
+			t = now;
+		}
+	}
+	double engine = NowMs() - t0;
+	const TFadeStats &st = fade.Stats();
+	printf("  engine: %.1f ms in all; rows faded %llu, cleared %llu, skipped %llu\n", engine, st.rowsFaded, st.rowsCleared, st.rowsSkipped);
+	t0 = NowMs();
+	for(int i = 0; i <= 255; i++) FadeBytes(&dst[0], &src[0], w * h, (unsigned char)i);
+	printf("  every row every frame: %.1f ms in all\n", NowMs() - t0);
+}
+
+int main(int argc, char **argv) {
+	CheckLevel();
+	CheckFrames();
+	CheckShared();
+	if(Benching(argc, argv)) Bench();
+	return CheckResult("FadeEngineTest");
+}
@@ -0,0 +1,80 @@
+// Checks each fade kernel against the scalar one, and times them
+#include <vector>
+#include "Check.h"
+#include "Fade.h"
+
+typedef bool (*TFadeKernel)(unsigned char *dst, const unsigned char *src, size_t len, unsigned char amount);
+struct TKernel {
+	const char *name;
+	TFadeKernel fn;
+	unsigned int needs; // CpuHas() flags
+};
+
+static const TKernel Kernels[] = {
+	{"scalar", FadeBytesScalar, 0},
+#if defined(CPU_X86)
+	{"sse2", FadeBytesSSE2, cfSSE2},
+	{"avx2", FadeBytesAVX2, cfAVX2},
+#endif
+#if defined(CPU_NEON)
+	{"neon", FadeBytesNEON, cfNEON},
+#endif
+	{"dispatched", FadeBytes, 0},
+};
+
+// Same: kernel k gives what the scalar one does, for len bytes at offset off
+static void Same(const TKernel &k, const std::vector<unsigned char> &src, size_t off, size_t len, unsigned char amount) {
+	std::vector<unsigned char> want(len + 1), got(off + len + 1, 0xCD);
+	bool r = FadeBytesScalar(&want[0], &src[off], len, amount);
+	CHECK(k.fn(&got[off], &src[off], len, amount) == r);
+	CHECK(memcmp(&got[off], &want[0], len) == 0);
+	CHECK(got[off + len] == 0xCD); // nothing past the end
+	// and in place
+	std::vector<unsigned char> inplace(src.begin() + off, src.begin() + off + len);
+	inplace.push_back(0);
+	CHECK(k.fn(&inplace[0], &inplace[0], len, amount) == r);
+	CHECK(memcmp(&inplace[0], &want[0], len) == 0);
+}
+
+static void Check(const TKernel &k) {
+	TestRandom random(1);
+	std::vector<unsigned char> src(400);
+	for(int t = 0; t < 20000; t++) {
+		size_t len = random.Below(300), off = random.Below(64);
+		unsigned char amount = t % 7 == 0 ? 0 : t % 7 == 1 ? 255 : (unsigned char)random.Below(256);
+		// mostly dark data, so that "anything left?" is often no, or only just yes
+		int bright = random.Below(4);
+		for(size_t i = 0; i < src.size(); i++) src[i] = (unsigned char)(bright ? random.Below(256) : random.Below(3));
+		if(bright == 0 && len > 0 && t % 2) src[off + random.Below((unsigned int)len)] = (unsigned char)(amount == 255 ? 255 : amount + 1);
+		Same(k, src, off, len, amount);
+	}
+}
+
+static void Bench(const TKernel &k, size_t size, int reps) {
+	std::vector<unsigned char> src(size), dst(size);
+	TestRandom random(2);
+	for(size_t i = 0; i < size; i++) src[i] = (unsigned char)random.Next();
+	k.fn(&dst[0], &src[0], size, 1);
+	double t0 = NowMs();
+	for(int i = 0; i < reps; i++) k.fn(&dst[0], &src[0], size, (unsigned char)(i * 12));
+	double ms = (NowMs() - t0) / reps;
+	printf("  %-10s %9zu bytes %8.3f ms %6.2f GB/s\n", k.name, size, ms, size / ms / 1e6);
+}
+
+int main(int argc, char **argv) {
+	bool bench = Benching(argc, argv);
+	// a 4K frame at 32bpp, which is memory-bound, and 256KB, which stays in cache
+	if(bench) printf("FadeBytes:\n");
+	for(const TKernel &k : Kernels) {
+		if(!CpuHas(k.needs)) {
+			printf("  %-10s not supported by this CPU\n", k.name);
+			continue;
+		}
+		Check(k);
+		if(bench) {
+			Bench(k, 3840 * 2160 * 4, 20);
+			Bench(k, 256 * 1024, 4000);
+		}
+	}
+	return CheckResult("FadeTest");
+}
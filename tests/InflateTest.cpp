@@ -0,0 +1,339 @@
+// Checks TInflater against the zlib 1.1.3 inflate that it replaced, which is
+// still in unzip.cpp, on streams made with the system's zlib; and that
+// UnzipItem still hands items out as it always did. Times the two as well.
+#include <windows.h>
+#include <zlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "Inflate.h"
+#include "unzip.h"
+#include "TestZip.h"
+
+// from unzip.cpp. UnzipKernels.h declares it too, but also an adler32 that
+// clashes with zlib's.
+int inflate_ref(const Byte *in, uInt inlen, uInt chunk, Byte *out, uInt outlen, uInt *written);
+
+typedef std::vector<unsigned char> TBytes;
+
+struct TSource {
+	std::string name;
+	TBytes data;
+};
+
+static std::vector<TSource> Sources() {
+	std::vector<TSource> sources;
+	TestRandom random(1);
+	sources.push_back({"empty", TBytes()});
+	sources.push_back({"one", TBytes(1, 'a')});
+	sources.push_back({"zeros", TBytes(300000, 0)});
+	TBytes bytes(200000);
+	for(size_t i = 0; i < bytes.size(); i++) bytes[i] = (unsigned char)random.Next();
+	sources.push_back({"random", bytes});
+	// unzip.cpp itself, for some text
+	bytes.clear();
+	if(FILE *f = fopen(SOURCE_DIR "/unzip.cpp", "rb")) {
+		unsigned char buf[65536]; size_t n;
+		while((n = fread(buf, 1, sizeof(buf), f)) > 0) bytes.insert(bytes.end(), buf, buf + n);
+		fclose(f);
+	}
+	CHECK(bytes.size() > 100000);
+	sources.push_back({"text", bytes});
+	// short periods, for overlapping matches
+	bytes.clear();
+	for(int r = 0; r < 300; r++) {
+		unsigned int period = 1 + random.Below(40), times = 1 + random.Below(200);
+		TBytes pattern(period);
+		for(unsigned int i = 0; i < period; i++) pattern[i] = (unsigned char)random.Next();
+		for(unsigned int t = 0; t < times; t++) bytes.insert(bytes.end(), pattern.begin(), pattern.end());
+	}
+	sources.push_back({"periods", bytes});
+	// a few common bytes and many rare ones, for long codes
+	bytes.resize(400000);
+	for(size_t i = 0; i < bytes.size(); i++) {
+		unsigned int v = 0;
+		while(v < 255 && random.Below(6) != 0) v++;
+		bytes[i] = (unsigned char)v;
+	}
+	sources.push_back({"skewed", bytes});
+	return sources;
+}
+
+// TEncoding: how to deflate. flushes mixes block types, by changing level and
+// strategy every few KB, with sync and full flushes between.
+struct TEncoding {
+	const char *name;
+	int level, strategy, wbits, memlevel;
+	bool flushes;
+};
+
+static const TEncoding Encodings[] = {
+	{"stored", 0, Z_DEFAULT_STRATEGY, -15, 8, false},
+	{"fixed", 6, Z_FIXED, -15, 8, false},
+	{"dynamic1", 1, Z_DEFAULT_STRATEGY, -15, 8, false},
+	{"dynamic6", 6, Z_DEFAULT_STRATEGY, -15, 8, false},
+	{"dynamic9", 9, Z_DEFAULT_STRATEGY, -15, 8, false},
+	{"smallblocks", 6, Z_DEFAULT_STRATEGY, -15, 1, false},
+	{"huffman", 6, Z_HUFFMAN_ONLY, -15, 8, false},
+	{"rle", 6, Z_RLE, -15, 8, false},
+	{"window9", 9, Z_DEFAULT_STRATEGY, -9, 8, false},
+	{"mixed", 6, Z_DEFAULT_STRATEGY, -15, 8, true},
+};
+
+static TBytes Deflate(const TBytes &src, const TEncoding &e, unsigned int seed) {
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	deflateInit2(&zs, e.level, Z_DEFLATED, e.wbits, e.memlevel, e.strategy);
+	TBytes out(deflateBound(&zs, (uLong)src.size()) + 1024);
+	zs.next_out = &out[0]; zs.avail_out = (uInt)out.size();
+	TestRandom random(seed);
+	size_t pos = 0;
+	for(int k = 0; ; k++) {
+		size_t n = e.flushes ? 1 + random.Below(5000) : src.size();
+		if(n > src.size() - pos) n = src.size() - pos;
+		zs.next_in = (Bytef *)(src.empty() ? 0 : &src[pos]); zs.avail_in = (uInt)n;
+		pos += n;
+		if(pos == src.size()) {
+			deflate(&zs, Z_FINISH);
+			break;
+		}
+		deflate(&zs, k % 2 ? Z_SYNC_FLUSH : Z_FULL_FLUSH);
+		static const int levels[] = {6, 0, 1, 9}, strategies[] = {Z_DEFAULT_STRATEGY, Z_FIXED, Z_DEFAULT_STRATEGY, Z_HUFFMAN_ONLY};
+		deflateParams(&zs, levels[k % 4], strategies[k % 3]);
+	}
+	out.resize(zs.total_out);
+	deflateEnd(&zs);
+	return out;
+}
+
+// Old: the reference decoder, into room for outlen bytes
+static int Old(const TBytes &in, size_t outlen, TBytes &out) {
+	out.assign(outlen + 1, 0);
+	uInt written = 0;
+	int r = inflate_ref(in.empty() ? 0 : &in[0], (uInt)in.size(), 16384, &out[0], (uInt)outlen, &written);
+	out.resize(written);
+	return r;
+}
+
+static TInflateStatus Whole(const TBytes &in, size_t outlen, TBytes &out) {
+	TInflater inflater;
+	out.assign(outlen + 1, 0);
+	size_t written = 0;
+	TInflateStatus st = inflater.Whole(in.empty() ? 0 : &in[0], in.size(), &out[0], outlen, written);
+	out.resize(written);
+	return st;
+}
+
+// Stream: feeds the decoder up to maxin bytes at a time, and gives it room for
+// up to maxout, at random, until it ends, fails, or makes more than limit
+static TInflateStatus Stream(TInflater &inflater, const TBytes &in, size_t maxin, size_t maxout, size_t limit, TBytes &out, TestRandom &random) {
+	inflater.Reset();
+	out.clear();
+	static const unsigned char none = 0;
+	const unsigned char *p = in.empty() ? &none : &in[0], *end = p + in.size(), *avail = p;
+	TBytes buf(maxout);
+	for(;;) {
+		if(avail == p && avail < end) {
+			size_t n = 1 + random.Below((unsigned int)maxin);
+			avail += n < (size_t)(end - avail) ? n : end - avail;
+		}
+		unsigned char *op = &buf[0];
+		const unsigned char *before = p;
+		TInflateStatus st = inflater.Stream(p, avail, avail == end, op, op + 1 + random.Below((unsigned int)maxout));
+		out.insert(out.end(), &buf[0], op);
+		if(st != isMore || out.size() > limit) return st;
+		if(p == before && op == &buf[0] && avail == end) return isMore; // stuck: it has to say so instead
+	}
+}
+
+static bool IsPrefix(const TBytes &a, const TBytes &of) {
+	return a.size() <= of.size() && std::equal(a.begin(), a.end(), of.begin());
+}
+
+static void CheckGood(const TSource &src, const TBytes &comp, TestRandom &random) {
+	size_t n = src.data.size();
+	TBytes old, got;
+	int r = Old(comp, n, old);
+	CHECK((r == Z_STREAM_END || r == Z_OK) && old == src.data);
+	CHECK(Whole(comp, n, got) == isEnd && got == old);
+	if(n > 0) CHECK(Whole(comp, n - 1, got) == isMore);
+	TInflater inflater; // reused, as unzip does
+	static const size_t chunks[][2] = {{1, 1}, {7, 3}, {1000, 1000}, {65536, 65536}, {300000, 300000}};
+	for(const size_t *c : chunks) {
+		if(c[0] == 1 && n > 100000) continue;
+		CHECK(Stream(inflater, comp, c[0], c[1], n, got, random) == isEnd && got == old);
+	}
+}
+
+// CheckTruncated: cut short anywhere, neither decoder may say it's all there,
+// and what they do give has to be right as far as it goes
+static void CheckTruncated(const TSource &src, const TBytes &comp, TestRandom &random) {
+	if(comp.size() < 2) return;
+	for(int t = 0; t < 20; t++) {
+		TBytes in(comp.begin(), comp.begin() + random.Below((unsigned int)comp.size())), old, got;
+		CHECK(Old(in, src.data.size() + 1000, old) != Z_STREAM_END && IsPrefix(old, src.data));
+		CHECK(Whole(in, src.data.size() + 1000, got) != isEnd && IsPrefix(got, src.data));
+		TInflater inflater;
+		CHECK(Stream(inflater, in, 1 + random.Below(5000), 1 + random.Below(5000), src.data.size() + 1000, got, random) != isEnd && IsPrefix(got, src.data));
+	}
+}
+
+// CheckCorrupt: with bits flipped, the new decoder mustn't crash or hang,
+// Stream() and Whole() have to agree, and whatever both decoders accept they
+// have to decode the same. They may only disagree on whether it's acceptable
+// where the old one is known to be wrong: it doesn't check for distances back
+// past the start of the output, and without the dummy byte that it wants
+// after raw deflate data it can't see the very end of it.
+static void CheckCorrupt(const TSource &src, const TBytes &comp, TestRandom &random, int &accepted, int &differ) {
+	if(comp.empty() || comp.size() > 100000) return;
+	size_t limit = src.data.size() + 1000;
+	for(int t = 0; t < 30; t++) {
+		TBytes in = comp, old, whole, stream;
+		size_t written = 0;
+		for(int f = 1 + random.Below(4); f > 0; f--) in[random.Below((unsigned int)in.size())] ^= (unsigned char)(1 << random.Below(8));
+		if(random.Below(4) == 0) in.resize(random.Below((unsigned int)in.size()));
+		int r = Old(in, limit, old);
+		TInflater inflater;
+		whole.assign(limit + 1, 0);
+		TInflateStatus st = inflater.Whole(in.empty() ? 0 : &in[0], in.size(), &whole[0], limit, written);
+		whole.resize(written);
+		TInflater streamer;
+		TInflateStatus sst = Stream(streamer, in, 1 + random.Below(5000), 1 + random.Below(5000), limit, stream, random);
+		if(st == isEnd) CHECK(sst == isEnd && stream == whole);
+		if(st == isError) CHECK(sst == isError);
+		if(r == Z_STREAM_END && st == isEnd) {
+			accepted++;
+			CHECK(old == whole);
+		}
+		else if(r == Z_STREAM_END && st == isError) {
+			differ++;
+			CHECK(strcmp(inflater.Error(), "invalid distance too far back") == 0);
+		}
+		else if(r != Z_STREAM_END && st == isEnd) {
+			differ++;
+			CHECK(r == Z_OK && old == whole);
+		}
+	}
+}
+
+// CheckUnzipItem: items come out whole, or a piece at a time with ZR_MORE
+// until the last, which gives ZR_OK; and ones that are cut short fail. (A bad
+// crc never has made UnzipItem fail, and still doesn't.)
+static void CheckUnzipItem(const std::vector<TSource> &sources) {
+	std::vector<TTestZipEntry> entries;
+	std::vector<const TBytes *> want;
+	for(const TSource &src : sources) {
+		unsigned long crc = crc32(0, src.data.empty() ? 0 : &src.data[0], (uInt)src.data.size());
+		entries.push_back({src.name + ".stored", src.data, 0, crc, (unsigned int)src.data.size()});
+		entries.push_back({src.name + ".fixed", Deflate(src.data, Encodings[1], 2), 8, crc, (unsigned int)src.data.size()});
+		entries.push_back({src.name + ".deflated", Deflate(src.data, Encodings[3], 3), 8, crc, (unsigned int)src.data.size()});
+		want.insert(want.end(), 3, &src.data);
+	}
+	int good = (int)entries.size();
+	// cut short
+	const TSource &text = sources[4];
+	TBytes cut = Deflate(text.data, Encodings[3], 4);
+	cut.resize(cut.size() / 2);
+	entries.push_back({"cut.deflated", cut, 8, crc32(0, &text.data[0], (uInt)text.data.size()), (unsigned int)text.data.size()});
+	TBytes zip = MakeTestZip(entries);
+	const char *filename = "InflateTest.zip";
+	if(FILE *f = fopen(filename, "wb")) {
+		fwrite(&zip[0], 1, zip.size(), f);
+		fclose(f);
+	}
+	for(int mode = 0; mode < 2; mode++) {
+		// from memory, where it can decode in one go, and from a handle, where it can't
+		HANDLE h = mode ? CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL) : 0;
+		HZIP hz = mode ? OpenZip(h, 0, ZIP_HANDLE) : OpenZip(&zip[0], (unsigned int)zip.size(), ZIP_MEMORY);
+		CHECK(hz != 0);
+		if(hz == 0) continue;
+		ZIPENTRY ze;
+		CHECK(GetZipItem(hz, -1, &ze) == ZR_OK && ze.index == (int)entries.size());
+		for(int i = 0; i < good; i++) {
+			const TBytes &data = *want[i];
+			size_t n = data.size();
+			ZRESULT zr;
+			for(size_t room : {n, n + 100}) {
+				// all of it in one go, though that may still say ZR_MORE, as it always
+				// has; the next call says it's done, having nothing more to give
+				TBytes got(room + 1, 0xCD);
+				zr = UnzipItem(hz, i, &got[0], (unsigned int)room, ZIP_MEMORY);
+				CHECK((zr == ZR_OK || zr == ZR_MORE) && std::equal(data.begin(), data.end(), got.begin()));
+				if(zr == ZR_MORE) CHECK(UnzipItem(hz, i, &got[0], (unsigned int)room, ZIP_MEMORY) == ZR_OK && got[n] == 0xCD);
+			}
+			for(unsigned int chunk : {1u, 1000u, 16384u, 70000u}) {
+				if(chunk == 1 && n > 20000) continue;
+				TBytes pieces, buf(chunk);
+				size_t calls = 0;
+				do {
+					zr = UnzipItem(hz, i, &buf[0], chunk, ZIP_MEMORY);
+					size_t take = n - pieces.size() < chunk ? n - pieces.size() : chunk;
+					if(zr == ZR_MORE || zr == ZR_OK) pieces.insert(pieces.end(), buf.begin(), buf.begin() + take);
+				} while(zr == ZR_MORE && ++calls <= n / chunk + 2);
+				CHECK(zr == ZR_OK && pieces == data);
+			}
+		}
+		for(int i = good; i < (int)entries.size(); i++) {
+			TBytes got(text.data.size() + 100);
+			ZRESULT zr = UnzipItem(hz, i, &got[0], (unsigned int)got.size(), ZIP_MEMORY);
+			CHECK(zr != ZR_OK && zr != ZR_MORE);
+			unsigned int chunk = 1000, calls = 0;
+			do zr = UnzipItem(hz, i, &got[0], chunk, ZIP_MEMORY);
+			while(zr == ZR_MORE && ++calls <= text.data.size() / chunk + 2);
+			CHECK(zr != ZR_OK && zr != ZR_MORE);
+		}
+		CloseZip(hz);
+		if(mode) CloseHandle(h);
+	}
+	remove(filename);
+}
+
+static void Bench(const TSource &src, const TBytes &comp) {
+	size_t n = src.data.size();
+	int reps = (int)(50000000 / (n + 1)) + 1;
+	TBytes out(n + 1);
+	double t0 = NowMs();
+	for(int i = 0; i < reps; i++) {
+		uInt written;
+		inflate_ref(&comp[0], (uInt)comp.size(), 16384, &out[0], (uInt)n, &written);
+	}
+	double t1 = NowMs();
+	TInflater inflater;
+	for(int i = 0; i < reps; i++) {
+		size_t written;
+		inflater.Reset();
+		inflater.Whole(&comp[0], comp.size(), &out[0], n, written);
+	}
+	double t2 = NowMs();
+	TestRandom random(6);
+	for(int i = 0; i < reps; i++) Stream(inflater, comp, 16384, 16384, n, out, random);
+	double t3 = NowMs();
+	double mb = (double)n * reps / 1e3;
+	printf("  %-8s %7zu bytes: old %7.1f MB/s  Whole %7.1f MB/s  Stream %7.1f MB/s\n", src.name.c_str(), n, mb / (t1 - t0), mb / (t2 - t1), mb / (t3 - t2));
+}
+
+int main(int argc, char **argv) {
+	bool bench = Benching(argc, argv);
+	std::vector<TSource> sources = Sources();
+	TestRandom random(7);
+	int accepted = 0, differ = 0;
+	for(const TSource &src : sources) {
+		for(const TEncoding &e : Encodings) {
+			TBytes comp = Deflate(src.data, e, 8);
+			int before = CheckFailures();
+			CheckGood(src, comp, random);
+			CheckTruncated(src, comp, random);
+			CheckCorrupt(src, comp, random, accepted, differ);
+			if(CheckFailures() != before) printf("  (%s, %s)\n", src.name.c_str(), e.name);
+		}
+	}
+	printf("corrupt streams: %d decoded the same by both, %d accepted by only one\n", accepted, differ);
+	CheckUnzipItem(sources);
+	if(bench) {
+		printf("inflate, level 6:\n");
+		for(const TSource &src : sources)
+			if(src.data.size() > 1000) Bench(src, Deflate(src.data, Encodings[3], 8));
+	}
+	return CheckResult("InflateTest");
+}
@@ -0,0 +1,192 @@
+// Checks TJpegDecoder against libjpeg, pixel for pixel: background.jpg from
+// data.zip, and images libjpeg encodes here in every sampling the decoder
+// handles, baseline and progressive, with and without restart markers, at
+// each scale. Times the two on background.jpg.
+#include <windows.h>
+#include <stdlib.h>
+#include <vector>
+#include <jpeglib.h>
+#include "Check.h"
+#include "Jpeg.h"
+#include "unzip.h"
+
+typedef std::vector<unsigned char> TBytes;
+
+// TEncoding: how libjpeg is to encode a test image
+struct TEncoding {
+	int quality;
+	int h, v;        // the luma's sampling factors; the chroma's are 1x1
+	bool grey;
+	bool progressive;
+	int restart;     // in MCUs, or 0 for none
+};
+
+static TBytes Encode(const TBytes &rgb, int w, int h, const TEncoding &e) {
+	jpeg_compress_struct c;
+	jpeg_error_mgr err;
+	c.err = jpeg_std_error(&err);
+	jpeg_create_compress(&c);
+	unsigned char *buf = 0; unsigned long len = 0;
+	jpeg_mem_dest(&c, &buf, &len);
+	c.image_width = w; c.image_height = h;
+	c.input_components = 3; c.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&c);
+	jpeg_set_quality(&c, e.quality, TRUE);
+	if(e.grey) jpeg_set_colorspace(&c, JCS_GRAYSCALE);
+	else { c.comp_info[0].h_samp_factor = e.h; c.comp_info[0].v_samp_factor = e.v; }
+	if(e.progressive) jpeg_simple_progression(&c);
+	c.restart_interval = e.restart;
+	jpeg_start_compress(&c, TRUE);
+	while(c.next_scanline < c.image_height) {
+		JSAMPROW row = (JSAMPROW)&rgb[(size_t)c.next_scanline * w * 3];
+		jpeg_write_scanlines(&c, &row, 1);
+	}
+	jpeg_finish_compress(&c);
+	jpeg_destroy_compress(&c);
+	TBytes jpeg(buf, buf + len);
+	free(buf);
+	return jpeg;
+}
+
+// Reference: libjpeg's decoding at 1/scale, as RGB, with the defaults the
+// decoder follows (islow, fancy upsampling)
+static TBytes Reference(const TBytes &jpeg, int scale, int &w, int &h) {
+	jpeg_decompress_struct d;
+	jpeg_error_mgr err;
+	d.err = jpeg_std_error(&err);
+	jpeg_create_decompress(&d);
+	jpeg_mem_src(&d, const_cast<unsigned char *>(&jpeg[0]), (unsigned long)jpeg.size());
+	jpeg_read_header(&d, TRUE);
+	d.scale_num = 1; d.scale_denom = scale;
+	d.dct_method = JDCT_ISLOW; d.do_fancy_upsampling = TRUE;
+	d.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&d);
+	w = d.output_width; h = d.output_height;
+	TBytes rgb((size_t)w * h * 3);
+	while(d.output_scanline < d.output_height) {
+		JSAMPROW row = &rgb[(size_t)d.output_scanline * w * 3];
+		jpeg_read_scanlines(&d, &row, 1);
+	}
+	jpeg_finish_decompress(&d);
+	jpeg_destroy_decompress(&d);
+	return rgb;
+}
+
+// CheckSame: decodes at every scale, into 24 and 32bpp, and counts the
+// decodings that differ from libjpeg's anywhere
+static void CheckSame(const TBytes &jpeg, const char *name, int &decoded, int &differ) {
+	for(int scale = 1; scale <= 8; scale *= 2) {
+		int w, h;
+		TBytes ref = Reference(jpeg, scale, w, h);
+		TJpegDecoder dec;
+		CHECK(dec.ReadHeader(&jpeg[0], jpeg.size()));
+		CHECK(TJpegDecoder::Scaled(dec.Width(), scale) == w && TJpegDecoder::Scaled(dec.Height(), scale) == h);
+		for(int bpp = 24; bpp <= 32; bpp += 8) {
+			int bytes = bpp / 8, stride = (w * bytes + 3) & ~3;
+			TBytes bits((size_t)stride * h, 0xAA);
+			bool ok = dec.Decode(TSurface(w, h, stride, bpp, &bits[0]), scale);
+			CHECK(ok);
+			int diffs = 0;
+			for(int y = 0; y < h; y++)
+				for(int x = 0; x < w; x++) {
+					const unsigned char *p = &bits[(size_t)y * stride + x * bytes], *q = &ref[((size_t)y * w + x) * 3];
+					if(p[0] != q[2] || p[1] != q[1] || p[2] != q[0] || (bytes == 4 && p[3] != 0)) diffs++;
+				}
+			decoded++;
+			if(!ok || diffs > 0) {
+				if(differ++ < 20) printf("  %s at 1/%d, %dbpp: %d pixels differ\n", name, scale, bpp, diffs);
+			}
+		}
+	}
+}
+
+// Picture: something for libjpeg to encode, with gradients, hard edges and
+// noise, so that every coefficient gets used
+static TBytes Picture(int w, int h, unsigned int seed) {
+	TestRandom random(seed);
+	TBytes rgb((size_t)w * h * 3);
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++) {
+			unsigned char *p = &rgb[((size_t)y * w + x) * 3];
+			int edge = ((x / 5) ^ (y / 3)) & 1 ? 60 : 0;
+			p[0] = (unsigned char)((x * 255 / (w > 1 ? w - 1 : 1) + edge) & 255);
+			p[1] = (unsigned char)((y * 255 / (h > 1 ? h - 1 : 1) + random.Below(48)) & 255);
+			p[2] = (unsigned char)(((x + y) * 7 + edge * 2 + random.Below(16)) & 255);
+		}
+	return rgb;
+}
+
+static TBytes LoadBackground() {
+	HZIP hz = OpenZip((void *)SOURCE_DIR "/data.zip", 0, ZIP_FILENAME);
+	CHECK(hz != 0);
+	if(hz == 0) return TBytes();
+	ZIPENTRY ze; int index = -1;
+	FindZipItem(hz, "background.jpg", true, &index, &ze);
+	TBytes jpeg(index >= 0 ? (size_t)ze.unc_size : 0);
+	ZRESULT zr = jpeg.empty() ? ZR_NOTFOUND : UnzipItem(hz, index, &jpeg[0], (unsigned int)jpeg.size(), ZIP_MEMORY);
+	CloseZip(hz);
+	CHECK(zr == ZR_OK || zr == ZR_MORE);
+	return jpeg;
+}
+
+// CheckTooBig: a header that says 65535x65535 fails, rather than wrapping
+// round to a small buffer on 32-bit builds
+static void CheckTooBig() {
+	TEncoding e = {75, 2, 2, false, true, 0};
+	TBytes jpeg = Encode(Picture(16, 16, 1), 16, 16, e);
+	for(size_t i = 0; i + 8 < jpeg.size(); i++)
+		if(jpeg[i] == 0xFF && jpeg[i + 1] == 0xC2) { jpeg[i + 5] = jpeg[i + 6] = jpeg[i + 7] = jpeg[i + 8] = 0xFF; break; }
+	TJpegDecoder dec;
+	CHECK(dec.ReadHeader(&jpeg[0], jpeg.size()) && dec.Width() == 65535 && dec.Height() == 65535);
+	int w = TJpegDecoder::Scaled(65535, 8);
+	TBytes bits((size_t)w * w * 3);
+	CHECK(!dec.Decode(TSurface(w, w, w * 3, 24, &bits[0]), 8));
+}
+
+static void Bench(const TBytes &jpeg) {
+	printf("background.jpg, ms per decode:\n");
+	for(int scale = 1; scale <= 8; scale *= 2) {
+		const int reps = 10;
+		int w, h;
+		double t0 = NowMs();
+		for(int i = 0; i < reps; i++) Reference(jpeg, scale, w, h);
+		double ref = (NowMs() - t0) / reps;
+		int stride = (w * 4 + 3) & ~3;
+		TBytes bits((size_t)stride * h);
+		t0 = NowMs();
+		for(int i = 0; i < reps; i++) {
+			TJpegDecoder dec;
+			dec.ReadHeader(&jpeg[0], jpeg.size());
+			dec.Decode(TSurface(w, h, stride, 32, &bits[0]), scale);
+		}
+		double mine = (NowMs() - t0) / reps;
+		printf("  1/%d %5dx%-5d libjpeg %7.2f  TJpegDecoder %7.2f\n", scale, w, h, ref, mine);
+	}
+}
+
+int main(int argc, char **argv) {
+	int decoded = 0, differ = 0;
+	TBytes background = LoadBackground();
+	if(!background.empty()) CheckSame(background, "background.jpg", decoded, differ);
+	static const TEncoding encodings[] = {
+		{90, 1, 1, false, false, 0}, {75, 2, 1, false, false, 0}, {75, 2, 2, false, false, 0}, {75, 1, 2, false, false, 0},
+		{50, 2, 2, false, true, 0}, {95, 1, 1, false, true, 0}, {85, 2, 1, false, true, 0}, {85, 1, 2, false, true, 0},
+		{80, 1, 1, true, false, 0}, {80, 1, 1, true, true, 0},
+		{75, 2, 2, false, false, 3}, {75, 2, 1, false, true, 5}, {100, 1, 1, false, false, 1}, {10, 1, 2, false, true, 2},
+	};
+	static const int sizes[][2] = {{1, 1}, {7, 5}, {8, 8}, {9, 17}, {16, 16}, {17, 9}, {33, 31}, {64, 1}, {1, 64}, {101, 67}, {255, 3}, {257, 129}};
+	for(const auto &size : sizes) {
+		int w = size[0], h = size[1];
+		TBytes rgb = Picture(w, h, w * 1000 + h);
+		for(const TEncoding &e : encodings) {
+			char name[64];
+			sprintf(name, "%dx%d q%d %s%s r%d", w, h, e.quality, e.grey ? "grey" : e.h == 2 ? (e.v == 2 ? "4:2:0" : "4:2:2") : (e.v == 2 ? "4:4:0" : "4:4:4"), e.progressive ? " progressive" : "", e.restart);
+			CheckSame(Encode(rgb, w, h, e), name, decoded, differ);
+		}
+	}
+	printf("%d decodings, %d differ from libjpeg's\n", decoded, differ);
+	CHECK(differ == 0);
+	CheckTooBig();
+	if(Benching(argc, argv) && !background.empty()) Bench(background);
+	return CheckResult("JpegTest");
+}
@@ -0,0 +1,90 @@
+// Checks that the physics is repeatable and frame-rate independent, and times
+// it at 10, 1k and 10k sprites
+#include <vector>
+#include "Check.h"
+#include "Physics.h"
+
+static bool SameState(const TPhysics &a, const TPhysics &b) {
+	if(a.Count() != b.Count()) return false;
+	for(int i = 0; i < a.Count(); i++)
+		if(a.X(i) != b.X(i) || a.Y(i) != b.Y(i)) return false;
+	return true;
+}
+
+// CheckFrameRate: whatever the frame times, the sprites are in the same
+// places at the same time
+static void CheckFrameRate() {
+	const unsigned int frames[] = {10, 16, 33, 50, 170, 7};
+	const size_t nruns = sizeof(frames) / sizeof(frames[0]);
+	std::vector<TPhysics> runs(nruns);
+	std::vector<unsigned int> now(nruns, 1000);
+	for(size_t r = 0; r < nruns; r++) runs[r].Start(800, 600, 40, 30, 50, 1000, 9);
+	for(unsigned int t = 1000 + 1234; t <= 1000 + 30000; t += 1234) {
+		for(size_t r = 0; r < nruns; r++) {
+			// up to t in frames of frames[r], then exactly t
+			while(now[r] + frames[r] < t) { now[r] += frames[r]; runs[r].Advance(now[r]); }
+			runs[r].Advance(now[r] = t);
+		}
+		for(size_t r = 1; r < nruns; r++) CHECK(SameState(runs[0], runs[r]));
+	}
+	// and a different seed goes somewhere else
+	TPhysics a, b;
+	a.Start(800, 600, 40, 30, 50, 1000, 9);
+	b.Start(800, 600, 40, 30, 50, 1000, 10);
+	a.Advance(6000); b.Advance(6000);
+	CHECK(!SameState(a, b));
+}
+
+// CheckBox: every sprite stays in the box, with drawing positions between
+// the last two steps
+static void CheckBox() {
+	const int w = 640, h = 480, sw = 24, sh = 24;
+	TPhysics p;
+	p.Start(w, h, sw, sh, 400, 0, 3);
+	for(unsigned int t = 0; t < 30000; t += 17) {
+		p.Advance(t);
+		for(int i = 0; i < p.Count(); i++) {
+			CHECK(p.X(i) >= 0 && p.X(i) <= w - sw);
+			CHECK(p.Y(i) >= 0 && p.Y(i) <= h - sh);
+		}
+	}
+	CHECK(p.Hits() > 0);
+	// after a long sleep it catches up at most MAXSTEPS, and carries on
+	p.Advance(30000 + 3600000);
+	p.Advance(30000 + 3600000 + 20);
+	for(int i = 0; i < p.Count(); i++) CHECK(p.X(i) >= 0 && p.X(i) <= w - sw);
+}
+
+// CheckBroadPhase: the grid keeps the pairs tested per step near O(n)
+static void CheckBroadPhase() {
+	TPhysics p;
+	const int n = 10000;
+	p.Start(3840, 2160, 16, 16, n, 0, 5);
+	for(int i = 0; i < 10; i++) p.Step();
+	unsigned long long perStep = p.Pairs() / 10;
+	CHECK(perStep < 20ull * n); // rather than n*n/2 = 50M
+	CHECK(perStep > 0);
+}
+
+static void Bench() {
+	const int counts[] = {10, 1000, 10000};
+	printf("sprites of 16x16 in 3840x2160, 50ms frames of 5 steps:\n");
+	for(int n : counts) {
+		TPhysics p;
+		p.Start(3840, 2160, 16, 16, n, 0, 1);
+		const int frames = n >= 10000 ? 200 : 2000;
+		double t0 = NowMs();
+		for(int f = 1; f <= frames; f++) p.Advance(f * 50);
+		double ms = (NowMs() - t0) / frames;
+		printf("  %5d sprites: %8.4f ms/frame, %8.1f pairs tested/step, %6.2f hits/step\n", n, ms,
+			(double)p.Pairs() / (frames * 5), (double)p.Hits() / (frames * 5));
+	}
+}
+
+int main(int argc, char **argv) {
+	CheckFrameRate();
+	CheckBox();
+	CheckBroadPhase();
+	if(Benching(argc, argv)) Bench();
+	return CheckResult("PhysicsTest");
+}
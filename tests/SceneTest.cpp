@@ -0,0 +1,77 @@
+// Checks that the frames the scene draws bit by bit, from its dirty rects,
+// are the frames it would draw whole
+#include <vector>
+#include "Check.h"
+#include "Scene.h"
+#include "FrameBuffer.h"
+
+// TImages: a background and a sprite (a disc on a key colour) to show
+struct TImages {
+	std::vector<unsigned char> bg, spr;
+	TSurface background, sprite;
+	TImages() : bg(160 * 100 * 3), spr(24 * 24 * 3) {
+		for(int y = 0; y < 100; y++)
+			for(int x = 0; x < 160; x++) {
+				unsigned char *p = &bg[(y * 160 + x) * 3];
+				p[0] = (unsigned char)x; p[1] = (unsigned char)(y * 2); p[2] = 200;
+			}
+		for(int y = 0; y < 24; y++)
+			for(int x = 0; x < 24; x++) {
+				unsigned char *p = &spr[(y * 24 + x) * 3];
+				bool in = (x - 12) * (x - 12) + (y - 12) * (y - 12) < 100;
+				p[0] = in ? 40 : 255; p[1] = in ? 200 : 0; p[2] = in ? 90 : 255;
+			}
+		background = TSurface(160, 100, 160 * 3, 24, &bg[0]);
+		sprite = TSurface(24, 24, 24 * 3, 24, &spr[0]);
+	}
+};
+
+// CheckIncremental: plays frames from startMs, and after each one checks it
+// against the whole frame drawn again
+static void CheckIncremental(int nsprites, unsigned int startMs, int frames) {
+	TImages images;
+	TSaverScene scene;
+	scene.SetBackground(images.background);
+	scene.SetSprite(images.sprite, 0, 48);
+	scene.SetSpriteCount(nsprites);
+	scene.SetCaption("caption");
+	const int w = 320, h = 200;
+	scene.Start(w, h, startMs, 200, 7);
+	TFrameBuffer fb(w, h), whole(w, h);
+	int partial = 0;
+	unsigned int now = startMs;
+	for(int i = 0; i < frames; i++, now += 50) {
+		unsigned int secs = now / 1000;
+		scene.Tick(now, (secs / 3600) % 24, (secs / 60) % 60, secs % 60);
+		std::vector<TRect> rects = scene.Render(fb, now);
+		if(rects.size() != 1 || rects[0].Area() != (long long)w * h) partial++;
+		scene.Invalidate(TRect(0, 0, w, h));
+		scene.Render(whole, now);
+		CHECK(fb.Checksum() == whole.Checksum());
+	}
+	CHECK(scene.FadeDone());
+	CHECK(partial > 0); // it did get past the fade, to drawing just what changed
+}
+
+// CheckRepeatable: the same seed and times give the same frames
+static void CheckRepeatable() {
+	TImages images;
+	unsigned int sums[2];
+	for(int run = 0; run < 2; run++) {
+		TSaverScene scene;
+		scene.SetBackground(images.background);
+		scene.SetSprite(images.sprite, 0, 48);
+		scene.SetSpriteCount(5);
+		scene.Start(200, 150, 1000, 500, 42);
+		sums[run] = RunHeadless(scene, 40, 1000, 33, 0);
+	}
+	CHECK(sums[0] == sums[1]);
+}
+
+int main(int, char **) {
+	// across 9:59:59 to 10:00:00, when the clock gets wider
+	CheckIncremental(1, (9 * 3600 + 59 * 60 + 50) * 1000, 240);
+	CheckIncremental(20, 1000, 100);
+	CheckRepeatable();
+	return CheckResult("SceneTest");
+}
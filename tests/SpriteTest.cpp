@@ -0,0 +1,144 @@
+// Checks that drawing a sprite by its spans gives what blending its whole
+// rect does, and times the two with sprite.bmp from data.zip
+#include <windows.h>
+#include <vector>
+#include "Check.h"
+#include "Sprite.h"
+#include "unzip.h"
+
+// LoadSprite: sprite.bmp out of data.zip, as 24bpp top row first, as the
+// saver loads it. bits has to outlive the surface.
+static TSurface LoadSprite(std::vector<unsigned char> &bits) {
+	HZIP hz = OpenZip((void *)SOURCE_DIR "/data.zip", 0, ZIP_FILENAME);
+	CHECK(hz != 0);
+	if(hz == 0) return TSurface();
+	ZIPENTRY ze; int index = -1;
+	FindZipItem(hz, "sprite.bmp", true, &index, &ze);
+	std::vector<unsigned char> bmp(index >= 0 ? (size_t)ze.unc_size : 0);
+	ZRESULT zr = bmp.empty() ? ZR_NOTFOUND : UnzipItem(hz, index, &bmp[0], (unsigned int)bmp.size(), ZIP_MEMORY);
+	CloseZip(hz);
+	CHECK(zr == ZR_OK || zr == ZR_MORE);
+	if(bmp.size() < 54 || bmp[0] != 'B' || bmp[1] != 'M') return TSurface();
+	unsigned int off = bmp[10] | bmp[11] << 8 | bmp[12] << 16 | (unsigned int)bmp[13] << 24;
+	int w = bmp[18] | bmp[19] << 8 | bmp[20] << 16 | bmp[21] << 24;
+	int h = bmp[22] | bmp[23] << 8 | bmp[24] << 16 | bmp[25] << 24;
+	int bpp = bmp[28];
+	bool bottomup = h > 0;
+	if(h < 0) h = -h;
+	int stride = (w * (bpp / 8) + 3) & ~3;
+	CHECK(bpp == 24 || bpp == 32);
+	if(w <= 0 || (bpp != 24 && bpp != 32) || off + (size_t)stride * h > bmp.size()) return TSurface();
+	bits.resize((size_t)stride * h);
+	for(int y = 0; y < h; y++) memcpy(&bits[(size_t)y * stride], &bmp[off + (size_t)(bottomup ? h - 1 - y : y) * stride], stride);
+	return TSurface(w, h, stride, bpp, &bits[0]);
+}
+
+static void Fill(std::vector<unsigned char> &bits, unsigned int seed) {
+	TestRandom random(seed);
+	for(size_t i = 0; i < bits.size(); i++) bits[i] = (unsigned char)random.Next();
+}
+
+// CheckSpans: the spans cover every pixel that isn't transparent, once
+static void CheckSpans(const TSprite &spr) {
+	const TSurface &s = spr.Surface();
+	for(int y = 0; y < s.h; y++) {
+		std::vector<int> covered(s.w, 0);
+		int n; const TSpan *spans = spr.Spans(y, n);
+		for(int i = 0; i < n; i++)
+			for(int x = spans[i].x; x < spans[i].x + spans[i].len; x++) {
+				covered[x]++;
+				CHECK((s.Row(y)[x * 4 + 3] == 255) == spans[i].opaque);
+			}
+		for(int x = 0; x < s.w; x++) CHECK(covered[x] == (s.Row(y)[x * 4 + 3] != 0 ? 1 : 0));
+	}
+}
+
+// CheckBlits: SpanBlit == AlphaBlit, at places that go off every edge, and
+// clipped to rects that cut through the sprite
+static void CheckBlits(const TSprite &spr) {
+	const int w = 300, h = 200;
+	std::vector<unsigned char> a(w * h * 4), b(w * h * 4);
+	TSurface da(w, h, w * 4, 32, &a[0]), db(w, h, w * 4, 32, &b[0]);
+	TestRandom random(3);
+	for(int t = 0; t < 500; t++) {
+		Fill(a, t); b = a;
+		int x = (int)random.Below(w + spr.Width()) - spr.Width(), y = (int)random.Below(h + spr.Height()) - spr.Height();
+		TRect clip(0, 0, w, h);
+		if(t % 2) {
+			int l = random.Below(w), tp = random.Below(h);
+			clip = TRect(l, tp, l + random.Below(w - l + 1), tp + random.Below(h - tp + 1));
+		}
+		AlphaBlit(da, clip, x, y, spr.Surface());
+		SpanBlit(db, clip, x, y, spr);
+		CHECK(a == b);
+	}
+}
+
+static void CheckRows() {
+#if defined(CPU_X86)
+	if(!CpuHas(cfSSE2)) return;
+	TestRandom random(4);
+	for(int t = 0; t < 2000; t++) {
+		int n = random.Below(70);
+		std::vector<unsigned char> src(n * 4 + 4), d1(n * 4 + 4), d2;
+		Fill(src, t); Fill(d1, t + 10000);
+		// premultiplied: no channel above alpha, and plenty of 0 and 255 alphas
+		for(int i = 0; i < n; i++) {
+			unsigned char &al = src[i * 4 + 3];
+			if(i % 3 == 0) al = 255; else if(i % 3 == 1) al = (unsigned char)(al & 1 ? 0 : al);
+			for(int c = 0; c < 3; c++) if(src[i * 4 + c] > al) src[i * 4 + c] = al;
+		}
+		d2 = d1;
+		BlendRowScalar(&d1[0], &src[0], n);
+		BlendRowSSE2(&d2[0], &src[0], n);
+		CHECK(d1 == d2);
+	}
+#endif
+}
+
+// Bench: the sprite drawn all over a 1920x1080 frame, by its whole rect and
+// by its spans
+static void Bench(const TSprite &spr) {
+	const int w = 1920, h = 1080, reps = 20000;
+	std::vector<unsigned char> bits(w * h * 4);
+	Fill(bits, 5);
+	TSurface dst(w, h, w * 4, 32, &bits[0]);
+	const TSurface &s = spr.Surface();
+	long long opaque = 0, edge = 0;
+	for(int y = 0; y < s.h; y++) {
+		int n; const TSpan *spans = spr.Spans(y, n);
+		for(int i = 0; i < n; i++) (spans[i].opaque ? opaque : edge) += spans[i].len;
+	}
+	long long all = (long long)s.w * s.h;
+	printf("sprite.bmp is %dx%d: %.1f%% opaque, %.1f%% edge, %.1f%% transparent\n", s.w, s.h,
+		100.0 * opaque / all, 100.0 * edge / all, 100.0 * (all - opaque - edge) / all);
+	TRect clip(0, 0, w, h);
+	for(int pass = 0; pass < 2; pass++) {
+		double t0 = NowMs();
+		for(int i = 0; i < reps; i++) {
+			int x = (i * 97) % (w - s.w), y = (i * 61) % (h - s.h);
+			if(pass == 0) AlphaBlit(dst, clip, x, y, s);
+			else SpanBlit(dst, clip, x, y, spr);
+		}
+		double us = (NowMs() - t0) * 1000 / reps;
+		printf("  %-9s %6.2f us/blit\n", pass == 0 ? "AlphaBlit" : "SpanBlit", us);
+	}
+}
+
+int main(int argc, char **argv) {
+	std::vector<unsigned char> bits;
+	TSurface src = LoadSprite(bits);
+	CHECK(src.IsValid());
+	if(src.IsValid()) {
+		TSprite hard, soft;
+		hard.Load(src, 0, 1);
+		soft.Load(src, 0, 48); // as the saver has it
+		CheckSpans(hard);
+		CheckSpans(soft);
+		CheckBlits(hard);
+		CheckBlits(soft);
+		CheckRows();
+		if(Benching(argc, argv)) Bench(soft);
+	}
+	return CheckResult("SpriteTest");
+}
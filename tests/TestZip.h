@@ -0,0 +1,100 @@
+//Zips made up on the spot for tests
+#if !defined(TESTZIP_H_INCLUDED_)
+#define TESTZIP_H_INCLUDED_
+
+#include <string>
+#include <vector>
+
+// TTestZipEntry: one item, with its data as it's to be stored, i.e. already
+// deflated if method is 8. crc and size are those of the data unzipped.
+struct TTestZipEntry {
+	std::string name;
+	std::vector<unsigned char> data;
+	unsigned short method;
+	unsigned long crc;
+	unsigned int size;
+};
+
+inline void PutLE(std::vector<unsigned char> &z, unsigned long v, int bytes) {
+	for(int i = 0; i < bytes; i++) z.push_back((unsigned char)(v >> (8 * i)));
+}
+
+// DeflateStored: data as deflate stored blocks, which any inflater takes, for
+// deflated entries without a compressor
+inline std::vector<unsigned char> DeflateStored(const std::vector<unsigned char> &data) {
+	std::vector<unsigned char> z;
+	size_t pos = 0;
+	do {
+		size_t n = data.size() - pos < 65535 ? data.size() - pos : 65535;
+		z.push_back(pos + n == data.size() ? 1 : 0); // final?, and type 0
+		PutLE(z, (unsigned long)n, 2);
+		PutLE(z, (unsigned long)n ^ 0xffff, 2);
+		z.insert(z.end(), data.begin() + pos, data.begin() + pos + n);
+		pos += n;
+	} while(pos < data.size());
+	return z;
+}
+
+// MakeTestZip: a zip of the entries, under 4GB in all. With more than 65535
+// of them it has a zip64 end record too, for the count.
+inline std::vector<unsigned char> MakeTestZip(const std::vector<TTestZipEntry> &entries) {
+	std::vector<unsigned char> z, dir;
+	for(const TTestZipEntry &e : entries) {
+		unsigned long offset = (unsigned long)z.size();
+		for(int central = 0; central < 2; central++) {
+			std::vector<unsigned char> &h = central ? dir : z;
+			PutLE(h, central ? 0x02014b50 : 0x04034b50, 4);
+			if(central) PutLE(h, 20, 2);  // made by
+			PutLE(h, 20, 2);              // needed to extract
+			PutLE(h, 0, 2);               // flags
+			PutLE(h, e.method, 2);
+			PutLE(h, 0, 2);               // time
+			PutLE(h, 0x21, 2);            // date: 1 Jan 1980
+			PutLE(h, e.crc, 4);
+			PutLE(h, (unsigned long)e.data.size(), 4);
+			PutLE(h, e.size, 4);
+			PutLE(h, (unsigned long)e.name.size(), 2);
+			PutLE(h, 0, 2);               // extra
+			if(central) {
+				PutLE(h, 0, 2);           // comment
+				PutLE(h, 0, 2);           // disk
+				PutLE(h, 0, 2);           // internal attributes
+				PutLE(h, 0, 4);           // external attributes
+				PutLE(h, offset, 4);
+			}
+			h.insert(h.end(), e.name.begin(), e.name.end());
+		}
+		z.insert(z.end(), e.data.begin(), e.data.end());
+	}
+	unsigned long dirpos = (unsigned long)z.size();
+	z.insert(z.end(), dir.begin(), dir.end());
+	unsigned long count = (unsigned long)entries.size();
+	if(count > 0xFFFF) {
+		unsigned long end64 = (unsigned long)z.size();
+		PutLE(z, 0x06064b50, 4);
+		PutLE(z, 44, 4); PutLE(z, 0, 4);  // size of the rest of the record
+		PutLE(z, 45, 2);                  // made by
+		PutLE(z, 45, 2);                  // needed to extract
+		PutLE(z, 0, 4);                   // disk
+		PutLE(z, 0, 4);                   // disk with the directory
+		PutLE(z, count, 4); PutLE(z, 0, 4);
+		PutLE(z, count, 4); PutLE(z, 0, 4);
+		PutLE(z, (unsigned long)dir.size(), 4); PutLE(z, 0, 4);
+		PutLE(z, dirpos, 4); PutLE(z, 0, 4);
+		PutLE(z, 0x07064b50, 4);          // the locator
+		PutLE(z, 0, 4);
+		PutLE(z, end64, 4); PutLE(z, 0, 4);
+		PutLE(z, 1, 4);                   // disks
+		count = 0xFFFF;
+	}
+	PutLE(z, 0x06054b50, 4);
+	PutLE(z, 0, 4);                       // disks
+	PutLE(z, count, 2);
+	PutLE(z, count, 2);
+	PutLE(z, (unsigned long)dir.size(), 4);
+	PutLE(z, dirpos, 4);
+	PutLE(z, 0, 2);                       // comment
+	return z;
+}
+
+#endif //TESTZIP_H_INCLUDED_
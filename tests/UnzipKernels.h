@@ -0,0 +1,29 @@
+//What unzip.cpp exports for checking and timing
+#if !defined(UNZIPKERNELS_H_INCLUDED_)
+#define UNZIPKERNELS_H_INCLUDED_
+
+#include "Cpu.h"
+
+// unzip.cpp declares these in its own copy of zlib's headers, which
+// nothing else can include, so they're declared again here
+typedef unsigned long uLong;
+typedef unsigned int uInt;
+typedef unsigned char Byte;
+
+typedef uLong (*TChecksumKernel)(uLong sum, const Byte *buf, uInt len);
+
+uLong adler32(uLong adler, const Byte *buf, uInt len);
+uLong adler32_ref(uLong adler, const Byte *buf, uInt len);
+#if defined(CPU_X86)
+uLong adler32_ssse3(uLong adler, const Byte *buf, uInt len);
+uLong adler32_avx2(uLong adler, const Byte *buf, uInt len);
+#endif
+
+uLong ucrc32(uLong crc, const Byte *buf, uInt len);
+uLong ucrc32_ref(uLong crc, const Byte *buf, uInt len);
+uLong ucrc32_slice8(uLong crc, const Byte *buf, uInt len);
+#if defined(CPU_X86)
+uLong ucrc32_pclmul(uLong crc, const Byte *buf, uInt len);
+#endif
+
+#endif //UNZIPKERNELS_H_INCLUDED_
@@ -0,0 +1,414 @@
+// Checks UnzipItems against UnzipItem on a zip made up on the spot, and that a
+// zip read by name (mapped) reads the same as through a handle, and that
+// UnzipItem stops allocating once it has unzipped an item, and ZipStreams
+// read in any pieces, alongside each other and anything else. Times opening
+// a zip of 50000 items both ways, and reading all their headers.
+#include <windows.h>
+#include <vector>
+#include "Check.h"
+#include "unzip.h"
+#include "TestZip.h"
+#include "UnzipKernels.h"
+
+typedef std::vector<unsigned char> TBytes;
+
+// TItems: a zip of count items of random sizes, stored and deflated, and what's in them
+struct TItems {
+	std::vector<TTestZipEntry> entries;
+	std::vector<TBytes> data;
+	TBytes zip;
+};
+
+static void AddItem(TItems &items, const std::string &name, const TBytes &data, unsigned short method) {
+	unsigned long crc = ucrc32(0, data.empty() ? 0 : &data[0], (uInt)data.size());
+	items.entries.push_back({name, method == 8 ? DeflateStored(data) : data, method, crc, (unsigned int)data.size()});
+	items.data.push_back(data);
+}
+
+static TItems MakeItems(int count, unsigned int maxsize, unsigned int seed) {
+	TItems items;
+	TestRandom random(seed);
+	for(int i = 0; i < count; i++) {
+		TBytes data(random.Below(maxsize + 1));
+		for(size_t k = 0; k < data.size(); k++) data[k] = (unsigned char)random.Next();
+		// names like an asset pack's, in a few hundred folders
+		char name[64]; sprintf(name, "frames/anim%03d/frame_%05d.bmp", i / 128, i);
+		AddItem(items, name, data, i % 2 ? 8 : 0);
+	}
+	items.zip = MakeTestZip(items.entries);
+	return items;
+}
+
+static void SaveFile(const char *filename, const TBytes &bytes) {
+	if(FILE *f = fopen(filename, "wb")) {
+		fwrite(&bytes[0], 1, bytes.size(), f);
+		fclose(f);
+	}
+}
+
+// TOpened: a zip opened by name, and so mapped, or through a handle
+struct TOpened {
+	HANDLE h;
+	HZIP hz;
+	TOpened(const char *filename, bool byhandle) : h(0), hz(0) {
+		if(byhandle) {
+			h = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			hz = OpenZip(h, 0, ZIP_HANDLE);
+		}
+		else hz = OpenZip((void *)filename, 0, ZIP_FILENAME);
+	}
+	~TOpened() {
+		if(hz != 0) CloseZip(hz);
+		if(h != 0) CloseHandle(h);
+	}
+};
+
+// CheckMapped: the same items, read either way
+static void CheckMapped(const char *filename, const TItems &items) {
+	TOpened mapped(filename, false), handle(filename, true);
+	CHECK(mapped.hz != 0 && handle.hz != 0);
+	if(mapped.hz == 0 || handle.hz == 0) return;
+	ZIPENTRY a, b;
+	CHECK(GetZipItem(mapped.hz, -1, &a) == ZR_OK && GetZipItem(handle.hz, -1, &b) == ZR_OK);
+	CHECK(a.index == (int)items.entries.size() && b.index == a.index);
+	int n = a.index;
+	if(b.index != n || n <= 0) return;
+	TestRandom random(3);
+	for(int t = 0; t < 500; t++) {
+		int i = random.Below(n);
+		CHECK(GetZipItem(mapped.hz, i, &a) == ZR_OK && GetZipItem(handle.hz, i, &b) == ZR_OK);
+		CHECK(strcmp(a.name, items.entries[i].name.c_str()) == 0 && strcmp(b.name, a.name) == 0);
+		CHECK(a.unc_size == (long long)items.data[i].size() && b.unc_size == a.unc_size && b.comp_size == a.comp_size);
+		int index = -1;
+		CHECK(FindZipItem(handle.hz, a.name, false, &index, &b) == ZR_OK && index == i);
+		TBytes got(items.data[i].size() + 1);
+		ZRESULT zr = UnzipItem(handle.hz, i, &got[0], (unsigned int)got.size(), ZIP_MEMORY);
+		got.pop_back();
+		CHECK((zr == ZR_OK || zr == ZR_MORE) && got == items.data[i]);
+		zr = UnzipItem(mapped.hz, i, &got[0], (unsigned int)got.size(), ZIP_MEMORY);
+		CHECK((zr == ZR_OK || zr == ZR_MORE) && got == items.data[i]);
+	}
+}
+
+// CheckHeaders: every item's header, in order, which is how the central
+// directory is read, and then each local header, which unzipping checks
+static void CheckHeaders(const TItems &items) {
+	HZIP hz = OpenZip((void *)&items.zip[0], (unsigned int)items.zip.size(), ZIP_MEMORY);
+	CHECK(hz != 0);
+	if(hz == 0) return;
+	int n = (int)items.entries.size();
+	unsigned char buf[100];
+	for(int i = 0; i < n; i++) {
+		ZIPENTRY ze;
+		CHECK(GetZipItem(hz, i, &ze) == ZR_OK && ze.index == i && strcmp(ze.name, items.entries[i].name.c_str()) == 0);
+		CHECK(ze.unc_size == (long long)items.data[i].size() && ze.comp_size == (long long)items.entries[i].data.size());
+		ZRESULT zr = UnzipItem(hz, i, buf, sizeof(buf), ZIP_MEMORY);
+		if(zr == ZR_MORE) zr = UnzipItem(hz, i, buf, sizeof(buf), ZIP_MEMORY);
+		CHECK(zr == ZR_OK && std::equal(items.data[i].begin(), items.data[i].end(), buf));
+	}
+	CloseZip(hz);
+}
+
+// BenchHeaders: reading every item's central header, finding items by name,
+// and unzipping every item, which is mostly reading its local header
+static void BenchHeaders(const char *filename, const TItems &items) {
+	static const char *how[] = {"memory", "mapped", "handle"};
+	int n = (int)items.entries.size();
+	for(int mode = 0; mode < 3; mode++) {
+		TOpened opened(filename, mode == 2);
+		HZIP hz = mode == 0 ? OpenZip((void *)&items.zip[0], (unsigned int)items.zip.size(), ZIP_MEMORY) : opened.hz;
+		ZIPENTRY ze;
+		long long sum = 0;
+		double t0 = NowMs();
+		for(int i = 0; i < n; i++) {
+			GetZipItem(hz, i, &ze);
+			sum += ze.unc_size;
+		}
+		double t1 = NowMs();
+		TestRandom random(4);
+		for(int t = 0; t < 1000; t++) {
+			int index;
+			FindZipItem(hz, items.entries[random.Below(n)].name.c_str(), true, &index, &ze);
+			sum += index;
+		}
+		double t2 = NowMs();
+		unsigned char buf[100];
+		for(int i = 0; i < n; i++)
+			while(UnzipItem(hz, i, buf, sizeof(buf), ZIP_MEMORY) == ZR_MORE) {}
+		double t3 = NowMs();
+		if(mode == 0) CloseZip(hz);
+		printf("  %-8s GetZipItem %6.0f ns/item  FindZipItem %6.0f ns  UnzipItem %6.0f ns/item (%lld)\n",
+			how[mode], (t1 - t0) * 1e6 / n, (t2 - t1) * 1e6 / 1000, (t3 - t2) * 1e6 / n, sum);
+	}
+}
+
+// BenchOpen: opening and indexing the zip, the best of a few goes
+static void BenchOpen(const char *filename, const TItems &items) {
+	for(int byhandle = 0; byhandle < 2; byhandle++) {
+		double best = 1e30;
+		for(int rep = 0; rep < 5; rep++) {
+			double t0 = NowMs();
+			TOpened zip(filename, byhandle != 0);
+			ZIPENTRY ze;
+			GetZipItem(zip.hz, -1, &ze);
+			double ms = NowMs() - t0;
+			if(ms < best) best = ms;
+			CHECK(ze.index == (int)items.entries.size());
+		}
+		printf("  %-8s %zu items: open+index %8.2f ms\n", byhandle ? "handle" : "mapped", items.entries.size(), best);
+	}
+}
+
+static void CheckUnzipItems() {
+	TItems items = MakeItems(300, 100000, 1);
+	int good = (int)items.entries.size();
+	AddItem(items, "empty", TBytes(), 8);
+	good++;
+	// bzip2, which isn't supported, and a bad crc
+	AddItem(items, "bzip2", TBytes(1000, 'b'), 12);
+	AddItem(items, "badcrc", TBytes(1000, 'c'), 8);
+	items.entries.back().crc ^= 1;
+	items.zip = MakeTestZip(items.entries);
+	HZIP hz = OpenZip(&items.zip[0], (unsigned int)items.zip.size(), ZIP_MEMORY);
+	CHECK(hz != 0);
+	if(hz == 0) return;
+	int n = (int)items.entries.size();
+	for(unsigned int threads : {1u, 4u, 0u}) {
+		// backwards, so that the order isn't the zip's
+		std::vector<int> indices(n);
+		std::vector<TBytes> out(n);
+		std::vector<void *> dsts(n);
+		std::vector<unsigned int> lens(n);
+		std::vector<ZRESULT> results(n, 0xdead);
+		for(int k = 0; k < n; k++) {
+			indices[k] = n - 1 - k;
+			out[k].assign(items.data[indices[k]].size() + 1, 0xCD);
+			dsts[k] = &out[k][0];
+			lens[k] = (unsigned int)items.data[indices[k]].size();
+		}
+		lens[0] = 0; // badcrc's, when a buffer's too small
+		ZRESULT zr = UnzipItems(hz, n, &indices[0], &dsts[0], &lens[0], &results[0], threads);
+		CHECK(zr == ZR_MEMSIZE);
+		CHECK(results[0] == ZR_MEMSIZE && out[0][0] == 0xCD);
+		CHECK(results[1] == ZR_CORRUPT); // bzip2
+		for(int k = 2; k < n; k++) {
+			const TBytes &want = items.data[indices[k]];
+			CHECK(results[k] == ZR_OK && std::equal(want.begin(), want.end(), out[k].begin()) && out[k][want.size()] == 0xCD);
+		}
+		lens[0] = 1000;
+		zr = UnzipItems(hz, n, &indices[0], &dsts[0], &lens[0], &results[0], threads);
+		CHECK(zr == ZR_CORRUPT && results[0] == ZR_CORRUPT && results[1] == ZR_CORRUPT);
+		CHECK(UnzipItems(hz, n - 2, &indices[2], &dsts[2], &lens[2], &results[2], threads) == ZR_OK);
+	}
+	// and they agree with UnzipItem
+	for(int i = 0; i < good; i++) {
+		TBytes got(items.data[i].size() + 1);
+		ZRESULT zr = UnzipItem(hz, i, &got[0], (unsigned int)got.size(), ZIP_MEMORY);
+		got.pop_back();
+		CHECK((zr == ZR_OK || zr == ZR_MORE) && got == items.data[i]);
+	}
+	TBytes got(1000);
+	CHECK(UnzipItem(hz, good, &got[0], (unsigned int)got.size(), ZIP_MEMORY) != ZR_OK);
+	CloseZip(hz);
+	// a zip that's read through a handle can't be shared out
+	const char *filename = "UnzipTest.zip";
+	SaveFile(filename, items.zip);
+	HANDLE h = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	hz = OpenZip(h, 0, ZIP_HANDLE);
+	int index = 0; void *dst = &got[0]; unsigned int len = 1000; ZRESULT result;
+	CHECK(hz != 0 && UnzipItems(hz, 1, &index, &dst, &len, &result, 1) == ZR_NOTMMAP);
+	CloseZip(hz);
+	CloseHandle(h);
+	remove(filename);
+}
+
+// CheckAllocCounts: once the first pass over the items has allocated the
+// read buffer and decoder, a second pass allocates nothing, and every item
+// in it is opened with the state the one before left
+static void CheckAllocCounts(const char *filename, const TItems &items) {
+	int n = (int)items.entries.size();
+	for(int mode = 0; mode < 2; mode++) {
+		TOpened opened(filename, true);
+		HZIP hz = mode == 0 ? OpenZip((void *)&items.zip[0], (unsigned int)items.zip.size(), ZIP_MEMORY) : opened.hz;
+		CHECK(hz != 0);
+		if(hz == 0) continue;
+		unsigned long allocs[3], reuses[3];
+		CHECK(GetZipAllocCounts(hz, &allocs[0], &reuses[0]) == ZR_OK && allocs[0] == 0 && reuses[0] == 0);
+		for(int pass = 1; pass <= 2; pass++) {
+			for(int i = 0; i < n; i++) {
+				TBytes got(items.data[i].size() + 1);
+				ZRESULT zr;
+				while((zr = UnzipItem(hz, i, &got[0], (unsigned int)got.size(), ZIP_MEMORY)) == ZR_MORE) {}
+				got.pop_back();
+				CHECK(zr == ZR_OK && got == items.data[i]);
+			}
+			CHECK(GetZipAllocCounts(hz, &allocs[pass], &reuses[pass]) == ZR_OK);
+		}
+		CHECK(allocs[1] > 0 && allocs[2] == allocs[1]);
+		CHECK(reuses[1] == (unsigned long)n - 1 && reuses[2] == reuses[1] + n);
+		if(mode == 0) CloseZip(hz);
+	}
+}
+
+// CheckItemData: GetZipItemData on a zip in memory hands out a pointer into
+// the caller's own buffer; mapped, one into the mapping. A flipped byte is
+// only noticed when asked to check, and deflated items can't be had this way.
+static void CheckItemData() {
+	TItems items;
+	TBytes data(5000);
+	TestRandom random(6);
+	for(size_t k = 0; k < data.size(); k++) data[k] = (unsigned char)random.Next();
+	AddItem(items, "stored", data, 0);
+	AddItem(items, "deflated", data, 8);
+	items.zip = MakeTestZip(items.entries);
+	TBytes zip = items.zip;
+	HZIP hz = OpenZip(&zip[0], (unsigned int)zip.size(), ZIP_MEMORY);
+	CHECK(hz != 0);
+	if(hz == 0) return;
+	const void *p = 0; unsigned int len = 0;
+	CHECK(GetZipItemData(hz, 0, &p, &len, true) == ZR_OK);
+	const unsigned char *q = (const unsigned char *)p;
+	CHECK(q >= &zip[0] && q + len <= &zip[0] + zip.size());
+	CHECK(len == data.size() && memcmp(p, &data[0], len) == 0);
+	CHECK(GetZipItemData(hz, 1, &p, &len, false) == ZR_NOTSTORED);
+	size_t offset = q - &zip[0];
+	CloseZip(hz);
+	// the same zip with one byte of the stored item's flipped
+	TBytes bad = items.zip;
+	bad[offset + 100] ^= 0x40;
+	const char *filename = "UnzipTestData.zip";
+	for(int mapped = 0; mapped < 2; mapped++)
+		for(int flipped = 0; flipped < 2; flipped++) {
+			TBytes copy = flipped ? bad : items.zip;
+			if(mapped) SaveFile(filename, copy);
+			hz = mapped ? OpenZip((void *)filename, 0, ZIP_FILENAME) : OpenZip(&copy[0], (unsigned int)copy.size(), ZIP_MEMORY);
+			CHECK(hz != 0);
+			if(hz == 0) continue;
+			p = 0; len = 0;
+			CHECK(GetZipItemData(hz, 0, &p, &len, true) == (flipped ? ZR_CORRUPT : ZR_OK));
+			CHECK(GetZipItemData(hz, 0, &p, &len, false) == ZR_OK && len == data.size());
+			CHECK(memcmp(p, &copy[offset], len) == 0);
+			if(!mapped) CHECK(p == &copy[offset]);
+			CHECK(GetZipItemData(hz, 1, &p, &len, true) == ZR_NOTSTORED);
+			CloseZip(hz);
+		}
+	remove(filename);
+}
+
+// ReadSome: one ReadZipStream of len bytes onto the end of got, checking
+// that it only comes up short at the end, and that the progress adds up
+static ZRESULT ReadSome(HZIPSTREAM hs, unsigned int len, TBytes &got, const TBytes &want, long long compsize) {
+	size_t had = got.size();
+	got.resize(had + len + 1);
+	unsigned int n = 12345;
+	ZRESULT zr = ReadZipStream(hs, &got[had], len, &n);
+	got.resize(had + (n <= len ? n : 0));
+	if(zr == ZR_MORE || zr == ZR_OK) {
+		size_t left = want.size() > had ? want.size() - had : 0;
+		CHECK(n == (len < left ? len : left));
+		CHECK((zr == ZR_OK) == (got.size() == want.size()));
+	}
+	unsigned long long produced, consumed;
+	CHECK(GetZipStreamProgress(hs, &produced, &consumed) == ZR_OK);
+	CHECK(produced == got.size() && consumed <= (unsigned long long)compsize);
+	if(zr == ZR_OK) CHECK(consumed == (unsigned long long)compsize);
+	return zr;
+}
+
+// CheckStreams: ZipStreams over a handle with tiny and odd buffer sizes, and
+// mapped, read in uneven pieces; two at once, with the zip used in between;
+// and items that are bad, which stay failed
+static void CheckStreams(const char *filename, const TItems &items) {
+	int n = (int)items.entries.size() - 2; // then badcrc and cut
+	for(int byhandle = 0; byhandle < 2; byhandle++) {
+		TOpened opened(filename, byhandle != 0);
+		HZIP hz = opened.hz;
+		CHECK(hz != 0);
+		if(hz == 0) continue;
+		TestRandom random(8);
+		for(unsigned int bufsize : {1u, 7u, 5000u, 0u}) {
+			for(int i = 0; i < n; i++) {
+				HZIPSTREAM hs = OpenZipStream(hz, i, bufsize);
+				CHECK(hs != 0);
+				if(hs == 0) continue;
+				TBytes got;
+				ZRESULT zr;
+				do zr = ReadSome(hs, random.Below(3000), got, items.data[i], (long long)items.entries[i].data.size());
+				while(zr == ZR_MORE);
+				CHECK(zr == ZR_OK && got == items.data[i]);
+				unsigned int none = 1;
+				CHECK(ReadZipStream(hs, &got[0], 1, &none) == ZR_OK && none == 0);
+				CloseZipStream(hs);
+			}
+		}
+		// two at once, with UnzipItem and GetZipItem on the same zip in between
+		int a = n - 1, b = n - 2, c = n / 2;
+		HZIPSTREAM ha = OpenZipStream(hz, a, 100), hb = OpenZipStream(hz, b, 0);
+		CHECK(ha != 0 && hb != 0);
+		if(ha != 0 && hb != 0) {
+			TBytes gota, gotb;
+			ZRESULT za = ZR_MORE, zb = ZR_MORE;
+			while(za == ZR_MORE || zb == ZR_MORE) {
+				if(za == ZR_MORE) za = ReadSome(ha, 777, gota, items.data[a], (long long)items.entries[a].data.size());
+				TBytes got(items.data[c].size() + 1);
+				ZRESULT zr;
+				while((zr = UnzipItem(hz, c, &got[0], (unsigned int)got.size(), ZIP_MEMORY)) == ZR_MORE) {}
+				got.pop_back();
+				CHECK(zr == ZR_OK && got == items.data[c]);
+				ZIPENTRY ze;
+				CHECK(GetZipItem(hz, b, &ze) == ZR_OK && ze.unc_size == (long long)items.data[b].size());
+				if(zb == ZR_MORE) zb = ReadSome(hb, 1234, gotb, items.data[b], (long long)items.entries[b].data.size());
+			}
+			CHECK(za == ZR_OK && gota == items.data[a]);
+			CHECK(zb == ZR_OK && gotb == items.data[b]);
+		}
+		if(ha != 0) CloseZipStream(ha);
+		if(hb != 0) CloseZipStream(hb);
+		// a bad crc is only known at the end; a cut stream when it runs out
+		for(int i = n; i < n + 2; i++) {
+			HZIPSTREAM hs = OpenZipStream(hz, i, 7);
+			CHECK(hs != 0);
+			if(hs == 0) continue;
+			TBytes got;
+			ZRESULT zr;
+			do zr = ReadSome(hs, 100, got, items.data[i], (long long)items.entries[i].data.size());
+			while(zr == ZR_MORE);
+			CHECK(i == n ? zr == ZR_CORRUPT && got == items.data[i] : (zr == ZR_CORRUPT || zr == ZR_FLATE) && got.size() < items.data[i].size());
+			unsigned int none = 1;
+			TBytes buf(100);
+			CHECK(ReadZipStream(hs, &buf[0], 100, &none) == zr && none == 0);
+			CloseZipStream(hs);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	bool bench = Benching(argc, argv);
+	CheckUnzipItems();
+	CheckItemData();
+	TItems some = MakeItems(40, 20000, 5);
+	const char *somename = "UnzipTestSome.zip";
+	SaveFile(somename, some.zip);
+	CheckAllocCounts(somename, some);
+	AddItem(some, "badcrc", TBytes(3000, 'c'), 0);
+	some.entries.back().crc ^= 1;
+	AddItem(some, "cut", TBytes(3000, 'd'), 8);
+	some.entries.back().data.resize(1500); // the deflated data stops halfway
+	some.zip = MakeTestZip(some.entries);
+	SaveFile(somename, some.zip);
+	CheckStreams(somename, some);
+	remove(somename);
+	// lots of little items, as in an asset pack
+	TItems many = MakeItems(50000, 64, 2);
+	const char *filename = "UnzipTest50k.zip";
+	SaveFile(filename, many.zip);
+	CheckMapped(filename, many);
+	CheckHeaders(many);
+	if(bench) {
+		printf("50000 items:\n");
+		BenchOpen(filename, many);
+		BenchHeaders(filename, many);
+	}
+	remove(filename);
+	return CheckResult("UnzipTest");
+}
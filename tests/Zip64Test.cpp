@@ -0,0 +1,319 @@
+// Checks zip64 archives: one of 70000 items, and a sparse one over 8GB whose
+// stored and deflated items are each over 4GB, which it streams. It makes
+// them itself, in the current directory, and deletes them afterwards.
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "unzip.h"
+#include "TestZip.h"
+#include "UnzipKernels.h"
+
+typedef std::vector<unsigned char> TBytes;
+
+static const unsigned long long BIGSTORED = 0x108000000ull;   // 4.125GB
+static const unsigned long long BIGDEFLATED = 0x104000000ull; // 4.0625GB
+
+// TBitWriter: deflate's bits, first in the low bits of each byte
+class TBitWriter {
+public:
+	TBytes out;
+	TBitWriter() : bits(0), nbits(0) {}
+	void Put(unsigned int v, int n) {
+		bits |= (unsigned long long)v << nbits;
+		nbits += n;
+		while(nbits >= 8) { out.push_back((unsigned char)bits); bits >>= 8; nbits -= 8; }
+	}
+	// PutCode: a Huffman code, which goes first bit first
+	void PutCode(unsigned int code, int n) {
+		unsigned int r = 0;
+		for(int i = 0; i < n; i++) r |= ((code >> i) & 1) << (n - 1 - i);
+		Put(r, n);
+	}
+	void Flush() { if(nbits > 0) Put(0, 8 - nbits); }
+
+private:
+	unsigned long long bits;
+	int nbits;
+};
+
+// DeflateZeros: n zeros as one fixed Huffman block: a literal, matches of 258
+// back 1 for as long as they fit, and literals for the rest. No compressor needed.
+static TBytes DeflateZeros(unsigned long long n) {
+	TBitWriter w;
+	w.Put(1, 1); w.Put(1, 2); // the final block, fixed codes
+	unsigned long long left = n;
+	if(left > 0) { w.PutCode(0x30, 8); left--; }    // literal 0
+	for(; left >= 258; left -= 258) {
+		w.PutCode(0xC5, 8);                          // length 258
+		w.PutCode(0, 5);                             // distance 1
+	}
+	for(; left > 0; left--) w.PutCode(0x30, 8);
+	w.PutCode(0, 7);                                 // end of block
+	w.Flush();
+	return w.out;
+}
+
+static unsigned long CrcZeros(unsigned long long n) {
+	TBytes zeros(1 << 20, 0);
+	unsigned long crc = 0;
+	for(; n > 0; n -= n < zeros.size() ? n : zeros.size())
+		crc = ucrc32(crc, &zeros[0], (uInt)(n < zeros.size() ? n : zeros.size()));
+	return crc;
+}
+
+// TBigZip: writes a zip a file at a time, with zip64 fields wherever a size
+// or offset needs them. Stored zeros are seeked over, which leaves a hole
+// in the file on systems that do sparse files.
+class TBigZip {
+public:
+	explicit TBigZip(const char *filename) : pos(0), count(0) {
+		h = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+	bool Ok() const { return h != INVALID_HANDLE_VALUE; }
+	void Add(const std::string &name, unsigned short method, unsigned long crc, unsigned long long size, const TBytes &data, unsigned long long zeros) {
+		unsigned long long csize = data.size() + zeros, offset = pos;
+		bool big = size >= 0xFFFFFFFF || csize >= 0xFFFFFFFF;
+		// the local header has both sizes in its extra field, or neither
+		TBytes local;
+		PutLE(local, 0x04034b50, 4);
+		PutLE(local, big ? 45 : 20, 2);
+		PutLE(local, 0, 2);
+		PutLE(local, method, 2);
+		PutLE(local, 0, 2); PutLE(local, 0x21, 2);
+		PutLE(local, crc, 4);
+		PutLE(local, big ? 0xFFFFFFFF : (unsigned long)csize, 4);
+		PutLE(local, big ? 0xFFFFFFFF : (unsigned long)size, 4);
+		PutLE(local, (unsigned long)name.size(), 2);
+		PutLE(local, big ? 20 : 0, 2);
+		local.insert(local.end(), name.begin(), name.end());
+		if(big) {
+			PutLE(local, 1, 2); PutLE(local, 16, 2);
+			Put64(local, size); Put64(local, csize);
+		}
+		Write(local);
+		Write(data);
+		if(zeros > 0) {
+			LARGE_INTEGER skip; skip.QuadPart = (long long)zeros;
+			SetFilePointerEx(h, skip, NULL, FILE_CURRENT);
+			pos += zeros;
+		}
+		// the central one has just those that don't fit
+		TBytes extra;
+		if(size >= 0xFFFFFFFF) Put64(extra, size);
+		if(csize >= 0xFFFFFFFF) Put64(extra, csize);
+		if(offset >= 0xFFFFFFFF) Put64(extra, offset);
+		PutLE(dir, 0x02014b50, 4);
+		PutLE(dir, 45, 2); PutLE(dir, extra.empty() ? 20 : 45, 2);
+		PutLE(dir, 0, 2);
+		PutLE(dir, method, 2);
+		PutLE(dir, 0, 2); PutLE(dir, 0x21, 2);
+		PutLE(dir, crc, 4);
+		PutLE(dir, csize >= 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned long)csize, 4);
+		PutLE(dir, size >= 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned long)size, 4);
+		PutLE(dir, (unsigned long)name.size(), 2);
+		PutLE(dir, extra.empty() ? 0 : (unsigned long)extra.size() + 4, 2);
+		PutLE(dir, 0, 2); PutLE(dir, 0, 2); PutLE(dir, 0, 2); PutLE(dir, 0, 4);
+		PutLE(dir, offset >= 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned long)offset, 4);
+		dir.insert(dir.end(), name.begin(), name.end());
+		if(!extra.empty()) {
+			PutLE(dir, 1, 2); PutLE(dir, (unsigned long)extra.size(), 2);
+			dir.insert(dir.end(), extra.begin(), extra.end());
+		}
+		count++;
+	}
+	// Close: the central directory, and the zip64 end records, which this
+	// always needs for the directory's offset
+	void Close() {
+		unsigned long long dirpos = pos;
+		Write(dir);
+		TBytes end;
+		unsigned long long end64 = pos;
+		PutLE(end, 0x06064b50, 4);
+		Put64(end, 44);
+		PutLE(end, 45, 2); PutLE(end, 45, 2);
+		PutLE(end, 0, 4); PutLE(end, 0, 4);
+		Put64(end, count); Put64(end, count);
+		Put64(end, dir.size()); Put64(end, dirpos);
+		PutLE(end, 0x07064b50, 4);
+		PutLE(end, 0, 4); Put64(end, end64); PutLE(end, 1, 4);
+		PutLE(end, 0x06054b50, 4);
+		PutLE(end, 0, 4);
+		PutLE(end, count > 0xFFFF ? 0xFFFF : count, 2); PutLE(end, count > 0xFFFF ? 0xFFFF : count, 2);
+		PutLE(end, 0xFFFFFFFF, 4); PutLE(end, 0xFFFFFFFF, 4);
+		PutLE(end, 0, 2);
+		Write(end);
+		CloseHandle(h);
+	}
+
+private:
+	static void Put64(TBytes &b, unsigned long long v) { PutLE(b, (unsigned long)v, 4); PutLE(b, (unsigned long)(v >> 32), 4); }
+	void Write(const TBytes &b) {
+		for(size_t done = 0; done < b.size(); ) {
+			DWORD n = b.size() - done < (1u << 30) ? (DWORD)(b.size() - done) : (1u << 30), put = 0;
+			if(!WriteFile(h, &b[done], n, &put, NULL) || put == 0) break;
+			done += put;
+		}
+		pos += b.size();
+	}
+	HANDLE h;
+	unsigned long long pos;
+	unsigned long count;
+	TBytes dir;
+};
+
+static const char TAIL[] = "hello from past 8GB\n";
+static size_t bigdeflated; // big.deflated's compressed size
+
+static void MakeBig(const char *filename) {
+	TBigZip zip(filename);
+	CHECK(zip.Ok());
+	if(!zip.Ok()) return;
+	zip.Add("big.stored", 0, CrcZeros(BIGSTORED), BIGSTORED, TBytes(), BIGSTORED);
+	TBytes deflated = DeflateZeros(BIGDEFLATED);
+	bigdeflated = deflated.size();
+	zip.Add("big.deflated", 8, CrcZeros(BIGDEFLATED), BIGDEFLATED, deflated, 0);
+	// a small one, whose offset is all that needs zip64
+	TBytes tail(TAIL, TAIL + sizeof(TAIL) - 1);
+	zip.Add("tail.txt", 0, ucrc32(0, &tail[0], (uInt)tail.size()), tail.size(), tail, 0);
+	zip.Close();
+}
+
+static HZIP Open(const char *filename, bool byhandle, HANDLE &h) {
+	h = 0;
+	if(!byhandle) return OpenZip((void *)filename, 0, ZIP_FILENAME);
+	h = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	return OpenZip(h, 0, ZIP_HANDLE);
+}
+
+// StreamItem: reads a whole item through a ZipStream, which checks its crc
+static void StreamItem(HZIP hz, int index, bool bench) {
+	ZIPENTRY ze;
+	GetZipItem(hz, index, &ze);
+	double t0 = NowMs();
+	HZIPSTREAM hs = OpenZipStream(hz, index, 1 << 20);
+	CHECK(hs != 0);
+	if(hs == 0) return;
+	TBytes buf(4 << 20);
+	unsigned long long total = 0;
+	unsigned int n;
+	bool zeros = true;
+	ZRESULT zr;
+	do {
+		zr = ReadZipStream(hs, &buf[0], (unsigned int)buf.size(), &n);
+		total += n;
+		if(n > 0 && (buf[0] != 0 || buf[n - 1] != 0)) zeros = false;
+	} while(zr == ZR_MORE);
+	unsigned long long produced, consumed;
+	CHECK(GetZipStreamProgress(hs, &produced, &consumed) == ZR_OK);
+	CloseZipStream(hs);
+	CHECK(zr == ZR_OK && zeros);
+	CHECK(total == (unsigned long long)ze.unc_size && produced == total && consumed == (unsigned long long)ze.comp_size);
+	if(bench) printf("  %-12s %11llu bytes %8.0f ms %6.2f GB/s\n", ze.name, total, NowMs() - t0, total / (NowMs() - t0) / 1e6);
+}
+
+static void CheckBig(const char *filename, bool byhandle, bool bench) {
+	HANDLE h;
+	HZIP hz = Open(filename, byhandle, h);
+	CHECK(hz != 0);
+	if(hz == 0) return;
+	ZIPENTRY ze;
+	CHECK(GetZipItem(hz, -1, &ze) == ZR_OK && ze.index == 3);
+	CHECK(GetZipItem(hz, 0, &ze) == ZR_OK && ze.unc_size == (long long)BIGSTORED && ze.comp_size == (long long)BIGSTORED);
+	CHECK(GetZipItem(hz, 1, &ze) == ZR_OK && ze.unc_size == (long long)BIGDEFLATED && ze.comp_size == (long long)bigdeflated);
+	int index = -1;
+	CHECK(FindZipItem(hz, "tail.txt", false, &index, &ze) == ZR_OK && index == 2 && ze.unc_size == (long long)sizeof(TAIL) - 1);
+	char tail[sizeof(TAIL)] = {0};
+	ZRESULT zr;
+	while((zr = UnzipItem(hz, 2, tail, sizeof(TAIL) - 1, ZIP_MEMORY)) == ZR_MORE) {}
+	CHECK(zr == ZR_OK && strcmp(tail, TAIL) == 0);
+	// too big for len to say
+	const void *data; unsigned int len;
+	CHECK(GetZipItemData(hz, 0, &data, &len, false) == (byhandle ? ZR_NOTMMAP : ZR_MEMSIZE));
+	for(int i = 0; i < 2; i++) StreamItem(hz, i, bench);
+	CloseZip(hz);
+	if(h != 0) CloseHandle(h);
+}
+
+static void CheckMany(const TBytes &zip, int count, bool byhandle) {
+	const char *filename = "Zip64Test_many.zip";
+	if(FILE *f = fopen(filename, "wb")) {
+		fwrite(&zip[0], 1, zip.size(), f);
+		fclose(f);
+	}
+	HANDLE h;
+	HZIP hz = Open(filename, byhandle, h);
+	CHECK(hz != 0);
+	if(hz != 0) {
+		ZIPENTRY ze;
+		CHECK(GetZipItem(hz, -1, &ze) == ZR_OK && ze.index == count);
+		for(int i : {0, 1, 65534, 65535, 65536, count - 1}) {
+			char name[32]; sprintf(name, "d%02d/f%05d.txt", i % 50, i);
+			int index = -1;
+			CHECK(FindZipItem(hz, name, false, &index, &ze) == ZR_OK && index == i);
+			char got[32] = {0}; ZRESULT zr;
+			while((zr = UnzipItem(hz, i, got, sizeof(got) - 1, ZIP_MEMORY)) == ZR_MORE) {}
+			CHECK(zr == ZR_OK && strcmp(got, name) == 0);
+		}
+		CloseZip(hz);
+	}
+	if(h != 0) CloseHandle(h);
+	remove(filename);
+}
+
+// CheckLyingCount: an end record claiming more items than its central dir can
+// hold is corrupt, rather than something to allocate for
+static void CheckLyingCount() {
+	for(int zip64 = 0; zip64 < 2; zip64++) {
+		TBytes z(4, 0); // as the directory, which is empty
+		if(zip64) {
+			PutLE(z, 0x06064b50, 4);
+			PutLE(z, 44, 4); PutLE(z, 0, 4);
+			PutLE(z, 45, 2); PutLE(z, 45, 2);
+			PutLE(z, 0, 4); PutLE(z, 0, 4);
+			PutLE(z, 0x7FFFFFFF, 4); PutLE(z, 0, 4);
+			PutLE(z, 0x7FFFFFFF, 4); PutLE(z, 0, 4);
+			PutLE(z, 0, 4); PutLE(z, 0, 4);   // the directory's size
+			PutLE(z, 4, 4); PutLE(z, 0, 4);   // and where it is
+			PutLE(z, 0x07064b50, 4);
+			PutLE(z, 0, 4); PutLE(z, 4, 4); PutLE(z, 0, 4); PutLE(z, 1, 4);
+		}
+		PutLE(z, 0x06054b50, 4);
+		PutLE(z, 0, 4);
+		PutLE(z, 0xFFFF, 2); PutLE(z, 0xFFFF, 2);
+		PutLE(z, zip64 ? 0xFFFFFFFF : 0, 4); PutLE(z, zip64 ? 0xFFFFFFFF : 4, 4);
+		PutLE(z, 0, 2);
+		HZIP hz = OpenZip(&z[0], (unsigned int)z.size(), ZIP_MEMORY);
+		CHECK(hz == 0);
+		if(hz != 0) CloseZip(hz);
+	}
+}
+
+int main(int argc, char **argv) {
+	bool bench = Benching(argc, argv);
+	CheckLyingCount();
+	// more items than the ordinary end record can count, each holding its own name
+	const int count = 70000;
+	std::vector<TTestZipEntry> entries;
+	for(int i = 0; i < count; i++) {
+		char name[32]; sprintf(name, "d%02d/f%05d.txt", i % 50, i);
+		TBytes data(name, name + strlen(name));
+		unsigned long crc = ucrc32(0, &data[0], (uInt)data.size());
+		entries.push_back({name, i % 2 ? DeflateStored(data) : data, (unsigned short)(i % 2 ? 8 : 0), crc, (unsigned int)data.size()});
+	}
+	TBytes many = MakeTestZip(entries);
+	CheckMany(many, count, false);
+	CheckMany(many, count, true);
+	// and with something in front of it, as a self-extractor has
+	TBytes sfx(5000, 'x');
+	sfx.insert(sfx.end(), many.begin(), many.end());
+	CheckMany(sfx, count, false);
+	CheckMany(sfx, count, true);
+	const char *filename = "Zip64Test_big.zip";
+	MakeBig(filename);
+	if(bench) printf("streaming items over 4GB:\n");
+	CheckBig(filename, false, bench);
+	CheckBig(filename, true, bench);
+	remove(filename);
+	return CheckResult("Zip64Test");
+}
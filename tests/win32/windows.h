@@ -0,0 +1,143 @@
+//Win32 for the tests
+#if !defined(WIN32_WINDOWS_H_INCLUDED_)
+#define WIN32_WINDOWS_H_INCLUDED_
+
+// Just as much of the Win32 API as unzip.cpp uses, done with POSIX calls, so
+// that the tests can build it on Linux. Only the tests include this: the saver
+// is built against the real thing. A HANDLE is a file descriptor plus one, so
+// that 0 isn't a valid one; timestamps aren't kept.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <mutex>
+
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef uint16_t WORD;
+typedef unsigned char BYTE;
+typedef int32_t LONG;
+typedef unsigned int UINT;
+typedef char TCHAR;
+typedef void *HANDLE;
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define DECLARE_HANDLE(n) struct n##__ { int unused; }; typedef struct n##__ *n
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define CopyMemory(d, s, n) memcpy((d), (s), (n))
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_READONLY 0x1
+#define FILE_ATTRIBUTE_HIDDEN 0x2
+#define FILE_ATTRIBUTE_SYSTEM 0x4
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define FILE_ATTRIBUTE_ARCHIVE 0x20
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_TYPE_DISK 1
+#define FILE_TYPE_PIPE 3
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define INVALID_SET_FILE_POINTER ((DWORD)-1)
+#define DUPLICATE_SAME_ACCESS 2
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+
+typedef struct { DWORD dwLowDateTime, dwHighDateTime; } FILETIME;
+typedef struct { WORD wYear, wMonth, wDayOfWeek, wDay, wHour, wMinute, wSecond, wMilliseconds; } SYSTEMTIME;
+typedef union { struct { DWORD LowPart; LONG HighPart; } u; long long QuadPart; } LARGE_INTEGER;
+
+inline HANDLE HandleOf(int fd) { return fd < 0 ? INVALID_HANDLE_VALUE : (HANDLE)(intptr_t)(fd + 1); }
+inline int FdOf(HANDLE h) { return (int)(intptr_t)h - 1; }
+inline int Whence(DWORD method) { return method == FILE_BEGIN ? SEEK_SET : method == FILE_CURRENT ? SEEK_CUR : SEEK_END; }
+
+inline HANDLE GetCurrentProcess() { return 0; }
+inline BOOL DuplicateHandle(HANDLE, HANDLE src, HANDLE, HANDLE *dst, DWORD, BOOL, DWORD) {
+	int fd = dup(FdOf(src));
+	if(fd < 0) return FALSE;
+	*dst = HandleOf(fd);
+	return TRUE;
+}
+inline HANDLE CreateFileA(const char *name, DWORD access, DWORD, void *, DWORD, DWORD, void *) {
+	return HandleOf((access & GENERIC_WRITE) ? open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(name, O_RDONLY));
+}
+inline BOOL CloseHandle(HANDLE h) { return close(FdOf(h)) == 0; }
+inline DWORD GetFileType(HANDLE h) {
+	struct stat st;
+	return fstat(FdOf(h), &st) == 0 && S_ISREG(st.st_mode) ? FILE_TYPE_DISK : FILE_TYPE_PIPE;
+}
+inline DWORD SetFilePointer(HANDLE h, LONG dist, LONG *high, DWORD method) {
+	off_t to = high ? (off_t)(((unsigned long long)(DWORD)*high << 32) | (DWORD)dist) : (off_t)dist;
+	off_t at = lseek(FdOf(h), to, Whence(method));
+	if(at < 0) return INVALID_SET_FILE_POINTER;
+	if(high) *high = (LONG)(at >> 32);
+	return (DWORD)at;
+}
+inline BOOL SetFilePointerEx(HANDLE h, LARGE_INTEGER dist, LARGE_INTEGER *pos, DWORD method) {
+	off_t at = lseek(FdOf(h), (off_t)dist.QuadPart, Whence(method));
+	if(at < 0) return FALSE;
+	if(pos) pos->QuadPart = at;
+	return TRUE;
+}
+inline BOOL GetFileSizeEx(HANDLE h, LARGE_INTEGER *size) {
+	struct stat st;
+	if(fstat(FdOf(h), &st) != 0) return FALSE;
+	size->QuadPart = st.st_size;
+	return TRUE;
+}
+inline BOOL ReadFile(HANDLE h, void *buf, DWORD n, DWORD *got, void *) {
+	ssize_t r = read(FdOf(h), buf, n);
+	*got = r < 0 ? 0 : (DWORD)r;
+	return r >= 0;
+}
+inline BOOL WriteFile(HANDLE h, const void *buf, DWORD n, DWORD *put, void *) {
+	ssize_t r = write(FdOf(h), buf, n);
+	*put = r < 0 ? 0 : (DWORD)r;
+	return r >= 0;
+}
+inline BOOL CreateDirectoryA(const char *name, void *) { return mkdir(name, 0755) == 0; }
+inline DWORD GetCurrentDirectoryA(DWORD n, char *buf) { return getcwd(buf, n) ? (DWORD)strlen(buf) : 0; }
+inline BOOL SystemTimeToFileTime(const SYSTEMTIME *, FILETIME *ft) { ft->dwLowDateTime = ft->dwHighDateTime = 0; return TRUE; }
+inline BOOL DosDateTimeToFileTime(WORD, WORD, FILETIME *ft) { ft->dwLowDateTime = ft->dwHighDateTime = 0; return TRUE; }
+inline BOOL SetFileTime(HANDLE, const FILETIME *, const FILETIME *, const FILETIME *) { return TRUE; }
+
+// A mapping is a descriptor of its own, and a view is the whole file, as unzip.cpp asks for
+struct TMappedViews {
+	std::mutex lock;
+	std::map<const void *, size_t> sizes;
+	static TMappedViews &All() { static TMappedViews views; return views; }
+};
+inline HANDLE CreateFileMappingA(HANDLE h, void *, DWORD, DWORD, DWORD, const char *) {
+	int fd = dup(FdOf(h));
+	return fd < 0 ? 0 : HandleOf(fd);
+}
+inline void *MapViewOfFile(HANDLE h, DWORD, DWORD, DWORD, size_t) {
+	struct stat st;
+	if(fstat(FdOf(h), &st) != 0 || st.st_size == 0) return 0;
+	void *p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, FdOf(h), 0);
+	if(p == MAP_FAILED) return 0;
+	std::lock_guard<std::mutex> hold(TMappedViews::All().lock);
+	TMappedViews::All().sizes[p] = (size_t)st.st_size;
+	return p;
+}
+inline BOOL UnmapViewOfFile(const void *p) {
+	std::lock_guard<std::mutex> hold(TMappedViews::All().lock);
+	std::map<const void *, size_t>::iterator i = TMappedViews::All().sizes.find(p);
+	if(i == TMappedViews::All().sizes.end()) return FALSE;
+	munmap((void *)p, i->second);
+	TMappedViews::All().sizes.erase(i);
+	return TRUE;
+}
+
+#endif //WIN32_WINDOWS_H_INCLUDED_
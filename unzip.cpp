@@ -3,7 +3,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <system_error>
+#include <new>
 #include "unzip.h"
+#include "Cpu.h"
+#include "Inflate.h"
+#if defined(CPU_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#include <immintrin.h>
+#include <wmmintrin.h>
+#endif
 
 // THIS FILE is almost entirely based upon code by Jean-loup Gailly
 // and Mark Adler. It has been modified by Lucian Wischik.
@@ -110,6 +125,8 @@ typedef struct tm_unz_s
 } tm_unz;
 
 
+typedef unsigned long long ZPOS64_T; // offsets and sizes in the zipfile, which pass 4GB in a zip64
+
 // unz_global_info structure contain global data about the ZIPfile
 typedef struct unz_global_info_s
 { unsigned long number_entry;         // total number of entries in the central dir on this disk
@@ -124,8 +141,8 @@ typedef struct unz_file_info_s
   unsigned long compression_method;   // compression method              2 bytes
   unsigned long dosDate;              // last mod file date in Dos fmt   4 bytes
   unsigned long crc;                  // crc-32                          4 bytes
-  unsigned long compressed_size;      // compressed size                 4 bytes
-  unsigned long uncompressed_size;    // uncompressed size               4 bytes
+  ZPOS64_T compressed_size;           // compressed size                 4 bytes, or 8 in the zip64 extra field
+  ZPOS64_T uncompressed_size;         // uncompressed size               4 bytes, or 8 in the zip64 extra field
   unsigned long size_filename;        // filename length                 2 bytes
   unsigned long size_file_extra;      // extra field length              2 bytes
   unsigned long size_file_comment;    // file comment length             2 bytes
@@ -415,6 +432,15 @@ int inflateReset (z_streamp strm);
 //   stream state was inconsistent (such as zalloc or state being NULL).
 //
 
+int inflate_ref (const Byte *in, uInt inlen, uInt chunk, Byte *out, uInt outlen, uInt *written);
+//     Decodes raw deflate data in one go with the inflate above, which unzip
+//   no longer uses, so that TInflater can be checked against it. The input is
+//   fed in pieces of chunk bytes, as unzReadCurrentFile used to feed it.
+//
+//     Returns Z_STREAM_END if the data ended, Z_OK if out filled up or the
+//   input ran out first, or else inflate's error. *written says how much of
+//   out it wrote.
+
 
 
 // checksum functions
@@ -436,6 +462,14 @@ uLong adler32 (uLong adler, const Byte *buf, uInt len);
 //     }
 //     if (adler != original_adler) error();
 
+// The individual adler32 kernels, so they can be checked and timed against
+// each other. Only call a vector one if CpuHas() reports its extension.
+uLong adler32_ref  (uLong adler, const Byte *buf, uInt len);
+#if defined(CPU_X86)
+uLong adler32_ssse3(uLong adler, const Byte *buf, uInt len);
+uLong adler32_avx2 (uLong adler, const Byte *buf, uInt len);
+#endif
+
 uLong ucrc32   (uLong crc, const Byte *buf, uInt len);
 //     Update a running crc with the bytes buf[0..len-1] and return the updated
 //   crc. If buf is NULL, this function returns the required initial value
@@ -450,6 +484,14 @@ uLong ucrc32   (uLong crc, const Byte *buf, uInt len);
 //     }
 //     if (crc != original_crc) error();
 
+// The individual crc kernels, so they can be checked and timed against each
+// other. Only call ucrc32_pclmul if CpuHas(cfPCLMUL|cfSSE41).
+uLong ucrc32_ref   (uLong crc, const Byte *buf, uInt len);
+uLong ucrc32_slice8(uLong crc, const Byte *buf, uInt len);
+#if defined(CPU_X86)
+uLong ucrc32_pclmul(uLong crc, const Byte *buf, uInt len);
+#endif
+
 
 
 
@@ -1489,14 +1531,18 @@ int inflate_blocks(inflate_blocks_statef *s, z_streamp z, int r)
         t = inflate_trees_dynamic(257 + (t & 0x1f), 1 + ((t >> 5) & 0x1f),
                                   s->sub.trees.blens, &bl, &bd, &tl, &td,
                                   s->hufts, z);
-        ZFREE(z, s->sub.trees.blens);
         if (t != Z_OK)
         {
           if (t == (uInt)Z_DATA_ERROR)
+          { // as zlib 1.1.4: freeing blens whatever happened, and staying in
+            // IBM_DTREE, made inflate_blocks_reset free it a second time
+            ZFREE(z, s->sub.trees.blens);
             s->mode = IBM_BAD;
+          }
           r = t;
           LEAVE
         }
+        ZFREE(z, s->sub.trees.blens);
         Tracev((stderr, "inflate:       trees ok\n"));
         if ((c = inflate_codes_new(bl, bd, tl, td, z)) == Z_NULL)
         {
@@ -2181,7 +2227,9 @@ const uLong * get_crc_table()
 #define CRC_DO4(buf)  CRC_DO2(buf); CRC_DO2(buf);
 #define CRC_DO8(buf)  CRC_DO4(buf); CRC_DO4(buf);
 
-uLong ucrc32(uLong crc, const Byte *buf, uInt len)
+// ucrc32_ref - the original byte-at-a-time version, kept as the reference
+// that the faster ones below are checked against.
+uLong ucrc32_ref(uLong crc, const Byte *buf, uInt len)
 { if (buf == Z_NULL) return 0L;
   crc = crc ^ 0xffffffffL;
   while (len >= 8)  {CRC_DO8(buf); len -= 8;}
@@ -2189,6 +2237,123 @@ uLong ucrc32(uLong crc, const Byte *buf, uInt len)
   return crc ^ 0xffffffffL;
 }
 
+// Slicing-by-8: crc_slice[k][n] is the crc of byte n followed by k zero bytes,
+// so eight table lookups, all independent of each other, consume eight bytes.
+// The tables are built from crc_table the first time any kernel wants them,
+// so that each kernel can be called on its own, before ucrc32 ever has been.
+typedef unsigned int TCrcSlices[8][256];
+
+static const TCrcSlices &crc_slices()
+{ struct TTables
+  { TCrcSlices t;
+    TTables()
+    { for (int n=0; n<256; n++) t[0][n]=(unsigned int)crc_table[n];
+      for (int k=1; k<8; k++)
+      { for (int n=0; n<256; n++)
+        { unsigned int c=t[k-1][n];
+          t[k][n] = (c>>8) ^ t[0][c&0xff];
+        }
+      }
+    }
+  };
+  static const TTables tables; // made once, even with several threads at it
+  return tables.t;
+}
+
+// The words are read little-endian, as every target this builds for is.
+uLong ucrc32_slice8(uLong crc, const Byte *buf, uInt len)
+{ if (buf == Z_NULL) return 0L;
+  const TCrcSlices &crc_slice = crc_slices();
+  unsigned int c = (unsigned int)crc ^ 0xffffffff;
+  while (len >= 8)
+  { unsigned int lo,hi; memcpy(&lo,buf,4); memcpy(&hi,buf+4,4);
+    lo ^= c;
+    c = crc_slice[7][lo&0xff] ^ crc_slice[6][(lo>>8)&0xff] ^ crc_slice[5][(lo>>16)&0xff] ^ crc_slice[4][lo>>24]
+      ^ crc_slice[3][hi&0xff] ^ crc_slice[2][(hi>>8)&0xff] ^ crc_slice[1][(hi>>16)&0xff] ^ crc_slice[0][hi>>24];
+    buf += 8; len -= 8;
+  }
+  while (len) {c = crc_slice[0][(c^*buf++)&0xff] ^ (c>>8); len--;}
+  return c ^ 0xffffffff;
+}
+
+#if defined(CPU_X86)
+// ucrc32_pclmul - folds 64 bytes at a time with carry-less multiplies, then
+// Barrett-reduces to 32 bits: Gopal et al, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction" (Intel, 2009), in the bit-reflected
+// form with its constants for the zip polynomial. Whatever doesn't make a
+// whole 16-byte block at the end goes through slicing-by-8.
+CPU_TARGET("sse4.1,pclmul")
+uLong ucrc32_pclmul(uLong crc, const Byte *buf, uInt len)
+{ if (buf == Z_NULL) return 0L;
+  if (len < 64) return ucrc32_slice8(crc,buf,len);
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)((unsigned int)crc ^ 0xffffffff)));
+  buf += 64; len -= 64;
+  // four independent 128-bit lanes, each folded forward 512 bits a step
+  while (len >= 64)
+  { __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(buf + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 0x30)));
+    buf += 64; len -= 64;
+  }
+  // fold the four lanes into one, then any remaining 16-byte blocks into that
+  __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+  while (len >= 16)
+  { x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i*)buf)), x5);
+    buf += 16; len -= 16;
+  }
+  // 128 bits down to 64, then Barrett reduction down to 32
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  unsigned int c = (unsigned int)_mm_extract_epi32(x1, 1) ^ 0xffffffff;
+  return ucrc32_slice8(c, buf, len);
+}
+#endif
+
+typedef uLong (*TCrcKernel)(uLong crc, const Byte *buf, uInt len);
+
+static TCrcKernel choose_crc_kernel()
+{
+#if defined(CPU_X86)
+  if (CpuHas(cfPCLMUL|cfSSE41)) return ucrc32_pclmul;
+#endif
+  return ucrc32_slice8;
+}
+
+// ucrc32 - picks the fastest of the above that the CPU can run
+uLong ucrc32(uLong crc, const Byte *buf, uInt len)
+{ static const TCrcKernel kernel = choose_crc_kernel();
+  return kernel(crc,buf,len);
+}
+
 
 // adler32.c -- compute the Adler-32 checksum of a data stream
 // Copyright (C) 1995-1998 Mark Adler
@@ -2208,7 +2373,9 @@ uLong ucrc32(uLong crc, const Byte *buf, uInt len)
 #define AD_DO16(buf)   AD_DO8(buf,0); AD_DO8(buf,8);
 
 // =========================================================================
-uLong adler32(uLong adler, const Byte *buf, uInt len)
+// adler32_ref - the original scalar version, kept as the reference that the
+// vector ones below are checked against.
+uLong adler32_ref(uLong adler, const Byte *buf, uInt len)
 {
     unsigned long s1 = adler & 0xffff;
     unsigned long s2 = (adler >> 16) & 0xffff;
@@ -2234,6 +2401,108 @@ uLong adler32(uLong adler, const Byte *buf, uInt len)
     return (s2 << 16) | s1;
 }
 
+#if defined(CPU_X86)
+// The vector versions take 32 bytes a step. s1 just needs their sum, which
+// psadbw gives; s2 gains 32*s1 plus 32*b[0] + 31*b[1] + ... + 1*b[31], which
+// pmaddubsw against those weights gives. The 32*s1 terms are saved up in ps
+// and added in with one shift at the end of each NMAX block, which is when
+// everything gets reduced mod BASE just as in the scalar version.
+// Anything short of a whole step at the end goes through adler32_ref.
+CPU_TARGET("ssse3")
+uLong adler32_ssse3(uLong adler, const Byte *buf, uInt len)
+{ if (buf == Z_NULL) return 1L;
+  unsigned int s1 = adler & 0xffff;
+  unsigned int s2 = (adler >> 16) & 0xffff;
+  uInt blocks = len / 32;
+  len -= blocks * 32;
+  const __m128i tap1 = _mm_setr_epi8(32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17);
+  const __m128i tap2 = _mm_setr_epi8(16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  while (blocks)
+  { uInt n = NMAX / 32;
+    if (n > blocks) n = blocks;
+    blocks -= n;
+    __m128i v_ps = _mm_cvtsi32_si128((int)(s1 * n));
+    __m128i v_s2 = _mm_cvtsi32_si128((int)s2);
+    __m128i v_s1 = zero;
+    do
+    { __m128i b1 = _mm_loadu_si128((const __m128i*)buf);
+      __m128i b2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_add_epi32(_mm_sad_epu8(b1, zero), _mm_sad_epu8(b2, zero)));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+      buf += 32;
+    } while (--n);
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1,0,3,2)));
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2,3,0,1)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1,0,3,2)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2,3,0,1)));
+    s1 = (s1 + (unsigned int)_mm_cvtsi128_si32(v_s1)) % BASE;
+    s2 = (unsigned int)_mm_cvtsi128_si32(v_s2) % BASE;
+  }
+  return adler32_ref((s2 << 16) | s1, buf, len);
+}
+
+CPU_TARGET("avx2")
+uLong adler32_avx2(uLong adler, const Byte *buf, uInt len)
+{ if (buf == Z_NULL) return 1L;
+  unsigned int s1 = adler & 0xffff;
+  unsigned int s2 = (adler >> 16) & 0xffff;
+  uInt blocks = len / 32;
+  len -= blocks * 32;
+  const __m256i tap = _mm256_setr_epi8(32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,
+                                       16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi16(1);
+  while (blocks)
+  { uInt n = NMAX / 32;
+    if (n > blocks) n = blocks;
+    blocks -= n;
+    __m256i v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0);
+    __m256i v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+    __m256i v_s1 = zero;
+    do
+    { __m256i b = _mm256_loadu_si256((const __m256i*)buf);
+      v_ps = _mm256_add_epi32(v_ps, v_s1);
+      v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(b, zero));
+      v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(b, tap), ones));
+      buf += 32;
+    } while (--n);
+    v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+    __m128i h1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+    __m128i h2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+    h1 = _mm_add_epi32(h1, _mm_shuffle_epi32(h1, _MM_SHUFFLE(1,0,3,2)));
+    h1 = _mm_add_epi32(h1, _mm_shuffle_epi32(h1, _MM_SHUFFLE(2,3,0,1)));
+    h2 = _mm_add_epi32(h2, _mm_shuffle_epi32(h2, _MM_SHUFFLE(1,0,3,2)));
+    h2 = _mm_add_epi32(h2, _mm_shuffle_epi32(h2, _MM_SHUFFLE(2,3,0,1)));
+    s1 = (s1 + (unsigned int)_mm_cvtsi128_si32(h1)) % BASE;
+    s2 = (unsigned int)_mm_cvtsi128_si32(h2) % BASE;
+  }
+  _mm256_zeroupper();
+  return adler32_ref((s2 << 16) | s1, buf, len);
+}
+#endif
+
+typedef uLong (*TAdlerKernel)(uLong adler, const Byte *buf, uInt len);
+
+static TAdlerKernel choose_adler_kernel()
+{
+#if defined(CPU_X86)
+  if (CpuHas(cfAVX2)) return adler32_avx2;
+  if (CpuHas(cfSSSE3)) return adler32_ssse3;
+#endif
+  return adler32_ref;
+}
+
+// adler32 - picks the fastest of the above that the CPU can run
+uLong adler32(uLong adler, const Byte *buf, uInt len)
+{ static const TAdlerKernel kernel = choose_adler_kernel();
+  return kernel(adler,buf,len);
+}
+
 
 
 // zutil.c -- target dependent utility functions for the compression library
@@ -2275,6 +2544,9 @@ void  zcfree (voidpf opaque, voidpf ptr)
 
 
 // inflate.c -- zlib interface to inflate modules
+//
+// Note: unzip no longer decodes with this (see TInflater in Inflate.cpp), but
+// it's kept as the reference that the new decoder is checked against.
 // Copyright (C) 1995-1998 Mark Adler
 // For conditions of distribution and use, see copyright notice in zlib.h
 
@@ -2537,6 +2809,32 @@ int inflate(z_streamp z, int f)
 }
 
 
+int inflate_ref(const Byte *in, uInt inlen, uInt chunk, Byte *out, uInt outlen, uInt *written)
+{ z_stream zs; zmemzero(&zs,sizeof(zs));
+  *written = 0;
+  int err = inflateInit2(&zs);
+  if (err != Z_OK) return err;
+  static Byte dummy = 0; // inflate won't take a null next_in, even with nothing in it
+  zs.next_in = inlen==0 ? &dummy : (Byte*)in;
+  zs.next_out = out; zs.avail_out = outlen;
+  uInt left = inlen;
+  if (chunk == 0) chunk = inlen;
+  for (;;)
+  { if (zs.avail_in == 0 && left > 0)
+    { zs.avail_in = left < chunk ? left : chunk;
+      left -= zs.avail_in;
+    }
+    err = inflate(&zs,Z_SYNC_FLUSH);
+    if (err != Z_OK || zs.avail_out == 0) break;
+    if (zs.avail_in == 0 && left == 0) break;
+  }
+  if (err == Z_BUF_ERROR && (zs.avail_out == 0 || (zs.avail_in == 0 && left == 0))) err = Z_OK;
+  *written = (uInt)zs.total_out;
+  inflateEnd(&zs);
+  return err;
+}
+
+
 
 
 
@@ -2551,6 +2849,7 @@ int inflate(z_streamp z, int f)
 #define UNZ_MAXFILENAMEINZIP (256)
 #define SIZECENTRALDIRITEM (0x2e)
 #define SIZEZIPLOCALHEADER (0x1e)
+#define SIZEZIP64ENDRECORD (0x38)
 
 
 
@@ -2560,7 +2859,7 @@ const char unz_copyright[] = " unzip 0.15 Copyright 1998 Gilles Vollant ";
 // unz_file_info_interntal contain internal info about a file in zipfile
 typedef struct unz_file_info_internal_s
 {
-    uLong offset_curfile;// relative offset of local header 4 bytes
+    ZPOS64_T offset_curfile;// relative offset of local header 4 bytes, or 8 in the zip64 extra field
 } unz_file_info_internal;
 
 
@@ -2568,9 +2867,10 @@ typedef struct
 { bool is_handle; // either a handle or memory
   bool canseek;
   // for handles:
-  HANDLE h; bool herr; unsigned long initial_offset;
+  HANDLE h; bool herr; ZPOS64_T initial_offset;
   // for memory:
-  void *buf; unsigned int len,pos; // if it's a memory block
+  void *buf; ZPOS64_T len,pos; // if it's a memory block
+  bool mapped; // if that memory is a view of the file h, which we opened by name
 } LUFILE;
 
 
@@ -2587,17 +2887,35 @@ LUFILE *lufopen(void *z,unsigned int len,DWORD flags,ZRESULT *err)
     else
     { h=CreateFileA((const char*)z,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
       if (h==INVALID_HANDLE_VALUE) {*err=ZR_NOFILE; return NULL;}
+      // A file on disk is mapped, if it can be, and then read just like a memory
+      // block: no more ReadFile and SetFilePointer calls for every few bytes of
+      // header. The handle stays open so that, with FILE_SHARE_READ, nobody can
+      // write to the file while we're looking at it.
+      LARGE_INTEGER size; void *view=NULL;
+      if (GetFileType(h)==FILE_TYPE_DISK && GetFileSizeEx(h,&size) && size.QuadPart>0 && (ZPOS64_T)size.QuadPart==(size_t)size.QuadPart)
+      { HANDLE hmap = CreateFileMappingA(h,NULL,PAGE_READONLY,0,0,NULL);
+        if (hmap!=NULL) {view=MapViewOfFile(hmap,FILE_MAP_READ,0,0,0); CloseHandle(hmap);}
+      }
+      if (view!=NULL)
+      { LUFILE *lf = new LUFILE;
+        lf->is_handle=false; lf->canseek=true; lf->mapped=true;
+        lf->h=h; lf->herr=false;
+        lf->buf=view; lf->len=size.QuadPart; lf->pos=0; lf->initial_offset=0;
+        return lf;
+      }
     }
     DWORD type = GetFileType(h);
     canseek = (type==FILE_TYPE_DISK);
   }
   LUFILE *lf = new LUFILE;
+  lf->mapped=false;
   if (flags==ZIP_HANDLE||flags==ZIP_FILENAME)
   { lf->is_handle=true;
     lf->canseek=canseek;
     lf->h=h; lf->herr=false;
     lf->initial_offset=0;
-    if (canseek) lf->initial_offset = SetFilePointer(h,0,NULL,FILE_CURRENT);
+    LARGE_INTEGER zero,here; zero.QuadPart=0;
+    if (canseek && SetFilePointerEx(h,zero,&here,FILE_CURRENT)) lf->initial_offset = here.QuadPart;
   }
   else
   { lf->is_handle=false;
@@ -2612,6 +2930,7 @@ LUFILE *lufopen(void *z,unsigned int len,DWORD flags,ZRESULT *err)
 int lufclose(LUFILE *stream)
 { if (stream==NULL) return EOF;
   if (stream->is_handle) CloseHandle(stream->h);
+  if (stream->mapped) {UnmapViewOfFile(stream->buf); CloseHandle(stream->h);}
   delete stream;
   return 0;
 }
@@ -2621,17 +2940,22 @@ int luferror(LUFILE *stream)
   else return 0;
 }
 
-long int luftell(LUFILE *stream)
-{ if (stream->is_handle && stream->canseek) return SetFilePointer(stream->h,0,NULL,FILE_CURRENT)-stream->initial_offset;
+ZPOS64_T luftell(LUFILE *stream)
+{ if (stream->is_handle && stream->canseek)
+  { LARGE_INTEGER zero,here; zero.QuadPart=0;
+    if (!SetFilePointerEx(stream->h,zero,&here,FILE_CURRENT)) return 0;
+    return here.QuadPart-stream->initial_offset;
+  }
   else if (stream->is_handle) return 0;
   else return stream->pos;
 }
 
-int lufseek(LUFILE *stream, long offset, int whence)
+int lufseek(LUFILE *stream, long long offset, int whence)
 { if (stream->is_handle && stream->canseek)
-  { if (whence==SEEK_SET) SetFilePointer(stream->h,stream->initial_offset+offset,0,FILE_BEGIN);
-    else if (whence==SEEK_CUR) SetFilePointer(stream->h,offset,NULL,FILE_CURRENT);
-    else if (whence==SEEK_END) SetFilePointer(stream->h,offset,NULL,FILE_END);
+  { LARGE_INTEGER li; li.QuadPart=offset;
+    if (whence==SEEK_SET) {li.QuadPart+=stream->initial_offset; SetFilePointerEx(stream->h,li,NULL,FILE_BEGIN);}
+    else if (whence==SEEK_CUR) SetFilePointerEx(stream->h,li,NULL,FILE_CURRENT);
+    else if (whence==SEEK_END) SetFilePointerEx(stream->h,li,NULL,FILE_END);
     else return 19; // EINVAL
     return 0;
   }
@@ -2652,7 +2976,8 @@ size_t lufread(void *ptr,size_t size,size_t n,LUFILE *stream)
     if (!res) stream->herr=true;
     return red/size;
   }
-  if (stream->pos+toread > stream->len) toread = stream->len-stream->pos;
+  if (stream->pos>=stream->len) toread=0;
+  else if (toread > stream->len-stream->pos) toread = (unsigned int)(stream->len-stream->pos);
   memcpy(ptr, (char*)stream->buf + stream->pos, toread); DWORD red = toread;
   stream->pos += red;
   return red/size;
@@ -2668,20 +2993,21 @@ typedef struct
 	char  *read_buffer;         // internal buffer for compressed data
 	z_stream stream;            // zLib stream structure for inflate
 
-	uLong pos_in_zipfile;       // position in byte on the zipfile, for fseek
+	ZPOS64_T pos_in_zipfile;    // position in byte on the zipfile, for fseek
 	uLong stream_initialised;   // flag set if stream structure is initialised
+	TInflater *inflater;        // the decoder, made for the first deflated file and then kept
 
-	uLong offset_local_extrafield;// offset of the local extra field
+	ZPOS64_T offset_local_extrafield;// offset of the local extra field
 	uInt  size_local_extrafield;// size of the local extra field
 	uLong pos_local_extrafield;   // position in the local extra field in read
 
 	uLong crc32;                // crc32 of all data uncompressed
 	uLong crc32_wait;           // crc32 we must obtain after decompress all
-	uLong rest_read_compressed; // number of byte to be decompressed
-	uLong rest_read_uncompressed;//number of byte to be obtained after decomp
+	ZPOS64_T rest_read_compressed; // number of byte to be decompressed
+	ZPOS64_T rest_read_uncompressed;//number of byte to be obtained after decomp
 	LUFILE* file;                 // io structore of the zipfile
 	uLong compression_method;   // compression method (0==store)
-	uLong byte_before_the_zipfile;// byte before the zipfile, (>0 for sfx)
+	ZPOS64_T byte_before_the_zipfile;// byte before the zipfile, (>0 for sfx)
 } file_in_zip_read_info_s;
 
 
@@ -2690,18 +3016,20 @@ typedef struct
 {
 	LUFILE* file;               // io structore of the zipfile
 	unz_global_info gi;         // public global information
-	uLong byte_before_the_zipfile;// byte before the zipfile, (>0 for sfx)
+	ZPOS64_T byte_before_the_zipfile;// byte before the zipfile, (>0 for sfx)
 	uLong num_file;             // number of the current file in the zipfile
-	uLong pos_in_central_dir;   // pos of the current file in the central dir
+	ZPOS64_T pos_in_central_dir;// pos of the current file in the central dir
 	uLong current_file_ok;      // flag about the usability of the current file
-	uLong central_pos;          // position of the beginning of the central dir
+	ZPOS64_T central_pos;       // position of the end of central dir record
 
-	uLong size_central_dir;     // size of the central directory
-	uLong offset_central_dir;   // offset of start of central directory with respect to the starting disk number
+	ZPOS64_T size_central_dir;  // size of the central directory
+	ZPOS64_T offset_central_dir;// offset of start of central directory with respect to the starting disk number
 
 	unz_file_info cur_file_info; // public info about the current file in zip
 	unz_file_info_internal cur_file_info_internal; // private info about it
     file_in_zip_read_info_s* pfile_in_zip_read; // structure about the current file if we are decompressing it
+    file_in_zip_read_info_s* spare; // the last one closed, read_buffer, inflater and all, kept for the next
+    uLong allocs, reuses;       // how many blocks opening files has allocated; how many opens used the spare
 } unz_s, *unzFile;
 
 
@@ -2798,6 +3126,28 @@ int unzlocal_getLong (LUFILE *fin,uLong *pX)
 }
 
 
+// Headers are read whole, with one lufread, rather than a byte at a time:
+// unzlocal_getBlock reads n bytes, and the fields are then picked out of them
+// in LSB order by unzlocal_bufShort and unzlocal_bufLong.
+int unzlocal_getBlock (LUFILE *fin,unsigned char *buf,uInt n)
+{ if (lufread(buf,n,1,fin)==1) return UNZ_OK;
+  if (luferror(fin)) return UNZ_ERRNO;
+  else return UNZ_EOF;
+}
+
+uLong unzlocal_bufShort (const unsigned char *p)
+{ return (uLong)p[0] | ((uLong)p[1]<<8);
+}
+
+uLong unzlocal_bufLong (const unsigned char *p)
+{ return (uLong)p[0] | ((uLong)p[1]<<8) | ((uLong)p[2]<<16) | ((uLong)p[3]<<24);
+}
+
+ZPOS64_T unzlocal_bufLong64 (const unsigned char *p)
+{ return (ZPOS64_T)unzlocal_bufLong(p) | ((ZPOS64_T)unzlocal_bufLong(p+4)<<32);
+}
+
+
 // My own strcmpi / strcasecmp 
 int strcmpcasenosensitive_internal (const char* fileName1,const char *fileName2)
 {
@@ -2838,20 +3188,20 @@ int unzStringFileNameCompare (const char*fileName1,const char*fileName2,int iCas
 
 //  Locate the Central directory of a zipfile (at the end, just before
 // the global comment)
-uLong unzlocal_SearchCentralDir(LUFILE *fin)
+ZPOS64_T unzlocal_SearchCentralDir(LUFILE *fin)
 { if (lufseek(fin,0,SEEK_END) != 0) return 0;
-  uLong uSizeFile = luftell(fin);
+  ZPOS64_T uSizeFile = luftell(fin);
 
-  uLong uMaxBack=0xffff; // maximum size of global comment
+  ZPOS64_T uMaxBack=0xffff; // maximum size of global comment
   if (uMaxBack>uSizeFile) uMaxBack = uSizeFile;
 
   unsigned char *buf = (unsigned char*)zmalloc(BUFREADCOMMENT+4);
   if (buf==NULL) return 0;
-  uLong uPosFound=0;
+  ZPOS64_T uPosFound=0;
 
-  uLong uBackRead = 4;
+  ZPOS64_T uBackRead = 4;
   while (uBackRead<uMaxBack)
-  { uLong uReadSize,uReadPos ;
+  { ZPOS64_T uReadSize,uReadPos ;
     int i;
     if (uBackRead+BUFREADCOMMENT>uMaxBack) uBackRead = uMaxBack;
     else uBackRead+=BUFREADCOMMENT;
@@ -2870,6 +3220,61 @@ uLong unzlocal_SearchCentralDir(LUFILE *fin)
   return uPosFound;
 }
 
+//  Locate the Zip64 end of central dir record, through the locator that comes
+//  just before the ordinary end record at central_pos. Returns 0 if there's none.
+ZPOS64_T unzlocal_SearchCentralDir64(LUFILE *fin,ZPOS64_T central_pos)
+{ unsigned char h[20];
+  if (central_pos<20) return 0;
+  if (lufseek(fin,central_pos-20,SEEK_SET)!=0) return 0;
+  if (unzlocal_getBlock(fin,h,20)!=UNZ_OK) return 0;
+  if (unzlocal_bufLong(h)!=0x07064b50) return 0;
+  // the locator says where the record is from the start of the zipfile, which
+  // is off if something's been put in front of it (sfx); then we try where it
+  // would be with no extensible data after it, just before the locator.
+  ZPOS64_T tries[2]; tries[0]=unzlocal_bufLong64(h+8); tries[1]=central_pos-20-SIZEZIP64ENDRECORD;
+  for (int i=0; i<2; i++)
+  { if (tries[i]>=central_pos) continue;
+    if (lufseek(fin,tries[i],SEEK_SET)!=0) continue;
+    if (unzlocal_getBlock(fin,h,4)!=UNZ_OK) continue;
+    if (unzlocal_bufLong(h)==0x06064b50) return tries[i];
+  }
+  return 0;
+}
+
+//  For a central dir entry whose sizes or offset were too big for it, and so
+//  are 0xFFFFFFFF: finds the zip64 extra field (id 1) in the size_extra bytes of
+//  extra field at pos, and gets the real ones from it, in the order they come.
+int unzlocal_GetZip64Extra(LUFILE *fin,ZPOS64_T pos,uLong size_extra,
+  unz_file_info *pfile_info,unz_file_info_internal *pfile_info_internal)
+{ ZPOS64_T end = pos+size_extra;
+  unsigned char h[28];
+  while (pos+4<=end)
+  { if (lufseek(fin,pos,SEEK_SET)!=0) return UNZ_ERRNO;
+    if (unzlocal_getBlock(fin,h,4)!=UNZ_OK) return UNZ_ERRNO;
+    uLong id=unzlocal_bufShort(h), len=unzlocal_bufShort(h+2);
+    if (pos+4+len>end) break;
+    if (id==1)
+    { uInt n = len<28 ? (uInt)len : 28, i=0;
+      if (unzlocal_getBlock(fin,h,n)!=UNZ_OK) return UNZ_ERRNO;
+      if (pfile_info->uncompressed_size==0xFFFFFFFF)
+      { if (i+8>n) return UNZ_BADZIPFILE;
+        pfile_info->uncompressed_size=unzlocal_bufLong64(h+i); i+=8;
+      }
+      if (pfile_info->compressed_size==0xFFFFFFFF)
+      { if (i+8>n) return UNZ_BADZIPFILE;
+        pfile_info->compressed_size=unzlocal_bufLong64(h+i); i+=8;
+      }
+      if (pfile_info_internal->offset_curfile==0xFFFFFFFF)
+      { if (i+8>n) return UNZ_BADZIPFILE;
+        pfile_info_internal->offset_curfile=unzlocal_bufLong64(h+i);
+      }
+      return UNZ_OK;
+    }
+    pos += 4+len;
+  }
+  return UNZ_BADZIPFILE;
+}
+
 
 int unzGoToFirstFile (unzFile file);
 int unzCloseCurrentFile (unzFile file);
@@ -2883,7 +3288,7 @@ unzFile unzOpenInternal(LUFILE *fin)
 
   int err=UNZ_OK;
   unz_s us;
-  uLong central_pos,uL;
+  ZPOS64_T central_pos; uLong uL;
   central_pos = unzlocal_SearchCentralDir(fin);
   if (central_pos==0) err=UNZ_ERRNO;
   if (lufseek(fin,central_pos,SEEK_SET)!=0) err=UNZ_ERRNO;
@@ -2902,18 +3307,45 @@ unzFile unzOpenInternal(LUFILE *fin)
   if (unzlocal_getShort(fin,&number_entry_CD)!=UNZ_OK) err=UNZ_ERRNO;
   if ((number_entry_CD!=us.gi.number_entry) || (number_disk_with_CD!=0) || (number_disk!=0)) err=UNZ_BADZIPFILE;
   // size of the central directory
-  if (unzlocal_getLong(fin,&us.size_central_dir)!=UNZ_OK) err=UNZ_ERRNO;
+  if (unzlocal_getLong(fin,&uL)!=UNZ_OK) err=UNZ_ERRNO;
+  us.size_central_dir=uL;
   // offset of start of central directory with respect to the starting disk number
-  if (unzlocal_getLong(fin,&us.offset_central_dir)!=UNZ_OK) err=UNZ_ERRNO;
+  if (unzlocal_getLong(fin,&uL)!=UNZ_OK) err=UNZ_ERRNO;
+  us.offset_central_dir=uL;
   // zipfile comment length
   if (unzlocal_getShort(fin,&us.gi.size_comment)!=UNZ_OK) err=UNZ_ERRNO;
-  if ((central_pos+fin->initial_offset<us.offset_central_dir+us.size_central_dir) && (err==UNZ_OK)) err=UNZ_BADZIPFILE;
+  // A zip64 has its own end record as well, before this one, with the numbers
+  // that didn't fit here in full. The central dir ends where that record starts.
+  ZPOS64_T central_end = central_pos;
+  ZPOS64_T central64 = (err==UNZ_OK) ? unzlocal_SearchCentralDir64(fin,central_pos) : 0;
+  if (central64!=0)
+  { unsigned char h[SIZEZIP64ENDRECORD];
+    if (lufseek(fin,central64,SEEK_SET)!=0) err=UNZ_ERRNO;
+    else if (unzlocal_getBlock(fin,h,SIZEZIP64ENDRECORD)!=UNZ_OK) err=UNZ_ERRNO;
+    else
+    { number_disk = unzlocal_bufLong(h+16);
+      number_disk_with_CD = unzlocal_bufLong(h+20);
+      ZPOS64_T entries = unzlocal_bufLong64(h+24), entries_CD = unzlocal_bufLong64(h+32);
+      // items are numbered with ints
+      if ((entries!=entries_CD) || (entries>0x7FFFFFFF) || (number_disk_with_CD!=0) || (number_disk!=0)) err=UNZ_BADZIPFILE;
+      us.gi.number_entry = (uLong)entries;
+      us.size_central_dir = unzlocal_bufLong64(h+40);
+      us.offset_central_dir = unzlocal_bufLong64(h+48);
+      central_end = central64;
+    }
+  }
+  if ((central_end+fin->initial_offset<us.offset_central_dir+us.size_central_dir) && (err==UNZ_OK)) err=UNZ_BADZIPFILE;
+  // every entry takes at least a fixed header in the central dir, so a count
+  // that couldn't fit there is corrupt, and mustn't be allocated for
+  if ((us.gi.number_entry>us.size_central_dir/SIZECENTRALDIRITEM) && (err==UNZ_OK)) err=UNZ_BADZIPFILE;
   if (err!=UNZ_OK) {lufclose(fin);return NULL;}
 
   us.file=fin;
-  us.byte_before_the_zipfile = central_pos+fin->initial_offset - (us.offset_central_dir+us.size_central_dir);
+  us.byte_before_the_zipfile = central_end+fin->initial_offset - (us.offset_central_dir+us.size_central_dir);
   us.central_pos = central_pos;
   us.pfile_in_zip_read = NULL;
+  us.spare = NULL;
+  us.allocs = 0; us.reuses = 0;
   fin->initial_offset = 0; // since the zipfile itself is expected to handle this
 
   unz_s *s = (unz_s*)zmalloc(sizeof(unz_s));
@@ -2937,6 +3369,11 @@ int unzClose (unzFile file)
 
     if (s->pfile_in_zip_read!=NULL)
         unzCloseCurrentFile(file);
+    if (s->spare!=NULL)
+    { delete s->spare->inflater;
+      zfree(s->spare->read_buffer);
+      zfree(s->spare);
+    }
 
 	lufclose(s->file);
 	if (s) zfree(s); // unused s=0;
@@ -2993,7 +3430,7 @@ int unzlocal_GetCurrentFileInfoInternal (unzFile file, unz_file_info *pfile_info
 	unz_file_info file_info;
 	unz_file_info_internal file_info_internal;
 	int err=UNZ_OK;
-	uLong uMagic;
+	unsigned char h[SIZECENTRALDIRITEM];
 	long lSeek=0;
 
 	if (file==NULL)
@@ -3003,59 +3440,31 @@ int unzlocal_GetCurrentFileInfoInternal (unzFile file, unz_file_info *pfile_info
 		err=UNZ_ERRNO;
 
 
-	// we check the magic
+	// we read the whole fixed part of the header, and check the magic
 	if (err==UNZ_OK)
-		if (unzlocal_getLong(s->file,&uMagic) != UNZ_OK)
+		if (unzlocal_getBlock(s->file,h,SIZECENTRALDIRITEM) != UNZ_OK)
 			err=UNZ_ERRNO;
-		else if (uMagic!=0x02014b50)
+		else if (unzlocal_bufLong(h)!=0x02014b50)
 			err=UNZ_BADZIPFILE;
-
-	if (unzlocal_getShort(s->file,&file_info.version) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.version_needed) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.flag) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.compression_method) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getLong(s->file,&file_info.dosDate) != UNZ_OK)
-		err=UNZ_ERRNO;
-
+	if (err!=UNZ_OK)
+		return err;
+
+	file_info.version = unzlocal_bufShort(h+4);
+	file_info.version_needed = unzlocal_bufShort(h+6);
+	file_info.flag = unzlocal_bufShort(h+8);
+	file_info.compression_method = unzlocal_bufShort(h+10);
+	file_info.dosDate = unzlocal_bufLong(h+12);
     unzlocal_DosDateToTmuDate(file_info.dosDate,&file_info.tmu_date);
-
-	if (unzlocal_getLong(s->file,&file_info.crc) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getLong(s->file,&file_info.compressed_size) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getLong(s->file,&file_info.uncompressed_size) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.size_filename) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.size_file_extra) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.size_file_comment) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.disk_num_start) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getShort(s->file,&file_info.internal_fa) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getLong(s->file,&file_info.external_fa) != UNZ_OK)
-		err=UNZ_ERRNO;
-
-	if (unzlocal_getLong(s->file,&file_info_internal.offset_curfile) != UNZ_OK)
-		err=UNZ_ERRNO;
+	file_info.crc = unzlocal_bufLong(h+16);
+	file_info.compressed_size = unzlocal_bufLong(h+20);
+	file_info.uncompressed_size = unzlocal_bufLong(h+24);
+	file_info.size_filename = unzlocal_bufShort(h+28);
+	file_info.size_file_extra = unzlocal_bufShort(h+30);
+	file_info.size_file_comment = unzlocal_bufShort(h+32);
+	file_info.disk_num_start = unzlocal_bufShort(h+34);
+	file_info.internal_fa = unzlocal_bufShort(h+36);
+	file_info.external_fa = unzlocal_bufLong(h+38);
+	file_info_internal.offset_curfile = unzlocal_bufLong(h+42);
 
 	lSeek+=file_info.size_filename;
 	if ((err==UNZ_OK) && (szFileName!=NULL))
@@ -3121,6 +3530,11 @@ int unzlocal_GetCurrentFileInfoInternal (unzFile file, unz_file_info *pfile_info
 	}
 	else {} //unused lSeek+=file_info.size_file_comment;
 
+	if ((err==UNZ_OK) && ((file_info.uncompressed_size==0xFFFFFFFF) ||
+		(file_info.compressed_size==0xFFFFFFFF) || (file_info_internal.offset_curfile==0xFFFFFFFF)))
+		err = unzlocal_GetZip64Extra(s->file,s->pos_in_central_dir+s->byte_before_the_zipfile+SIZECENTRALDIRITEM+file_info.size_filename,
+			file_info.size_file_extra,&file_info,&file_info_internal);
+
 	if ((err==UNZ_OK) && (pfile_info!=NULL))
 		*pfile_info=file_info;
 
@@ -3200,7 +3614,7 @@ int unzLocateFile (unzFile file, const char *szFileName, int iCaseSensitivity)
 
 
 	uLong num_fileSaved;
-	uLong pos_in_central_dirSaved;
+	ZPOS64_T pos_in_central_dirSaved;
 
 
 	if (file==NULL)
@@ -3241,12 +3655,13 @@ int unzLocateFile (unzFile file, const char *szFileName, int iCaseSensitivity)
 //  store in *piSizeVar the size of extra info in local header
 //        (filename and size of extra field data)
 int unzlocal_CheckCurrentFileCoherencyHeader (unz_s *s,uInt *piSizeVar,
-  uLong *poffset_local_extrafield, uInt  *psize_local_extrafield)
+  ZPOS64_T *poffset_local_extrafield, uInt  *psize_local_extrafield)
 {
-	uLong uMagic,uData,uFlags;
+	uLong uData,uFlags;
 	uLong size_filename;
 	uLong size_extra_field;
 	int err=UNZ_OK;
+	unsigned char h[SIZEZIPLOCALHEADER];
 
 	*piSizeVar = 0;
 	*poffset_local_extrafield = 0;
@@ -3257,58 +3672,51 @@ int unzlocal_CheckCurrentFileCoherencyHeader (unz_s *s,uInt *piSizeVar,
 
 
 	if (err==UNZ_OK)
-		if (unzlocal_getLong(s->file,&uMagic) != UNZ_OK)
+		if (unzlocal_getBlock(s->file,h,SIZEZIPLOCALHEADER) != UNZ_OK)
 			err=UNZ_ERRNO;
-		else if (uMagic!=0x04034b50)
+		else if (unzlocal_bufLong(h)!=0x04034b50)
 			err=UNZ_BADZIPFILE;
+	if (err!=UNZ_OK)
+		return err;
 
-	if (unzlocal_getShort(s->file,&uData) != UNZ_OK)
-		err=UNZ_ERRNO;
-//	else if ((err==UNZ_OK) && (uData!=s->cur_file_info.wVersion))
+//	uData = unzlocal_bufShort(h+4); // version
+//	if (uData!=s->cur_file_info.wVersion)
 //		err=UNZ_BADZIPFILE;
-	if (unzlocal_getShort(s->file,&uFlags) != UNZ_OK)
-		err=UNZ_ERRNO;
+	uFlags = unzlocal_bufShort(h+6);
 
-	if (unzlocal_getShort(s->file,&uData) != UNZ_OK)
-		err=UNZ_ERRNO;
-	else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compression_method))
+	uData = unzlocal_bufShort(h+8);
+	if ((err==UNZ_OK) && (uData!=s->cur_file_info.compression_method))
 		err=UNZ_BADZIPFILE;
 
     if ((err==UNZ_OK) && (s->cur_file_info.compression_method!=0) &&
                          (s->cur_file_info.compression_method!=Z_DEFLATED))
         err=UNZ_BADZIPFILE;
 
-	if (unzlocal_getLong(s->file,&uData) != UNZ_OK) // date/time
-		err=UNZ_ERRNO;
+	// h+10 is the date/time
 
-	if (unzlocal_getLong(s->file,&uData) != UNZ_OK) // crc
-		err=UNZ_ERRNO;
-	else if ((err==UNZ_OK) && (uData!=s->cur_file_info.crc) &&
-		                      ((uFlags & 8)==0))
+	uData = unzlocal_bufLong(h+14); // crc
+	if ((err==UNZ_OK) && (uData!=s->cur_file_info.crc) &&
+		                 ((uFlags & 8)==0))
 		err=UNZ_BADZIPFILE;
 
-	if (unzlocal_getLong(s->file,&uData) != UNZ_OK) // size compr
-		err=UNZ_ERRNO;
-	else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compressed_size) &&
-							  ((uFlags & 8)==0))
+	// in a zip64, the local sizes are 0xFFFFFFFF, and the real ones are in the extra field
+	uData = unzlocal_bufLong(h+18); // size compr
+	if ((err==UNZ_OK) && (uData!=s->cur_file_info.compressed_size) && (uData!=0xFFFFFFFF) &&
+						 ((uFlags & 8)==0))
 		err=UNZ_BADZIPFILE;
 
-	if (unzlocal_getLong(s->file,&uData) != UNZ_OK) // size uncompr
-		err=UNZ_ERRNO;
-	else if ((err==UNZ_OK) && (uData!=s->cur_file_info.uncompressed_size) &&
-							  ((uFlags & 8)==0))
+	uData = unzlocal_bufLong(h+22); // size uncompr
+	if ((err==UNZ_OK) && (uData!=s->cur_file_info.uncompressed_size) && (uData!=0xFFFFFFFF) &&
+						 ((uFlags & 8)==0))
 		err=UNZ_BADZIPFILE;
 
-
-	if (unzlocal_getShort(s->file,&size_filename) != UNZ_OK)
-		err=UNZ_ERRNO;
-	else if ((err==UNZ_OK) && (size_filename!=s->cur_file_info.size_filename))
+	size_filename = unzlocal_bufShort(h+26);
+	if ((err==UNZ_OK) && (size_filename!=s->cur_file_info.size_filename))
 		err=UNZ_BADZIPFILE;
 
 	*piSizeVar += (uInt)size_filename;
 
-	if (unzlocal_getShort(s->file,&size_extra_field) != UNZ_OK)
-		err=UNZ_ERRNO;
+	size_extra_field = unzlocal_bufShort(h+28);
 	*poffset_local_extrafield= s->cur_file_info_internal.offset_curfile +
 									SIZEZIPLOCALHEADER + size_filename;
 	*psize_local_extrafield = (uInt)size_extra_field;
@@ -3326,12 +3734,11 @@ int unzlocal_CheckCurrentFileCoherencyHeader (unz_s *s,uInt *piSizeVar,
 //  If there is no error and the file is opened, the return value is UNZ_OK.
 int unzOpenCurrentFile (unzFile file)
 {
-	int err;
 	int Store;
 	uInt iSizeVar;
 	unz_s* s;
 	file_in_zip_read_info_s* pfile_in_zip_read_info;
-	uLong offset_local_extrafield;  // offset of the local extra field
+	ZPOS64_T offset_local_extrafield;  // offset of the local extra field
 	uInt  size_local_extrafield;    // size of the local extra field
 
 	if (file==NULL)
@@ -3347,21 +3754,31 @@ int unzOpenCurrentFile (unzFile file)
 				&offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
 		return UNZ_BADZIPFILE;
 
-	pfile_in_zip_read_info = (file_in_zip_read_info_s*)zmalloc(sizeof(file_in_zip_read_info_s));
-	if (pfile_in_zip_read_info==NULL)
-		return UNZ_INTERNALERROR;
+	// The state the last file was read with is used again if there is one,
+	// so that unzipping many files in turn doesn't allocate for each of them.
+	pfile_in_zip_read_info = s->spare;
+	s->spare = NULL;
+	if (pfile_in_zip_read_info!=NULL)
+		s->reuses++;
+	else
+	{
+		pfile_in_zip_read_info = (file_in_zip_read_info_s*)zmalloc(sizeof(file_in_zip_read_info_s));
+		if (pfile_in_zip_read_info==NULL)
+			return UNZ_INTERNALERROR;
+		pfile_in_zip_read_info->read_buffer=(char*)zmalloc(UNZ_BUFSIZE);
+		if (pfile_in_zip_read_info->read_buffer==NULL)
+		{
+			zfree(pfile_in_zip_read_info);
+			return UNZ_INTERNALERROR;
+		}
+		pfile_in_zip_read_info->inflater=NULL;
+		s->allocs+=2;
+	}
 
-	pfile_in_zip_read_info->read_buffer=(char*)zmalloc(UNZ_BUFSIZE);
 	pfile_in_zip_read_info->offset_local_extrafield = offset_local_extrafield;
 	pfile_in_zip_read_info->size_local_extrafield = size_local_extrafield;
 	pfile_in_zip_read_info->pos_local_extrafield=0;
 
-	if (pfile_in_zip_read_info->read_buffer==NULL)
-	{
-		if (pfile_in_zip_read_info!=0) zfree(pfile_in_zip_read_info); //unused pfile_in_zip_read_info=0;
-		return UNZ_INTERNALERROR;
-	}
-
 	pfile_in_zip_read_info->stream_initialised=0;
 
 	if ((s->cur_file_info.compression_method!=0) && (s->cur_file_info.compression_method!=Z_DEFLATED))
@@ -3377,22 +3794,18 @@ int unzOpenCurrentFile (unzFile file)
 	pfile_in_zip_read_info->byte_before_the_zipfile=s->byte_before_the_zipfile;
 
     pfile_in_zip_read_info->stream.total_out = 0;
+    pfile_in_zip_read_info->stream.total_in = 0;
 
 	if (!Store)
-	{
-	  pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
-	  pfile_in_zip_read_info->stream.zfree = (free_func)0;
-	  pfile_in_zip_read_info->stream.opaque = (voidpf)0;
-
-          err=inflateInit2(&pfile_in_zip_read_info->stream);
-	  if (err == Z_OK)
-	    pfile_in_zip_read_info->stream_initialised=1;
-        // windowBits is passed < 0 to tell that there is no zlib header.
-        // Note that in this case inflate *requires* an extra "dummy" byte
-        // after the compressed stream in order to complete decompression and
-        // return Z_STREAM_END.
-        // In unzip, i don't wait absolutely Z_STREAM_END because I known the
-        // size of both compressed and uncompressed data
+	{ if (pfile_in_zip_read_info->inflater==NULL)
+	  { pfile_in_zip_read_info->inflater = new TInflater;
+	    s->allocs++;
+	  }
+	  else pfile_in_zip_read_info->inflater->Reset(); // keeping its window
+	  pfile_in_zip_read_info->stream_initialised=1;
+        // The data is raw deflate, with no zlib header or check.
+        // In unzip, i don't wait absolutely for the end of the stream because
+        // I known the size of both compressed and uncompressed data
 	}
 	pfile_in_zip_read_info->rest_read_compressed =
             s->cur_file_info.compressed_size ;
@@ -3412,6 +3825,31 @@ int unzOpenCurrentFile (unzFile file)
 }
 
 
+//  unzlocal_ReadWhole: for when the zipfile is in memory, and buf can hold the
+//  whole of a deflated file that hasn't been read from yet. It's decoded straight
+//  from the zipfile into buf, with back-references found in buf itself, rather
+//  than through a window and then copied out. Returns as unzReadCurrentFile;
+//  since that never asks for more than INT_MAX bytes, the count always fits.
+int unzlocal_ReadWhole (file_in_zip_read_info_s* p, Byte *buf)
+{ LUFILE *f = p->file;
+  ZPOS64_T start = p->pos_in_zipfile + p->byte_before_the_zipfile;
+  if (start > f->len || p->rest_read_compressed > f->len-start) return UNZ_ERRNO;
+  const Byte *src = (const Byte*)f->buf + start;
+  size_t written=0;
+  TInflateStatus st = p->inflater->Whole(src,(size_t)p->rest_read_compressed,buf,(size_t)p->rest_read_uncompressed,written);
+  if (st==isError) return Z_DATA_ERROR;
+  // isMore just means the data goes on past the size we were told, which
+  // the streaming path would ignore too.
+  p->crc32 = ucrc32(p->crc32,buf,(uInt)written);
+  p->rest_read_uncompressed -= written;
+  p->pos_in_zipfile += p->rest_read_compressed;
+  p->stream.total_in += (uLong)p->rest_read_compressed;
+  p->rest_read_compressed = 0;
+  p->stream.total_out += written;
+  return (written==0) ? UNZ_EOF : (int)written;
+}
+
+
 //  Read bytes from the current file.
 //  buf contain buffer where data must be copied
 //  len the size of buf.
@@ -3419,6 +3857,8 @@ int unzOpenCurrentFile (unzFile file)
 //  return 0 if the end of file was reached
 //  return <0 with error code if there is an error
 //    (UNZ_ERRNO for IO error, or zLib error for uncompress error)
+//  It reads at most INT_MAX bytes a call, so that the count can't look like an
+//  error; the caller calls again for the rest.
 int unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 { int err=UNZ_OK;
   uInt iRead = 0;
@@ -3430,6 +3870,7 @@ int unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
   if (pfile_in_zip_read_info==NULL) return UNZ_PARAMERROR;
   if ((pfile_in_zip_read_info->read_buffer == NULL)) return UNZ_END_OF_LIST_OF_FILE;
   if (len==0) return 0;
+  if (len>(unsigned)INT_MAX) len=INT_MAX;
 
   pfile_in_zip_read_info->stream.next_out = (Byte*)buf;
   pfile_in_zip_read_info->stream.avail_out = (uInt)len;
@@ -3438,30 +3879,43 @@ int unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
   { pfile_in_zip_read_info->stream.avail_out = (uInt)pfile_in_zip_read_info->rest_read_uncompressed;
   }
 
+  if (pfile_in_zip_read_info->compression_method!=0 && !pfile_in_zip_read_info->file->is_handle
+      && pfile_in_zip_read_info->stream.total_in==0 && pfile_in_zip_read_info->stream.total_out==0
+      && len>=pfile_in_zip_read_info->rest_read_uncompressed && pfile_in_zip_read_info->rest_read_uncompressed>0)
+    return unzlocal_ReadWhole(pfile_in_zip_read_info,(Byte*)buf);
+
   while (pfile_in_zip_read_info->stream.avail_out>0)
   { if ((pfile_in_zip_read_info->stream.avail_in==0) && (pfile_in_zip_read_info->rest_read_compressed>0))
-    { uInt uReadThis = UNZ_BUFSIZE;
+    { LUFILE *f = pfile_in_zip_read_info->file;
+      uInt uReadThis = UNZ_BUFSIZE;
+      if (!f->is_handle) uReadThis = 0x40000000; // as much as avail_in is sure to hold
       if (pfile_in_zip_read_info->rest_read_compressed<uReadThis) uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
       if (uReadThis == 0) return UNZ_EOF;
-      if (lufseek(pfile_in_zip_read_info->file, pfile_in_zip_read_info->pos_in_zipfile + pfile_in_zip_read_info->byte_before_the_zipfile,SEEK_SET)!=0) return UNZ_ERRNO;
-      if (lufread(pfile_in_zip_read_info->read_buffer,uReadThis,1,pfile_in_zip_read_info->file)!=1) return UNZ_ERRNO;
+      ZPOS64_T start = pfile_in_zip_read_info->pos_in_zipfile + pfile_in_zip_read_info->byte_before_the_zipfile;
+      if (!f->is_handle)
+      { // a memory zip is read where it is, all at once, rather than copied to read_buffer
+        if (start>f->len || uReadThis>f->len-start) return UNZ_ERRNO;
+        pfile_in_zip_read_info->stream.next_in = (Byte*)f->buf + start;
+      }
+      else
+      { if (lufseek(f,start,SEEK_SET)!=0) return UNZ_ERRNO;
+        if (lufread(pfile_in_zip_read_info->read_buffer,uReadThis,1,f)!=1) return UNZ_ERRNO;
+        pfile_in_zip_read_info->stream.next_in = (Byte*)pfile_in_zip_read_info->read_buffer;
+      }
       pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
       pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
-      pfile_in_zip_read_info->stream.next_in = (Byte*)pfile_in_zip_read_info->read_buffer;
       pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
     }
 
     if (pfile_in_zip_read_info->compression_method==0)
-    { uInt uDoCopy,i ;
+    { uInt uDoCopy;
       if (pfile_in_zip_read_info->stream.avail_out < pfile_in_zip_read_info->stream.avail_in)
       { uDoCopy = pfile_in_zip_read_info->stream.avail_out ;
       }
       else
       { uDoCopy = pfile_in_zip_read_info->stream.avail_in ;
       }
-      for (i=0;i<uDoCopy;i++)
-      { *(pfile_in_zip_read_info->stream.next_out+i) = *(pfile_in_zip_read_info->stream.next_in+i);
-      }
+      memcpy(pfile_in_zip_read_info->stream.next_out,pfile_in_zip_read_info->stream.next_in,uDoCopy);
       pfile_in_zip_read_info->crc32 = ucrc32(pfile_in_zip_read_info->crc32,pfile_in_zip_read_info->stream.next_out,uDoCopy);
       pfile_in_zip_read_info->rest_read_uncompressed-=uDoCopy;
       pfile_in_zip_read_info->stream.avail_in -= uDoCopy;
@@ -3472,20 +3926,20 @@ int unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
       iRead += uDoCopy;
     }
     else
-    { uLong uTotalOutBefore,uTotalOutAfter;
-      const Byte *bufBefore;
-      uLong uOutThis;
-      int flush=Z_SYNC_FLUSH;
-      uTotalOutBefore = pfile_in_zip_read_info->stream.total_out;
-      bufBefore = pfile_in_zip_read_info->stream.next_out;
-      err=inflate(&pfile_in_zip_read_info->stream,flush);
-      uTotalOutAfter = pfile_in_zip_read_info->stream.total_out;
-      uOutThis = uTotalOutAfter-uTotalOutBefore;
-      pfile_in_zip_read_info->crc32 = ucrc32(pfile_in_zip_read_info->crc32,bufBefore,(uInt)(uOutThis));
+    { z_stream &zs = pfile_in_zip_read_info->stream;
+      const Byte *inBefore=zs.next_in, *in=zs.next_in;
+      Byte *bufBefore=zs.next_out, *out=zs.next_out;
+      bool last = pfile_in_zip_read_info->rest_read_compressed==0;
+      TInflateStatus st = pfile_in_zip_read_info->inflater->Stream(in,in+zs.avail_in,last,out,out+zs.avail_out);
+      uInt uInThis = (uInt)(in-inBefore), uOutThis = (uInt)(out-bufBefore);
+      zs.next_in += uInThis; zs.avail_in -= uInThis; zs.total_in += uInThis;
+      zs.next_out = out; zs.avail_out -= uOutThis; zs.total_out += uOutThis;
+      pfile_in_zip_read_info->crc32 = ucrc32(pfile_in_zip_read_info->crc32,bufBefore,uOutThis);
       pfile_in_zip_read_info->rest_read_uncompressed -= uOutThis;
-      iRead += (uInt)(uTotalOutAfter - uTotalOutBefore);
-      if (err==Z_STREAM_END) return (iRead==0) ? UNZ_EOF : iRead;
-      if (err!=Z_OK) break;
+      iRead += uOutThis;
+      if (st==isEnd) return (iRead==0) ? UNZ_EOF : iRead;
+      if (st==isError) {err=Z_DATA_ERROR; break;}
+      if (uInThis==0 && uOutThis==0) {err=Z_BUF_ERROR; break;} // out of input
     }
   }
 
@@ -3600,17 +4054,10 @@ int unzCloseCurrentFile (unzFile file)
 	}
 
 
-	if (pfile_in_zip_read_info->read_buffer!=0)
-        { void *buf = pfile_in_zip_read_info->read_buffer;
-          zfree(buf);
-          pfile_in_zip_read_info->read_buffer=0;
-        }
-	pfile_in_zip_read_info->read_buffer = NULL;
-	if (pfile_in_zip_read_info->stream_initialised)
-		inflateEnd(&pfile_in_zip_read_info->stream);
-
+	// Nothing is freed: read_buffer and the inflater stay with the state,
+	// which waits as the spare for the next unzOpenCurrentFile, until unzClose.
 	pfile_in_zip_read_info->stream_initialised = 0;
-        if (pfile_in_zip_read_info!=0) zfree(pfile_in_zip_read_info); // unused pfile_in_zip_read_info=0;
+	s->spare = pfile_in_zip_read_info;
 
     s->pfile_in_zip_read=NULL;
 
@@ -3664,17 +4111,59 @@ FILETIME timet2filetime(const time_t timer)
 
 
 
+// TUnzipDirEntry: one central directory record, as parsed once at Open.
+// Its name is kept in TUnzip::names, truncated as ZIPENTRY::name would be.
+struct TUnzipDirEntry
+{ ZPOS64_T pos_in_central_dir;
+  unz_file_info info;
+  unz_file_info_internal info_internal;
+  unsigned int name;
+};
+
+// TUnzipStream: one item being read by OpenZipStream/ReadZipStream. It has a
+// decoder and a place in the zipfile of its own, apart from the TUnzip's
+// current file, so any number of them can be read a piece at a time while
+// the zip is used for other things in between.
+struct TUnzipStream
+{ LUFILE *file;             // the zip's, which must outlive us
+  ZPOS64_T pos;             // where the next compressed bytes are, in the file
+  ZPOS64_T rest_in;         // compressed bytes not yet taken from the file
+  ZPOS64_T rest_out;        // uncompressed bytes still to come
+  uLong method, crc, crc_wait;
+  ZPOS64_T total_in, total_out;// compressed bytes taken from the file; bytes produced
+  std::vector<Byte> buffer; // for zips read through a handle; memory is read in place
+  const Byte *in, *inend;   // compressed bytes taken, but not yet decoded
+  TInflater inflater;
+  ZRESULT state;            // ZR_MORE until the item is done with, and then how it went
+};
+
 class TUnzip
 { public:
   TUnzip() : uf(0), currentfile(-1), czei(-1) {}
 
   unzFile uf; int currentfile; ZIPENTRY cze; int czei;
   char rootdir[MAX_PATH];
+  // The central directory is read just once, at Open. After that any item is
+  // reached by index without walking the directory, and found by name through
+  // a hash table: one for exact names, one for names with a-z folded to A-Z,
+  // as unzStringFileNameCompare folds them. Slots hold index+1, 0 for empty.
+  std::vector<TUnzipDirEntry> dir; std::vector<char> names;
+  std::vector<int> exact, folded; unsigned int mask;
+
+  ZRESULT Index();
+  ZRESULT IndexEntries();
+  void GoTo(int index);
+  int Lookup(const char *name,bool ic) const;
 
   ZRESULT Open(void *z,unsigned int len,DWORD flags);
   ZRESULT Get(int index,ZIPENTRY *ze);
   ZRESULT Find(const char *name,bool ic,int *index,ZIPENTRY *ze);
   ZRESULT Unzip(int index,void *dst,unsigned int len,DWORD flags);
+  ZRESULT GetData(int index,const void **data,unsigned int *len,bool check);
+  ZRESULT UnzipMany(int count,const int *indices,void *const *dsts,const unsigned int *lens,ZRESULT *results,unsigned int nthreads);
+  ZRESULT Locate(int index,const Byte **data);
+  ZRESULT OpenStream(int index,unsigned int bufsize,TUnzipStream **stream);
+  ZRESULT AllocCounts(unsigned long *allocs,unsigned long *reuses);
   ZRESULT Close();
 };
 
@@ -3690,9 +4179,95 @@ ZRESULT TUnzip::Open(void *z,unsigned int len,DWORD flags)
   ZRESULT e; LUFILE *f = lufopen(z,len,flags,&e);
   if (f==NULL) return e;
   uf = unzOpenInternal(f);
+  if (uf==0) return ZR_CORRUPT;
+  ZRESULT zr = Index();
+  if (zr!=ZR_OK) {unzClose(uf); uf=0;}
+  return zr;
+}
+
+static unsigned int NameHash(const char *name,bool ic)
+{ unsigned int h=2166136261u; // FNV-1a
+  for (; *name!=0; name++)
+  { char c=*name;
+    if (ic && c>='a' && c<='z') c -= (char)0x20;
+    h = (h^(unsigned char)c)*16777619u;
+  }
+  return h;
+}
+
+// Index: ZR_NOALLOC if the directory doesn't fit in memory, rather than
+// letting bad_alloc out through the C API
+ZRESULT TUnzip::Index()
+{ try
+  { return IndexEntries();
+  }
+  catch (const std::bad_alloc &)
+  { dir.clear(); names.clear(); exact.clear(); folded.clear();
+    return ZR_NOALLOC;
+  }
+}
+
+ZRESULT TUnzip::IndexEntries()
+{ uLong n = uf->gi.number_entry;
+  dir.clear(); names.clear();
+  // reserved by what the central dir can hold, which the zip's own size
+  // bounds, rather than by the count it claims
+  ZPOS64_T most = uf->size_central_dir/SIZECENTRALDIRITEM;
+  dir.reserve(n<most ? n : (size_t)most);
+  ZPOS64_T pos = uf->offset_central_dir;
+  for (uLong i=0; i<n; i++)
+  { TUnzipDirEntry e; char fn[MAX_PATH];
+    uf->pos_in_central_dir=pos;
+    int err = unzlocal_GetCurrentFileInfoInternal(uf,&e.info,&e.info_internal,fn,MAX_PATH-1,NULL,0,NULL,0);
+    if (err!=UNZ_OK) break; // the rest of the directory is unreadable: Get will say so
+    fn[MAX_PATH-1]=0;
+    e.pos_in_central_dir=pos;
+    e.name=(unsigned int)names.size();
+    names.insert(names.end(),fn,fn+strlen(fn)+1);
+    dir.push_back(e);
+    pos += SIZECENTRALDIRITEM + e.info.size_filename + e.info.size_file_extra + e.info.size_file_comment;
+  }
+  // twice as many slots as items, so probe chains stay short
+  unsigned int size=16; while (size<2*dir.size()) size*=2;
+  mask=size-1;
+  exact.assign(size,0); folded.assign(size,0);
+  for (unsigned int i=0; i<dir.size(); i++)
+  { const char *name=&names[dir[i].name];
+    // where names repeat, the first one wins, as it would in a walk of the directory
+    for (int pass=0; pass<2; pass++)
+    { bool ic = pass==1;
+      std::vector<int> &table = ic?folded:exact;
+      unsigned int slot=NameHash(name,ic)&mask;
+      for (; table[slot]!=0; slot=(slot+1)&mask)
+      { const char *other=&names[dir[table[slot]-1].name];
+        if (unzStringFileNameCompare(other,name,ic?CASE_INSENSITIVE:CASE_SENSITIVE)==0) break;
+      }
+      if (table[slot]==0) table[slot]=i+1;
+    }
+  }
+  uf->pos_in_central_dir=uf->offset_central_dir; uf->num_file=0;
+  if (dir.size()>0) GoTo(0);
   return ZR_OK;
 }
 
+void TUnzip::GoTo(int index)
+{ const TUnzipDirEntry &e = dir[index];
+  uf->num_file=index;
+  uf->pos_in_central_dir=e.pos_in_central_dir;
+  uf->cur_file_info=e.info;
+  uf->cur_file_info_internal=e.info_internal;
+  uf->current_file_ok=1;
+}
+
+int TUnzip::Lookup(const char *name,bool ic) const
+{ const std::vector<int> &table = ic?folded:exact;
+  for (unsigned int slot=NameHash(name,ic)&mask; table[slot]!=0; slot=(slot+1)&mask)
+  { int i=table[slot]-1;
+    if (unzStringFileNameCompare(&names[dir[i].name],name,ic?CASE_INSENSITIVE:CASE_SENSITIVE)==0) return i;
+  }
+  return -1;
+}
+
 ZRESULT TUnzip::Get(int index,ZIPENTRY *ze)
 { if (index<-1 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
   if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
@@ -3708,13 +4283,12 @@ ZRESULT TUnzip::Get(int index,ZIPENTRY *ze)
     ze->unc_size=0;
     return ZR_OK;
   }
-  if (index<(int)uf->num_file) unzGoToFirstFile(uf);
-  while ((int)uf->num_file<index) unzGoToNextFile(uf);
-  unz_file_info ufi; char fn[MAX_PATH];
-  unzGetCurrentFileInfo(uf,&ufi,fn,MAX_PATH,NULL,0,NULL,0);
+  if (index>=(int)dir.size()) return ZR_CORRUPT;
+  GoTo(index);
+  const unz_file_info &ufi = dir[index].info; const char *fn = &names[dir[index].name];
   // now get the extra header. We do this ourselves, instead of
   // calling unzOpenCurrentFile &c., to avoid allocating more than necessary.
-  unsigned int extralen,iSizeVar; unsigned long offset;
+  unsigned int extralen,iSizeVar; ZPOS64_T offset;
   int res = unzlocal_CheckCurrentFileCoherencyHeader(uf,&iSizeVar,&offset,&extralen);
   if (res!=UNZ_OK) return ZR_CORRUPT;
   if (lufseek(uf->file,offset,SEEK_SET)!=0) return ZR_READ;
@@ -3782,14 +4356,14 @@ ZRESULT TUnzip::Get(int index,ZIPENTRY *ze)
 }
 
 ZRESULT TUnzip::Find(const char *name,bool ic,int *index,ZIPENTRY *ze)
-{ int res = unzLocateFile(uf,name,ic?CASE_INSENSITIVE:CASE_SENSITIVE);
-  if (res!=UNZ_OK)
+{ int i = strlen(name)<UNZ_MAXFILENAMEINZIP ? Lookup(name,ic) : -1;
+  if (i==-1)
   { if (index!=0) *index=-1;
     if (ze!=NULL) {ZeroMemory(ze,sizeof(ZIPENTRY)); ze->index=-1;}
     return ZR_NOTFOUND;
   }
   if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
-  int i = (int)uf->num_file;
+  GoTo(i);
   if (index!=NULL) *index=i;
   if (ze!=NULL)
   { ZRESULT zres = Get(i,ze);
@@ -3818,12 +4392,17 @@ ZRESULT TUnzip::Unzip(int index,void *dst,unsigned int len,DWORD flags)
   if (flags==ZIP_MEMORY)
   { if (index!=currentfile)
     { if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
-      if (index>=(int)uf->gi.number_entry) return ZR_ARGS;
-      if (index<(int)uf->num_file) unzGoToFirstFile(uf);
-      while ((int)uf->num_file<index) unzGoToNextFile(uf);
+      if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+      if (index>=(int)dir.size()) return ZR_CORRUPT;
+      GoTo(index);
       unzOpenCurrentFile(uf); currentfile=index;
     }
-    int res = unzReadCurrentFile(uf,dst,len);
+    // a read gives at most INT_MAX bytes, so a bigger buffer takes several
+    unsigned int done=0; int res;
+    do
+    { res = unzReadCurrentFile(uf,(char*)dst+done,len-done);
+      if (res>0) done+=res;
+    } while (res>0 && done<len && len>(unsigned)INT_MAX);
     if (res>0) return ZR_MORE;
     unzCloseCurrentFile(uf); currentfile=-1;
     if (res==0) return ZR_OK;
@@ -3831,10 +4410,10 @@ ZRESULT TUnzip::Unzip(int index,void *dst,unsigned int len,DWORD flags)
   }
   // otherwise we're writing to a handle or a file
   if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
-  if (index>=(int)uf->gi.number_entry) return ZR_ARGS;
-  if (index<(int)uf->num_file) unzGoToFirstFile(uf);
-  while ((int)uf->num_file<index) unzGoToNextFile(uf);
-  ZIPENTRY ze; Get(index,&ze);
+  if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  ZIPENTRY ze; ZRESULT zres = Get(index,&ze);
+  if (zres!=ZR_OK) return zres;
+  GoTo(index); // Get may have answered from its cache, without moving there
   // zipentry=directory is handled specially
   if ((ze.attr&FILE_ATTRIBUTE_DIRECTORY)!=0)
   { if (flags==ZIP_HANDLE) return ZR_OK; // don't do anything
@@ -3877,6 +4456,162 @@ ZRESULT TUnzip::Unzip(int index,void *dst,unsigned int len,DWORD flags)
   return ZR_OK;
 }
 
+// Locate: for a zip in memory, finds where an item's (compressed) data starts
+// in it, having checked its local header and that all of the data is there.
+ZRESULT TUnzip::Locate(int index,const Byte **data)
+{ if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  if (index>=(int)dir.size()) return ZR_CORRUPT;
+  GoTo(index);
+  unsigned int iSizeVar,extralen; ZPOS64_T offset;
+  if (unzlocal_CheckCurrentFileCoherencyHeader(uf,&iSizeVar,&offset,&extralen)!=UNZ_OK) return ZR_CORRUPT;
+  ZPOS64_T start = uf->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER + iSizeVar + uf->byte_before_the_zipfile;
+  ZPOS64_T size = uf->cur_file_info.compressed_size;
+  if (start>uf->file->len || size>uf->file->len-start) return ZR_CORRUPT;
+  *data = (const Byte*)uf->file->buf + (size_t)start;
+  return ZR_OK;
+}
+
+ZRESULT TUnzip::GetData(int index,const void **data,unsigned int *len,bool check)
+{ if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  if (uf->file->is_handle) return ZR_NOTMMAP;
+  if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
+  if (index<(int)dir.size() && dir[index].info.compression_method!=0) return ZR_NOTSTORED;
+  const Byte *p; ZRESULT zres = Locate(index,&p);
+  if (zres!=ZR_OK) return zres;
+  ZPOS64_T size = uf->cur_file_info.compressed_size;
+  if (size!=uf->cur_file_info.uncompressed_size) return ZR_CORRUPT;
+  if (size>0xFFFFFFFF) return ZR_MEMSIZE; // more than len can say: read it with a ZipStream
+  if (check && ucrc32(0,p,(uInt)size)!=uf->cur_file_info.crc) return ZR_CORRUPT;
+  *data=p; *len=(unsigned int)size;
+  return ZR_OK;
+}
+
+// TUnzipJob: one item for UnzipMany's workers. Everything about it is found
+// beforehand, so they need nothing from the unz_s or its LUFILE, only the
+// zip's memory, which they all just read.
+struct TUnzipJob
+{ const Byte *src; ZPOS64_T srclen, unclen; uLong method, crc;
+  Byte *dst; ZRESULT *result;
+};
+
+static ZRESULT UnzipJob(const TUnzipJob &job,TInflater &inflater)
+{ if (job.unclen==0) return job.crc==0 ? ZR_OK : ZR_CORRUPT;
+  if (job.method==0)
+  { if (job.srclen!=job.unclen) return ZR_CORRUPT;
+    memcpy(job.dst,job.src,(size_t)job.unclen);
+  }
+  else if (job.method==Z_DEFLATED)
+  { size_t written=0;
+    if (inflater.Whole(job.src,(size_t)job.srclen,job.dst,(size_t)job.unclen,written)==isError) return ZR_FLATE;
+    if (written!=job.unclen) return ZR_CORRUPT;
+  }
+  else return ZR_CORRUPT;
+  if (ucrc32(0,job.dst,(uInt)job.unclen)!=job.crc) return ZR_CORRUPT;
+  return ZR_OK;
+}
+
+static void UnzipWorker(const std::vector<TUnzipJob> *jobs,std::atomic<size_t> *next)
+{ TInflater inflater; // each worker has its own
+  for (size_t k; (k=(*next)++)<jobs->size(); ) *(*jobs)[k].result = UnzipJob((*jobs)[k],inflater);
+}
+
+ZRESULT TUnzip::UnzipMany(int count,const int *indices,void *const *dsts,const unsigned int *lens,ZRESULT *results,unsigned int nthreads)
+{ if (count<0 || (count>0 && (indices==0 || dsts==0 || lens==0 || results==0))) return ZR_ARGS;
+  if (uf->file->is_handle) return ZR_NOTMMAP;
+  if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
+  // The headers are all read here, by this thread: only the decoding is shared out
+  std::vector<TUnzipJob> jobs; jobs.reserve(count);
+  for (int k=0; k<count; k++)
+  { TUnzipJob job; job.result=&results[k];
+    *job.result = Locate(indices[k],&job.src);
+    if (*job.result!=ZR_OK) continue;
+    job.srclen=uf->cur_file_info.compressed_size; job.method=uf->cur_file_info.compression_method;
+    job.unclen=uf->cur_file_info.uncompressed_size; job.crc=uf->cur_file_info.crc;
+    // only stored and deflated items, as for UnzipItem
+    if (job.method!=0 && job.method!=Z_DEFLATED) {*job.result=ZR_CORRUPT; continue;}
+    job.dst=(Byte*)dsts[k];
+    if (lens[k]<job.unclen) {*job.result=ZR_MEMSIZE; continue;}
+    jobs.push_back(job);
+  }
+  if (nthreads==0) nthreads=std::thread::hardware_concurrency();
+  if (nthreads>jobs.size()) nthreads=(unsigned int)jobs.size();
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  try
+  { // reserved first, so that once a thread is running nothing can throw before it's held
+    if (nthreads>1) threads.reserve(nthreads-1);
+    for (unsigned int t=1; t<nthreads; t++) threads.emplace_back(UnzipWorker,&jobs,&next);
+  }
+  catch (const std::system_error &) {} // then we make do with the threads we got
+  catch (const std::bad_alloc &) {}
+  UnzipWorker(&jobs,&next);
+  for (size_t t=0; t<threads.size(); t++) threads[t].join();
+  for (int k=0; k<count; k++) if (results[k]!=ZR_OK) return results[k];
+  return ZR_OK;
+}
+
+ZRESULT TUnzip::OpenStream(int index,unsigned int bufsize,TUnzipStream **stream)
+{ if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  if (index>=(int)dir.size()) return ZR_CORRUPT;
+  if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
+  GoTo(index);
+  unsigned int iSizeVar,extralen; ZPOS64_T offset;
+  if (unzlocal_CheckCurrentFileCoherencyHeader(uf,&iSizeVar,&offset,&extralen)!=UNZ_OK) return ZR_CORRUPT;
+  ZPOS64_T start = uf->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER + iSizeVar + uf->byte_before_the_zipfile;
+  ZPOS64_T size = uf->cur_file_info.compressed_size;
+  if (!uf->file->is_handle && (start>uf->file->len || size>uf->file->len-start)) return ZR_CORRUPT;
+  TUnzipStream *s = new TUnzipStream;
+  s->file=uf->file; s->pos=start;
+  s->rest_in=size; s->rest_out=uf->cur_file_info.uncompressed_size;
+  s->method=uf->cur_file_info.compression_method;
+  s->crc=0; s->crc_wait=uf->cur_file_info.crc;
+  s->total_in=0; s->total_out=0;
+  if (uf->file->is_handle) s->buffer.resize(bufsize!=0 ? bufsize : UNZ_BUFSIZE);
+  s->in=0; s->inend=0;
+  s->state=ZR_MORE;
+  *stream=s;
+  return ZR_OK;
+}
+
+static ZRESULT UnzipStreamRead(TUnzipStream *s,Byte *dst,unsigned int len,unsigned int *produced)
+{ Byte *out=dst, *outend=dst + (len<s->rest_out ? len : s->rest_out);
+  while (out<outend)
+  { if (s->in==s->inend && s->rest_in>0)
+    { ZPOS64_T n = s->rest_in;
+      if (s->file->is_handle)
+      { if (n>s->buffer.size()) n=s->buffer.size();
+        if (lufseek(s->file,s->pos,SEEK_SET)!=0 || lufread(&s->buffer[0],(uInt)n,1,s->file)!=1) {s->state=ZR_READ; break;}
+        s->in=&s->buffer[0];
+      }
+      else s->in=(const Byte*)s->file->buf + s->pos;
+      s->inend=s->in+(size_t)n;
+      s->pos+=n; s->rest_in-=n; s->total_in+=n;
+    }
+    Byte *was=out; const Byte *wasin=s->in;
+    if (s->method==0)
+    { size_t n = s->inend-s->in; if (n>(size_t)(outend-out)) n=outend-out;
+      memcpy(out,s->in,n); out+=n; s->in+=n;
+    }
+    else
+    { TInflateStatus st = s->inflater.Stream(s->in,s->inend,s->rest_in==0,out,outend);
+      if (st==isError) {s->state=ZR_FLATE; break;}
+      if (st==isEnd && out<outend) {s->state=ZR_CORRUPT; break;} // shorter than it said
+    }
+    if (out==was && s->in==wasin) {s->state=ZR_CORRUPT; break;} // the data ran out
+  }
+  *produced=(unsigned int)(out-dst);
+  s->crc=ucrc32(s->crc,dst,*produced);
+  s->total_out+=*produced; s->rest_out-=*produced;
+  if (s->state==ZR_MORE && s->rest_out==0) s->state = (s->crc==s->crc_wait) ? ZR_OK : ZR_CORRUPT;
+  return s->state;
+}
+
+ZRESULT TUnzip::AllocCounts(unsigned long *allocs,unsigned long *reuses)
+{ if (allocs!=0) *allocs=uf->allocs;
+  if (reuses!=0) *reuses=uf->reuses;
+  return ZR_OK;
+}
+
 ZRESULT TUnzip::Close()
 { if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
   if (uf!=0) unzClose(uf); uf=0;
@@ -3905,6 +4640,7 @@ unsigned int FormatZipMessageU(ZRESULT code, char *buf,unsigned int len)
     case ZR_ARGS: msg="Caller: faulty arguments"; break;
     case ZR_PARTIALUNZ: msg="Caller: the file had already been partially unzipped"; break;
     case ZR_NOTMMAP: msg="Caller: can only get memory of a memory zipfile"; break;
+    case ZR_NOTSTORED: msg="Caller: can only get memory of a stored item"; break;
     case ZR_MEMSIZE: msg="Caller: not enough space allocated for memory zipfile"; break;
     case ZR_FAILED: msg="Caller: there was a previous error"; break;
     case ZR_ENDED: msg="Caller: additions to the zip have already been ended"; break;
@@ -3963,6 +4699,69 @@ ZRESULT UnzipItem(HZIP hz, int index, void *dst, unsigned int len, DWORD flags)
   return lasterrorU;
 }
 
+ZRESULT GetZipItemData(HZIP hz, int index, const void **data, unsigned int *len, bool check)
+{ if (hz==0 || data==0 || len==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  lasterrorU = unz->GetData(index,data,len,check);
+  return lasterrorU;
+}
+
+ZRESULT UnzipItems(HZIP hz, int count, const int *indices, void *const *dsts, const unsigned int *lens, ZRESULT *results, unsigned int nthreads)
+{ if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  lasterrorU = unz->UnzipMany(count,indices,dsts,lens,results,nthreads);
+  return lasterrorU;
+}
+
+ZRESULT GetZipAllocCounts(HZIP hz, unsigned long *allocs, unsigned long *reuses)
+{ if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  lasterrorU = unz->AllocCounts(allocs,reuses);
+  return lasterrorU;
+}
+
+HZIPSTREAM OpenZipStream(HZIP hz, int index, unsigned int bufsize)
+{ if (hz==0) {lasterrorU=ZR_ARGS;return 0;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return 0;}
+  TUnzip *unz = han->unz;
+  TUnzipStream *s=0;
+  lasterrorU = unz->OpenStream(index,bufsize,&s);
+  if (lasterrorU!=ZR_OK) return 0;
+  return (HZIPSTREAM)s;
+}
+
+ZRESULT ReadZipStream(HZIPSTREAM hs, void *dst, unsigned int len, unsigned int *produced)
+{ if (hs==0 || produced==0 || (dst==0 && len!=0)) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipStream *s = (TUnzipStream*)hs;
+  *produced=0;
+  if (s->state!=ZR_MORE) {lasterrorU=s->state; return lasterrorU;}
+  lasterrorU = UnzipStreamRead(s,(Byte*)dst,len,produced);
+  return lasterrorU;
+}
+
+ZRESULT GetZipStreamProgress(HZIPSTREAM hs, unsigned long long *produced, unsigned long long *consumed)
+{ if (hs==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipStream *s = (TUnzipStream*)hs;
+  if (produced!=0) *produced=s->total_out;
+  if (consumed!=0) *consumed=s->total_in-(ZPOS64_T)(s->inend-s->in);
+  lasterrorU=ZR_OK;
+  return ZR_OK;
+}
+
+ZRESULT CloseZipStream(HZIPSTREAM hs)
+{ if (hs==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  delete (TUnzipStream*)hs;
+  lasterrorU=ZR_OK;
+  return ZR_OK;
+}
+
 ZRESULT CloseZipU(HZIP hz)
 { if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
   TUnzipHandleData *han = (TUnzipHandleData*)hz;
@@ -10,6 +10,7 @@
 
 #ifndef _zip_H
 DECLARE_HANDLE(HZIP);
+DECLARE_HANDLE(HZIPSTREAM);
 #endif
 // An HZIP identifies a zip file that has been opened
 
@@ -26,8 +27,8 @@ typedef struct
   char name[MAX_PATH];       // filename within the zip
   DWORD attr;                // attributes, as in GetFileAttributes.
   FILETIME atime,ctime,mtime;// access, create, modify filetimes
-  long comp_size;            // sizes of item, compressed and uncompressed. These
-  long unc_size;             // may be -1 if not yet known (e.g. being streamed in)
+  long long comp_size;       // sizes of item, compressed and uncompressed. These
+  long long unc_size;        // may be -1 if not yet known (e.g. being streamed in)
 } ZIPENTRY;
 
 
@@ -42,6 +43,10 @@ HZIP OpenZip(void *z,unsigned int len,DWORD flags);
 // accessed in increasing order, and an item may only be unzipped once,
 // although GetZipItem can be called immediately before and after unzipping
 // it. If it's opened in any other way, then full random access is possible.
+// A file opened by name is mapped into memory where it can be, and from then
+// on it's read just as a memory block would be.
+// Zip64 archives, with more than 65535 items or past 4GB, are read too;
+// the big ones have to be opened by name or handle, since len is 32 bits.
 // Note: pipe input is not yet implemented.
 
 ZRESULT GetZipItem(HZIP hz, int index, ZIPENTRY *ze);
@@ -74,6 +79,8 @@ ZRESULT UnzipItem(HZIP hz, int index, void *dst, unsigned int len, DWORD flags);
 // In the final case, if the buffer isn't large enough to hold it all,
 // then the return code indicates that more is yet to come. If it was
 // large enough, and you want to know precisely how big, GetZipItem.
+// If the zip was opened from memory too, and the buffer is big enough for
+// the whole item, it's decompressed straight into the buffer in one go.
 // Note: zip files are normally stored with relative pathnames. If you
 // unzip with ZIP_FILENAME a relative pathname then the item gets created
 // relative to the current directory - it first ensures that all necessary
@@ -82,6 +89,52 @@ ZRESULT UnzipItem(HZIP hz, int index, void *dst, unsigned int len, DWORD flags);
 // If you unzip it to a handle or a memory block, then nothing gets created
 // and it emits 0 bytes.
 
+ZRESULT GetZipItemData(HZIP hz, int index, const void **data, unsigned int *len, bool check);
+// GetZipItemData - for a zip opened with ZIP_MEMORY or ZIP_FILENAME, and an
+// item that's stored rather than compressed, gives a pointer straight to the
+// item's bytes inside the zip's memory, and their number, without copying anything.
+// The pointer stays good for as long as the memory passed to OpenZip does,
+// or, for a file, until CloseZip.
+// If check is true, it first verifies the item's crc (ZR_CORRUPT if bad).
+// Compressed items give ZR_NOTSTORED, and zips that couldn't be mapped ZR_NOTMMAP;
+// UnzipItem works for both. Items of 4GB or more, which len can't hold, give
+// ZR_MEMSIZE: read them with a ZipStream.
+
+ZRESULT UnzipItems(HZIP hz, int count, const int *indices, void *const *dsts, const unsigned int *lens, ZRESULT *results, unsigned int nthreads);
+// UnzipItems - for a zip opened with ZIP_MEMORY or ZIP_FILENAME, unzips several items at once:
+// item indices[i] goes into dsts[i], which is lens[i] bytes and has to hold
+// all of it (else results[i]=ZR_MEMSIZE, and nothing is written there).
+// The items are shared out among nthreads threads, or one per core if it's 0,
+// each decompressing with its own state straight from the zip's memory.
+// results[i] says how each one went; the function returns ZR_OK if they all
+// went well, or else the first failure. Zips that couldn't be mapped give ZR_NOTMMAP,
+// and items neither stored nor deflated ZR_CORRUPT.
+
+ZRESULT GetZipAllocCounts(HZIP hz, unsigned long *allocs, unsigned long *reuses);
+// GetZipAllocCounts - UnzipItem keeps the state it unzips with (a read buffer,
+// and a decoder with its window) from one item to the next, for as long as
+// the zip is open. This says how many blocks it has had to allocate for that,
+// and how many items have been unzipped with the state left from the one
+// before. Once a compressed item has been unzipped, allocs stops going up.
+
+HZIPSTREAM OpenZipStream(HZIP hz, int index, unsigned int bufsize);
+ZRESULT ReadZipStream(HZIPSTREAM hs, void *dst, unsigned int len, unsigned int *produced);
+ZRESULT GetZipStreamProgress(HZIPSTREAM hs, unsigned long long *produced, unsigned long long *consumed);
+ZRESULT CloseZipStream(HZIPSTREAM hs);
+// OpenZipStream - starts reading an item a piece at a time, into whatever
+// buffers the caller likes. Each stream has its own position and decoder,
+// so several can be open at once, and the zip can be used meanwhile.
+// bufsize is how much compressed data to read from the file at a time, for
+// zips opened through a handle (0 for 16k); zips in memory, or mapped from a
+// file, are read where they are. On failure it returns 0, and the reason is
+// in ZR_RECENT. All streams must be closed before the zip is.
+// ReadZipStream - fills dst with up to len bytes, and says how many. It only
+// produces fewer than len at the end of the item, or on an error. It returns
+// ZR_MORE while there's more to come, and ZR_OK once the item is all read
+// and its crc checked; after that it produces nothing more.
+// GetZipStreamProgress - how many bytes have been produced so far, and how
+// many compressed bytes the decoder has used to produce them.
+
 ZRESULT CloseZip(HZIP hz);
 // CloseZip - the zip handle must be closed with this function.
 
@@ -114,6 +167,7 @@ unsigned int FormatZipMessage(ZRESULT code, char *buf,unsigned int len);
 #define ZR_MISSIZE    0x00060000     // the indicated input file size turned out mistaken
 #define ZR_PARTIALUNZ 0x00070000     // the file had already been partially unzipped
 #define ZR_ZMODE      0x00080000     // tried to mix creating/opening a zip 
+#define ZR_NOTSTORED  0x00090000     // tried to GetZipItemData, but that only works on stored items, which yours wasn't
 // The following come from bugs within the zip library itself
 #define ZR_BUGMASK    0xFF000000
 #define ZR_NOTINITED  0x01000000     // initialisation didn't work
@@ -137,6 +191,15 @@ unsigned int FormatZipMessage(ZRESULT code, char *buf,unsigned int len);
 // CloseZip(hz);
 //
 //
+// HZIPSTREAM hs = OpenZipStream(hz,i,0);
+// char ibuf[1024]; unsigned int n; ZRESULT zr=ZR_MORE;
+// while (zr==ZR_MORE)
+// { zr = ReadZipStream(hs, ibuf,1024, &n);
+//   ... // do something with the n bytes in ibuf
+// }
+// CloseZipStream(hs);
+//
+//
 // HRSRC hrsrc = FindResource(hInstance,MAKEINTRESOURCE(1),RT_RCDATA);
 // HANDLE hglob = LoadResource(hInstance,hrsrc);
 // void *zipbuf=LockResource(hglob);